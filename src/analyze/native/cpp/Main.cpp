@@ -0,0 +1,155 @@
+// MIT License
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <wpi/Format.h>
+#include <wpi/StringRef.h>
+#include <wpi/raw_ostream.h>
+
+#include "backend/DataProcessor.h"
+#include "backend/MemoryUsage.h"
+
+// The analyze tool prints the gains of a characterization JSON, session
+// archive, or run archive. It only uses the analysis core, so it is also the
+// smallest consumer of it, and can report its own size and startup time.
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+/**
+ * The settings of an analysis, which are given on the command line.
+ */
+struct Options {
+  std::string path;
+  int dataset = 2;
+  size_t run = 0;
+  bool position = false;
+  bool report = false;
+};
+
+void PrintUsage() {
+  wpi::errs() << "Usage: frc-char-analyze <data> [options]\n"
+                 "  --dataset <n>  Index of the data set (default 2)\n"
+                 "  --run <n>      Index of the run of a run archive "
+                 "(default 0)\n"
+                 "  --position     Calculate gains for a position loop\n"
+                 "  --report       Report the size, startup time, and "
+                 "memory usage\n";
+}
+
+/**
+ * Parses the command line. Returns false if it is invalid.
+ */
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    wpi::StringRef arg = argv[i];
+    auto next = [&]() -> const char* {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+
+    if (arg == "--position") {
+      options->position = true;
+    } else if (arg == "--report") {
+      options->report = true;
+    } else if (arg == "--dataset" || arg == "--run") {
+      const char* value = next();
+      if (!value) return false;
+      if (arg == "--dataset")
+        options->dataset = std::atoi(value);
+      else
+        options->run = std::strtoul(value, nullptr, 10);
+    } else if (options->path.empty()) {
+      options->path = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options->path.empty() && options->dataset >= 0;
+}
+
+/**
+ * Returns the size of this executable in bytes, or zero if it cannot be
+ * determined.
+ */
+size_t GetExecutableSize(const char* argv0) {
+#ifdef __linux__
+  const char* path = "/proc/self/exe";
+#else
+  const char* path = argv0;
+#endif
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  return file ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+double Milliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto start = Clock::now();
+
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 1;
+  }
+
+  frcchar::DataProcessor::FFGains ff{0_V, 0_V / 1_mps, 0_V / 1_mps_sq, 0.0};
+  frcchar::DataProcessor::FBGains fb{0.0, 0.0};
+  frcchar::DataProcessor::GainPreset preset{!options.position, 20_ms, 0_s,
+                                            1 / 1_V, true};
+  frcchar::DataProcessor::LQRParameters params{1_m, 1.5_mps, 7_V};
+
+  std::unique_ptr<frcchar::DataProcessor> processor;
+  try {
+    processor = std::make_unique<frcchar::DataProcessor>(
+        &options.path, &ff, &fb, &preset, &params, &options.dataset, false,
+        options.run);
+  } catch (const std::exception& e) {
+    wpi::errs() << "Could not load " << options.path << ": " << e.what()
+                << "\n";
+    return 1;
+  }
+  auto loaded = Clock::now();
+
+  if (auto latency = processor->GetMeasuredLatency()) preset.latency = *latency;
+  processor->Update();
+  auto analyzed = Clock::now();
+
+  auto& out = wpi::outs();
+  out << wpi::format("Ks         %10.4f V\n", ff.Ks.to<double>())
+      << wpi::format("Kv         %10.4f V/(unit/s)\n", ff.Kv.to<double>())
+      << wpi::format("Ka         %10.4f V/(unit/s^2)\n", ff.Ka.to<double>())
+      << wpi::format("R-squared  %10.4f\n", ff.CoD)
+      << wpi::format("Kp         %10.4f\n", fb.Kp)
+      << wpi::format("Kd         %10.4f\n", fb.Kd);
+  if (processor->IsDrivetrain()) {
+    double trackWidth = processor->GetTrackWidth().to<double>();
+    if (std::isnan(trackWidth))
+      out << "Track width unavailable\n";
+    else
+      out << wpi::format("Track width %9.4f m\n", trackWidth);
+  }
+
+  if (options.report) {
+    out << "\nCore consumer report\n"
+        << wpi::format("  Executable size  %10.1f KiB\n",
+                       GetExecutableSize(argv[0]) / 1024.0)
+        << wpi::format("  Load             %10.2f ms\n",
+                       Milliseconds(loaded - start))
+        << wpi::format("  First analysis   %10.3f ms\n",
+                       Milliseconds(analyzed - loaded))
+        << wpi::format("  Prepared data    %10.1f KiB\n",
+                       processor->GetMemoryUsage() / 1024.0)
+        << wpi::format("  Peak memory      %10.1f MiB\n",
+                       frcchar::GetPeakMemoryUsage() / 1048576.0);
+  }
+  return 0;
+}
@@ -0,0 +1,293 @@
+// MIT License
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <initializer_list>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <wpi/Format.h>
+#include <wpi/StringRef.h>
+#include <wpi/json.h>
+#include <wpi/math>
+#include <wpi/raw_ostream.h>
+
+#include "backend/DataProcessor.h"
+#include "backend/KinematicSmoother.h"
+#include "backend/OLS.h"
+#include "backend/Parallel.h"
+
+// The bench tool measures the analysis core on synthetic data, so that the
+// numbers of a change can be repeated on any machine. Each mode prints a
+// table, and the same seed always gives the same data.
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// The seed of the synthetic data.
+constexpr unsigned int kSeed = 2021;
+
+void PrintUsage() {
+  wpi::errs() << "Usage: frc-char-bench <mode>\n"
+                 "  sums      Regression sums and parallel batch overhead by "
+                 "thread count\n"
+                 "  smoother  Smoother bandwidth, speed, and gain spread "
+                 "against the secant\n";
+}
+
+/**
+ * Returns the median time in microseconds of the given number of calls of
+ * func, which are timed in groups so that short calls are measurable.
+ */
+template <typename F>
+double MedianMicroseconds(int repetitions, int callsPerRepetition, F&& func) {
+  std::vector<double> times;
+  for (int i = 0; i < repetitions; ++i) {
+    auto start = Clock::now();
+    for (int j = 0; j < callsPerRepetition; ++j) func();
+    times.emplace_back(
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count() /
+        callsPerRepetition);
+  }
+  std::nth_element(times.begin(), times.begin() + times.size() / 2,
+                   times.end());
+  return times[times.size() / 2];
+}
+
+/**
+ * Calls func(begin, end) for each batch on its own new thread, which is what
+ * ParallelFor() did before it used the worker pool. It is the baseline of the
+ * overhead measurement.
+ */
+template <typename F>
+void ThreadPerBatchFor(size_t count, F&& func, size_t threads) {
+  size_t batch = (count + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (size_t begin = batch; begin < count; begin += batch) {
+    size_t end = std::min(begin + batch, count);
+    workers.emplace_back([&func, begin, end] { func(begin, end); });
+  }
+  func(0, std::min(batch, count));
+  for (auto&& worker : workers) worker.join();
+}
+
+/**
+ * Measures the regression sums of a large batch, and the fixed cost of a
+ * parallel call, for each number of threads.
+ */
+void BenchSums() {
+  constexpr size_t kSamples = 1 << 20;
+  std::mt19937 generator{kSeed};
+  std::normal_distribution<double> noise;
+  std::vector<double> data(kSamples * 4);
+  for (auto&& value : data) value = noise(generator);
+
+  auto& out = wpi::outs();
+  out << wpi::format("%u cores reported, %zu samples per batch\n\n",
+                     std::thread::hardware_concurrency(), kSamples)
+      << "threads  sums (ms)  Msamples/s  pool call (us)  "
+         "thread per batch (us)\n";
+
+  for (size_t threads : {1, 2, 4, 8}) {
+    double sums = MedianMicroseconds(9, 1, [&] {
+      frcchar::OLSSums result;
+      result.Add(data.data(), kSamples, threads);
+    });
+
+    // The overhead of a call is measured with batches that do no work.
+    volatile size_t sink = 0;
+    auto empty = [&](size_t begin, size_t end) { sink = sink + end - begin; };
+    double pool = MedianMicroseconds(
+        9, 200, [&] { frcchar::ParallelFor(threads, empty, threads); });
+    double spawn = MedianMicroseconds(
+        9, 200, [&] { ThreadPerBatchFor(threads, empty, threads); });
+
+    out << wpi::format("%7zu  %9.2f  %10.1f  %14.2f  %21.2f\n", threads,
+                       sums / 1000, kSamples / sums, pool, spawn);
+  }
+}
+/**
+ * Returns the data JSON of a simulated mechanism with the given feedforward
+ * gains. The measured velocity is the difference of encoder positions that
+ * are quantized to a quarter millimeter, which is the noise that the secant
+ * acceleration amplifies.
+ */
+wpi::json SimulateMechanism(double rate, unsigned int seed) {
+  constexpr double kKs = 0.5;
+  constexpr double kKv = 2.0;
+  constexpr double kKa = 0.3;
+  constexpr double kResolution = 2.5E-4;
+  double dt = 1.0 / rate;
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<double> offset(0.0, kResolution);
+
+  auto simulate = [&](auto voltage, double duration, double sign) {
+    wpi::json test = wpi::json::array();
+    double position = offset(generator);
+    double velocity = 0.0;
+    double quantized = std::floor(position / kResolution) * kResolution;
+    for (double t = 0; t < duration; t += dt) {
+      double u = sign * voltage(t);
+      if (velocity != 0 || std::abs(u) > kKs) {
+        double friction = std::copysign(kKs, velocity != 0 ? velocity : u);
+        velocity += (u - friction - kKv * velocity) / kKa * dt;
+      }
+      position += velocity * dt;
+
+      double previous = quantized;
+      quantized = std::floor(position / kResolution) * kResolution;
+      double measured = (quantized - previous) / dt;
+      test.push_back({t, 12.0, u / 12.0, u, u, quantized, quantized, measured,
+                      measured, 0.0});
+    }
+    return test;
+  };
+
+  auto ramp = [](double t) { return 0.25 * t; };
+  auto step = [](double) { return 6.0; };
+  wpi::json json;
+  json["test"] = "Simple";
+  json["unitsPerRotation"] = 1.0;
+  json["slow-forward"] = simulate(ramp, 20.0, 1);
+  json["slow-backward"] = simulate(ramp, 20.0, -1);
+  json["fast-forward"] = simulate(step, 3.0, 1);
+  json["fast-backward"] = simulate(step, 3.0, -1);
+  return json;
+}
+
+/**
+ * Measures the response of the smoother to a sine at its bandwidth, for
+ * several sample rates. The smoother runs forward and backward, so its
+ * response is the square of the Butterworth filter's, which is one half at
+ * the bandwidth.
+ */
+void BenchSmootherResponse() {
+  constexpr double kBandwidth = 10.0;
+  constexpr double kDuration = 10.0;
+
+  auto& out = wpi::outs();
+  out << "Response to a sine at the bandwidth (" << kBandwidth
+      << " Hz), which should be 0.50 at any rate\n"
+      << "rate (Hz)  response\n";
+  for (double rate : {50.0, 200.0, 1000.0}) {
+    size_t size = static_cast<size_t>(kDuration * rate);
+    std::vector<double> time(size), velocity(size), smoothed(size),
+        acceleration(size);
+    for (size_t i = 0; i < size; ++i) {
+      time[i] = i / rate;
+      velocity[i] = std::sin(2 * wpi::math::pi * kBandwidth * time[i]);
+    }
+    frcchar::SmoothKinematics(time.data(), velocity.data(), size, kBandwidth,
+                              smoothed.data(), acceleration.data());
+
+    // Compare the amplitudes in the middle, away from the ends.
+    double input = 0.0;
+    double output = 0.0;
+    for (size_t i = size / 4; i < 3 * size / 4; ++i) {
+      input += velocity[i] * velocity[i];
+      output += smoothed[i] * smoothed[i];
+    }
+    out << wpi::format("%9.0f  %8.2f\n", rate, std::sqrt(output / input));
+  }
+}
+
+/**
+ * Measures the speed of the smoother, and the spread of the feedforward
+ * gains over simulated runs with the secant and the smoother.
+ */
+void BenchSmoother() {
+  BenchSmootherResponse();
+
+  constexpr size_t kSamples = 1 << 20;
+  std::vector<double> time(kSamples), velocity(kSamples), smoothed(kSamples),
+      acceleration(kSamples);
+  std::mt19937 generator{kSeed};
+  std::normal_distribution<double> noise;
+  for (size_t i = 0; i < kSamples; ++i) {
+    time[i] = i * 0.005;
+    velocity[i] = std::sin(time[i]) + 0.01 * noise(generator);
+  }
+  double smoother = MedianMicroseconds(5, 1, [&] {
+    frcchar::SmoothKinematics(time.data(), velocity.data(), kSamples, 10.0,
+                              smoothed.data(), acceleration.data());
+  });
+  double secant = MedianMicroseconds(5, 1, [&] {
+    for (size_t i = 1; i + 1 < kSamples; ++i) {
+      acceleration[i] =
+          (velocity[i + 1] - velocity[i - 1]) / (time[i + 1] - time[i - 1]);
+    }
+  });
+
+  auto& out = wpi::outs();
+  out << wpi::format("\nSpeed on %zu samples\n", kSamples)
+      << wpi::format("  smoother  %8.1f Msamples/s\n", kSamples / smoother)
+      << wpi::format("  secant    %8.1f Msamples/s\n", kSamples / secant);
+
+  // The gains of the same runs with each estimate of the acceleration. The
+  // true gains are Ks 0.5, Kv 2, and Ka 0.3.
+  constexpr int kRuns = 20;
+  out << "\nGains over " << kRuns
+      << " simulated runs at 200 Hz (true Ks 0.5, Kv 2, Ka 0.3)\n"
+         "estimate       Ks mean     sd   Kv mean     sd   Ka mean     sd\n";
+  std::vector<wpi::json> runs;
+  for (int run = 0; run < kRuns; ++run)
+    runs.emplace_back(SimulateMechanism(200.0, kSeed + run));
+
+  for (double bandwidth : {0.0, 2.0, 5.0, 10.0, 20.0}) {
+    std::vector<double> gains[3];
+    for (auto&& json : runs) {
+      frcchar::DataProcessor::FFGains ff{0_V, 0_V / 1_mps, 0_V / 1_mps_sq,
+                                         0.0};
+      frcchar::DataProcessor::FBGains fb{0.0, 0.0};
+      frcchar::DataProcessor::GainPreset preset{true, 20_ms, 0_s, 1 / 1_V,
+                                                true};
+      frcchar::DataProcessor::LQRParameters params{1_m, 1.5_mps, 7_V};
+      int dataset = 2;
+      std::string path;
+      frcchar::DataProcessor processor(&path, &ff, &fb, &preset, &params,
+                                       &dataset, false, 0, bandwidth);
+      processor.LoadSamples(json);
+      processor.Update();
+      gains[0].push_back(ff.Ks.to<double>());
+      gains[1].push_back(ff.Kv.to<double>());
+      gains[2].push_back(ff.Ka.to<double>());
+    }
+
+    std::string name = bandwidth == 0
+                           ? "secant"
+                           : std::to_string(std::lround(bandwidth)) + " Hz";
+    out << wpi::format("%-10s", name.c_str());
+    for (auto&& values : gains) {
+      double mean = 0.0;
+      for (double value : values) mean += value / values.size();
+      double variance = 0.0;
+      for (double value : values)
+        variance += (value - mean) * (value - mean) / (values.size() - 1);
+      out << wpi::format("  %8.4f %6.4f", mean, std::sqrt(variance));
+    }
+    out << "\n";
+  }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    PrintUsage();
+    return 1;
+  }
+
+  wpi::StringRef mode = argv[1];
+  if (mode == "sums") {
+    BenchSums();
+  } else if (mode == "smoother") {
+    BenchSmoother();
+  } else {
+    PrintUsage();
+    return 1;
+  }
+  return 0;
+}
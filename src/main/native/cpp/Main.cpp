@@ -10,6 +10,7 @@
 #include "display/Analyzer.h"
 #include "display/FRCCharacterization.h"
 #include "display/Generator.h"
+#include "display/IdleThrottle.h"
 #include "display/Logger.h"
 
 using namespace frcchar;
@@ -39,6 +40,10 @@ int main() {
     }
   });
 
+  // Show the frame time and CPU usage, and allow idle throttling to be turned
+  // off to compare them.
+  FRCCharacterization::MenuBar.AddMainMenu([] { IdleThrottle::DisplayMenu(); });
+
   // Start the Dear ImGui application.
   wpi::gui::Initialize("FRC Characterization", 1280, 720);
 
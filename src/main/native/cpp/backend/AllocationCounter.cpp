@@ -0,0 +1,33 @@
+// MIT License
+
+#include "backend/AllocationCounter.h"
+
+#include <atomic>
+
+using namespace frcchar;
+
+namespace {
+// These are trivially constructed, so counting never allocates itself.
+thread_local AllocationCount threadCount;
+std::atomic<size_t> totalAllocations{0};
+std::atomic<size_t> totalBytes{0};
+std::atomic<bool> hookRegistered{false};
+}  // namespace
+
+AllocationCount frcchar::GetThreadAllocations() { return threadCount; }
+
+AllocationCount frcchar::GetTotalAllocations() {
+  return {totalAllocations.load(std::memory_order_relaxed),
+          totalBytes.load(std::memory_order_relaxed)};
+}
+
+bool frcchar::IsCountingAllocations() { return hookRegistered; }
+
+void frcchar::RegisterAllocationHook() { hookRegistered = true; }
+
+void frcchar::CountAllocation(size_t size) {
+  ++threadCount.allocations;
+  threadCount.bytes += size;
+  totalAllocations.fetch_add(1, std::memory_order_relaxed);
+  totalBytes.fetch_add(size, std::memory_order_relaxed);
+}
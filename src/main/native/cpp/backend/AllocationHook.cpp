@@ -0,0 +1,29 @@
+// MIT License
+
+#include <cstdlib>
+#include <new>
+
+#include "backend/AllocationCounter.h"
+
+// Replaces the global operator new so that heap allocations are counted (see
+// GetThreadAllocations()). This is not part of the analysis core: only the
+// executables that report allocations (the GUI and the tests) compile it in.
+
+namespace {
+// Registers the hook when the program starts.
+struct Registration {
+  Registration() { frcchar::RegisterAllocationHook(); }
+} registration;
+}  // namespace
+
+// The default array forms forward to these, so they are counted too. The
+// over-aligned forms are left alone.
+void* operator new(size_t size) {
+  frcchar::CountAllocation(size);
+  if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
@@ -0,0 +1,76 @@
+// MIT License
+
+#include "backend/Analysis.h"
+
+#include "backend/FeedbackGains.h"
+
+using namespace frcchar;
+
+wpi::SmallVector<const Dataset::Segment*, 8> Dataset::GetSegments(
+    int dataset) const {
+  wpi::SmallVector<const Segment*, 8> segments;
+  for (auto&& segment : m_segments) {
+    if (IsSelected(*segment, dataset)) segments.push_back(segment.get());
+  }
+  return segments;
+}
+
+wpi::SmallVector<TestData, 8> Dataset::GetData(int dataset) const {
+  wpi::SmallVector<TestData, 8> data;
+  for (auto&& segment : GetSegments(dataset)) {
+    std::string name = segment->test;
+    if (m_drivetrain) name += segment->right ? " (right)" : " (left)";
+    data.push_back({std::move(name), &segment->data});
+  }
+  return data;
+}
+
+OLSSums Dataset::GetSums(int dataset) const {
+  // Each data set is made up of segments, so its sums are the sums of the
+  // segments that it includes.
+  OLSSums sums;
+  for (auto&& segment : GetSegments(dataset)) sums += segment->sums;
+  return sums;
+}
+
+size_t Dataset::GetMemoryUsage() const {
+  size_t usage = 0;
+  for (auto&& segment : m_segments) usage += segment->data.MemoryUsage();
+  return usage;
+}
+
+bool Dataset::IsSelected(const Segment& segment, int dataset) const {
+  if (m_drivetrain) {
+    switch (dataset) {
+      case 0:
+        return !segment.right;
+      case 1:
+        return segment.right;
+      case 3:
+        return !segment.backward;
+      case 4:
+        return segment.backward;
+      default:
+        return true;
+    }
+  }
+
+  switch (dataset) {
+    case 0:
+      return !segment.backward;
+    case 1:
+      return segment.backward;
+    default:
+      return true;
+  }
+}
+
+AnalysisResult frcchar::Analyze(const Dataset& data,
+                                const AnalysisParameters& params) {
+  auto ols = OLS(data.GetSums(params.dataset));
+  AnalysisResult result;
+  result.ff = {units::volt_t(ols[0]), units::Kv_t(ols[1]),
+               units::Ka_t(ols[2]), ols[3]};
+  result.fb = CalculateFeedbackGains(result.ff, params.preset, params.lqr);
+  return result;
+}
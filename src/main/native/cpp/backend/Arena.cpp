@@ -0,0 +1,52 @@
+// MIT License
+
+#include "backend/Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace frcchar;
+
+void* MonotonicArena::Allocate(size_t size, size_t alignment) {
+  auto align = [alignment](unsigned char* pos) {
+    auto address = reinterpret_cast<uintptr_t>(pos);
+    return pos + (alignment - address % alignment) % alignment;
+  };
+
+  unsigned char* begin = m_pos ? align(m_pos) : nullptr;
+  if (!begin || begin + size > m_end) {
+    AddBlock(size + alignment);
+    begin = align(m_pos);
+  }
+  m_pos = begin + size;
+  m_used += size;
+  return begin;
+}
+
+void MonotonicArena::Reset() {
+  // Replace several blocks with one that fits all of them, so that a run
+  // that needs as much as the last one does not have to add blocks.
+  if (m_blocks.size() > 1) {
+    size_t capacity = m_capacity;
+    m_blocks.clear();
+    m_capacity = 0;
+    AddBlock(capacity);
+  }
+
+  if (!m_blocks.empty()) {
+    m_pos = m_blocks.back().data.get();
+    m_end = m_pos + m_blocks.back().size;
+  }
+  m_used = 0;
+}
+
+void MonotonicArena::AddBlock(size_t size) {
+  size = std::max(size, m_nextBlockSize);
+  m_nextBlockSize = 2 * size;
+  // The memory is left uninitialized, like that of the heap.
+  m_blocks.push_back(
+      {std::unique_ptr<unsigned char[]>(new unsigned char[size]), size});
+  m_capacity += size;
+  m_pos = m_blocks.back().data.get();
+  m_end = m_pos + size;
+}
@@ -0,0 +1,102 @@
+// MIT License
+
+#include "backend/Bootstrap.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include "backend/FeedbackGains.h"
+#include "backend/OLS.h"
+#include "backend/Parallel.h"
+
+using namespace frcchar;
+
+namespace {
+/**
+ * The SplitMix64 random number generator. It is cheap to seed and has good
+ * statistical quality, so every replicate can have its own stream.
+ */
+class SplitMix64 {
+ public:
+  explicit SplitMix64(uint64_t state) : m_state(state) {}
+
+  uint64_t operator()() {
+    uint64_t z = (m_state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+  }
+
+ private:
+  uint64_t m_state;
+};
+}  // namespace
+
+BootstrapResult frcchar::BootstrapGains(
+    const wpi::SmallVectorImpl<TestData>& data,
+    const GainPreset& preset, const LQRParameters& params, int replicates,
+    uint64_t seed, double confidence, size_t blockSize) {
+  // Split each test into blocks. A block is identified by its test and the
+  // index of its first sample.
+  std::vector<std::pair<const PreparedData*, size_t>> blockStarts;
+  for (auto&& test : data) {
+    for (size_t i = 0; i < test.data->Size(); i += blockSize)
+      blockStarts.emplace_back(test.data, i);
+  }
+  size_t blocks = blockStarts.size();
+
+  if (replicates <= 0 || blocks == 0) {
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+    return {{nan, nan}, {nan, nan}, {nan, nan}, {nan, nan}, {nan, nan}};
+  }
+
+  // Calculate the regression sums of each block once. The replicates only
+  // ever combine these.
+  std::vector<OLSSums> blockSums(blocks);
+  ParallelFor(blocks, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      auto [test, first] = blockStarts[i];
+      blockSums[i] =
+          test->Sums(first, std::min(first + blockSize, test->Size()), 1);
+    }
+  });
+
+  // Calculate Ks, Kv, Ka, Kp, and Kd for each replicate.
+  std::vector<std::array<double, 5>> gains(replicates);
+  ParallelFor(replicates, [&](size_t begin, size_t end) {
+    for (size_t r = begin; r < end; ++r) {
+      // Derive this replicate's stream from the seed and its index, so that
+      // it does not matter which thread runs it.
+      SplitMix64 rng(SplitMix64(seed ^ (r * 0xD1B54A32D192ED03))());
+
+      OLSSums sums;
+      for (size_t i = 0; i < blocks; ++i) sums += blockSums[rng() % blocks];
+
+      auto ols = OLS(sums);
+      FFGains ff{units::volt_t(ols[0]), units::Kv_t(ols[1]),
+                 units::Ka_t(ols[2]), ols[3]};
+      auto fb = CalculateFeedbackGains(ff, preset, params);
+      gains[r] = {ols[0], ols[1], ols[2], fb.Kp, fb.Kd};
+    }
+  });
+
+  // Take the percentiles of each gain to create the intervals.
+  std::vector<double> values(replicates);
+  auto interval = [&](size_t gain) -> GainInterval {
+    for (int r = 0; r < replicates; ++r) values[r] = gains[r][gain];
+
+    auto percentile = [&](double p) {
+      auto it = values.begin() + std::lround(p * (replicates - 1));
+      std::nth_element(values.begin(), it, values.end());
+      return *it;
+    };
+
+    double alpha = (1 - confidence) / 2;
+    return {percentile(alpha), percentile(1 - alpha)};
+  };
+
+  return {interval(0), interval(1), interval(2), interval(3), interval(4)};
+}
@@ -0,0 +1,266 @@
+// MIT License
+
+#include "backend/CaptureSession.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <system_error>
+#include <utility>
+
+#include <networktables/NetworkTableValue.h>
+#include <wpi/json.h>
+#include <wpi/raw_ostream.h>
+
+using namespace frcchar;
+
+namespace {
+/**
+ * Converts a time to the local time zone. std::localtime() returns a buffer
+ * that is shared by all threads, and several sessions can save at once.
+ */
+std::tm LocalTime(std::time_t time) {
+  static std::mutex mutex;
+  std::scoped_lock lock(mutex);
+  return *std::localtime(&time);
+}
+
+/**
+ * Creates an empty file at the first of base.json, base-2.json, base-3.json,
+ * and so on that does not exist yet, and returns its path. The file is
+ * created exclusively, which claims the name even if another save picks the
+ * same base at the same time. If the file cannot be created for any other
+ * reason, the path is returned anyway so that opening it reports the error.
+ */
+std::string CreateUniqueFile(const std::string& base) {
+  for (int i = 1;; ++i) {
+    std::string path =
+        base + (i == 1 ? "" : "-" + std::to_string(i)) + ".json";
+    if (std::FILE* file = std::fopen(path.c_str(), "wx")) {
+      std::fclose(file);
+      return path;
+    }
+    if (errno != EEXIST) return path;
+  }
+}
+}  // namespace
+
+CaptureSession::CaptureSession(std::function<void()> onChange)
+    : m_inst(nt::CreateInstance()),
+      m_connectionPoller(nt::CreateConnectionListenerPoller(m_inst)),
+      m_onChange(std::move(onChange)),
+      m_capture(m_inst),
+      m_probe(m_inst),
+      m_autospeedEntry(nt::GetEntry(m_inst, TelemetryCapture::kAutospeedEntry)),
+      m_rotateEntry(nt::GetEntry(m_inst, TelemetryCapture::kRotateEntry)) {
+  nt::AddPolledConnectionListener(m_connectionPoller, true);
+
+  // Send the voltage commands as often as the session thread updates them.
+  nt::SetUpdateRate(m_inst, 0.01);
+  m_thread = std::thread([this] { Run(); });
+}
+
+CaptureSession::~CaptureSession() {
+  m_running = false;
+  m_thread.join();
+
+  // Never leave the robot running a test.
+  if (m_activeTest) {
+    nt::SetEntryValue(m_autospeedEntry, nt::Value::MakeDouble(0.0));
+    nt::Flush(m_inst);
+  }
+
+  nt::DestroyConnectionListenerPoller(m_connectionPoller);
+  nt::StopClient(m_inst);
+  nt::DestroyInstance(m_inst);
+}
+
+void CaptureSession::Connect(int team, unsigned int port) {
+  nt::StopClient(m_inst);
+  if (team == 0)
+    nt::StartClient(m_inst, "localhost", port);
+  else
+    nt::StartClientTeam(m_inst, team, port);
+}
+
+void CaptureSession::StartTest(const TestInfo& test, const Voltages& voltages) {
+  std::scoped_lock lock(m_mutex);
+  m_request = &test;
+  m_voltages = voltages;
+}
+
+void CaptureSession::StopTest() {
+  std::scoped_lock lock(m_mutex);
+  m_request = nullptr;
+}
+
+const CaptureSession::TestInfo* CaptureSession::GetActiveTest() const {
+  // A test that was requested is shown as running right away.
+  std::scoped_lock lock(m_mutex);
+  return m_request ? *m_request : m_activeTest;
+}
+
+bool CaptureSession::HasData(const char* key) const {
+  std::scoped_lock lock(m_mutex);
+  return m_data.count(key) > 0;
+}
+
+CaptureSession::Status CaptureSession::GetStatus() const {
+  std::scoped_lock lock(m_mutex);
+  return m_status;
+}
+
+void CaptureSession::Run() {
+  while (m_running) {
+    // Wait for telemetry, but never longer than the command period, so that
+    // the voltage of a quasistatic test keeps ramping up.
+    m_capture.Poll(kCommandPeriod);
+    PollConnection();
+
+    if (m_resetCapture.exchange(false)) m_capture.Reset();
+    if (m_resetLatency.exchange(false)) m_probe.Reset();
+    if (m_measuringLatency) m_probe.Poll();
+
+    std::scoped_lock lock(m_mutex);
+    if (m_request) {
+      if (m_activeTest) FinishTest();
+      m_activeTest = *m_request;
+      m_request.reset();
+
+      // Only keep the telemetry that arrives while the test is running, and
+      // move it onto the host clock if the clock offset has been measured.
+      if (m_activeTest) {
+        m_capture.Reset();
+        m_capture.SetClockOffset(m_probe.GetClockOffset());
+        m_testStart = std::chrono::steady_clock::now();
+      }
+    }
+    if (m_activeTest) SendCommand();
+
+    m_status.connected = m_connected;
+    m_status.rate = m_capture.GetRate();
+    m_status.received = m_capture.GetSamples().size();
+    m_status.dropped = m_capture.GetDropped();
+    m_status.deliveryDelay = m_capture.GetDeliveryDelay();
+    m_status.pingsSent = m_probe.GetSent();
+    m_status.pingsAnswered = m_probe.GetAnswered();
+    m_status.roundTrip = m_probe.GetRoundTrip();
+    m_status.sensorDelay = m_probe.GetSensorDelay();
+    m_status.clockOffset = m_probe.GetClockOffset();
+  }
+}
+
+void CaptureSession::PollConnection() {
+  bool timedOut;
+  bool changed = false;
+  for (auto&& event :
+       nt::PollConnectionListener(m_connectionPoller, 0, &timedOut)) {
+    m_connected = event.connected;
+    changed = true;
+  }
+  if (changed && m_onChange) m_onChange();
+}
+
+void CaptureSession::SendCommand() {
+  // Calculate the voltage of the running test.
+  double voltage;
+  if (m_activeTest->rotate) {
+    voltage = m_voltages.rotation;
+  } else if (m_activeTest->quasistatic) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - m_testStart;
+    voltage = m_voltages.quasistaticRamp * elapsed.count();
+  } else {
+    voltage = m_voltages.dynamicStep;
+  }
+  if (m_activeTest->backward) voltage = -voltage;
+
+  // The robot applies the autospeed as a fraction of its battery voltage.
+  nt::SetEntryValue(m_autospeedEntry,
+                    nt::Value::MakeDouble(std::clamp(
+                        voltage / kNominalBatteryVoltage, -1.0, 1.0)));
+  nt::SetEntryValue(m_rotateEntry,
+                    nt::Value::MakeBoolean(m_activeTest->rotate));
+}
+
+void CaptureSession::FinishTest() {
+  nt::SetEntryValue(m_autospeedEntry, nt::Value::MakeDouble(0.0));
+  nt::SetEntryValue(m_rotateEntry, nt::Value::MakeBoolean(false));
+  nt::Flush(m_inst);
+
+  m_data[m_activeTest->key] = m_capture.GetSamples();
+  if (auto shift = m_capture.GetTimestampShift())
+    m_clockOffsets[m_activeTest->key] = *shift;
+  else
+    m_clockOffsets.erase(m_activeTest->key);
+  m_activeTest = nullptr;
+}
+
+std::string CaptureSession::WriteDataFile(const std::string& folder,
+                                          const std::string& name,
+                                          const std::string& projectType,
+                                          double unitsPerRotation) const {
+  // Record when the run happened, which run archives use as its date.
+  std::tm time = LocalTime(std::time(nullptr));
+  char date[32];
+  std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &time);
+
+  // Copy the telemetry, and build the JSON from the copy once the lock is
+  // released, so the capture thread only waits for the copy.
+  Status status;
+  wpi::StringMap<double> clockOffsets;
+  wpi::StringMap<std::vector<TelemetryCapture::Sample>> data;
+  {
+    std::scoped_lock lock(m_mutex);
+    status = m_status;
+    clockOffsets = m_clockOffsets;
+    data = m_data;
+  }
+
+  wpi::json json;
+  json["test"] = projectType;
+  json["unitsPerRotation"] = unitsPerRotation;
+  json["date"] = date;
+
+  // Store the measured latency, along with the value that was subtracted from
+  // the timestamps of each test that was moved onto the host clock (the clock
+  // offset plus the host time at which the test started), so the robot
+  // timestamps can be recovered. The Analyzer uses the sensor delay as the
+  // latency of its gains.
+  if (status.pingsAnswered > 0) {
+    auto& latency = json["latency"];
+    latency["sensor"] = status.sensorDelay.mean;
+    latency["roundTrip"] = status.roundTrip.mean;
+    latency["clockOffsets"] = wpi::json::object();
+    for (auto&& test : kTests) {
+      auto offset = clockOffsets.find(test.key);
+      if (offset != clockOffsets.end())
+        latency["clockOffsets"][test.key] = offset->second;
+    }
+  }
+
+  // Store the tests in the same format as the robot project, with empty data
+  // for the tests that were not run.
+  for (auto&& test : kTests) {
+    auto samples = data.find(test.key);
+    if (samples != data.end())
+      json[test.key] = samples->second;
+    else if (!test.rotate)
+      json[test.key] = wpi::json::array();
+  }
+
+  // Name the file after the robot and the current time, with a number added
+  // if a file of that name exists, so that runs are never overwritten, even
+  // when several robots (or the same one twice) are saved in one second.
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &time);
+  std::string path = CreateUniqueFile(folder + "/characterization-data-" +
+                                      name + "-" + stamp);
+
+  std::error_code ec;
+  wpi::raw_fd_ostream output(path, ec);
+  if (ec) return "Could not save " + path + ": " + ec.message();
+  output << json.dump(2);
+  return "Saved " + path;
+}
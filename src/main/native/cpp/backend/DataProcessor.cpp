@@ -2,140 +2,607 @@
 
 #include "backend/DataProcessor.h"
 
-#include <frc/controller/LinearQuadraticRegulator.h>
-#include <frc/system/plant/LinearSystemId.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
 #include <wpi/json.h>
 #include <wpi/raw_istream.h>
-#include <wpi/raw_ostream.h>
 
+#include "backend/KinematicSmoother.h"
 #include "backend/OLS.h"
+#include "backend/TrimOptimizer.h"
 
 using namespace frcchar;
 
+namespace {
+// The tests in the JSON, in the order in which their samples are stored.
+struct TestInfo {
+  const char* name;
+  bool quasistatic;
+  bool backward;
+};
+
+constexpr TestInfo kTests[] = {{"slow-forward", true, false},
+                               {"fast-forward", false, false},
+                               {"slow-backward", true, true},
+                               {"fast-backward", false, true}};
+}  // namespace
+
 DataProcessor::DataProcessor(std::string* path, FFGains* ffGains,
                              FBGains* fbGains, GainPreset* preset,
-                             LQRParameters* params, int* dataType)
+                             LQRParameters* params, int* dataType,
+                             bool compact, size_t run, double smoothing,
+                             bool resample, bool optimizeTrim)
     : m_path(*path),
       m_ffGains(*ffGains),
       m_fbGains(*fbGains),
       m_preset(*preset),
       m_lqrParams(*params),
+      m_run(run),
+      m_compact(compact),
+      m_smoothing(smoothing),
+      m_resample(resample),
+      m_optimizeTrim(optimizeTrim),
       m_dataset(*dataType) {
-  // Parse the JSON and extract all the relevant data from it.
-  std::error_code ec;
-  wpi::raw_fd_istream input(m_path, ec);
-  wpi::json json;
-  input >> json;
-
-  // Get the project type and units per rotation (factor).
-  m_projectType = json.at("test").get<std::string>();
-  m_factor = units::meter_t(json.at("unitsPerRotation").get<double>());
-
-  // Extract the 4 primary data sets.
-  RawData sf = json.at("slow-forward").get<RawData>();
-  RawData sb = json.at("slow-backward").get<RawData>();
-  RawData ff = json.at("fast-forward").get<RawData>();
-  RawData fb = json.at("fast-backward").get<RawData>();
-
-  // Clean the data to ensure that voltages have the correct signs and that all
-  // conversion factors are applied.
-  auto clean = [&](std::initializer_list<RawData*> vecs) {
-    for (auto ptr : vecs) {
-      for (auto&& pt : *ptr) {
-        pt[3] = std::copysign(pt[3], pt[7]);
-        pt[4] = std::copysign(pt[4], pt[8]);
-        pt[7] *= m_factor.to<double>();
-        pt[8] *= m_factor.to<double>();
-      }
+  if (!m_path.empty()) Load();
+}
+
+size_t DataProcessor::GetMemoryUsage() const {
+  size_t bytes = m_data.GetMemoryUsage();
+  for (auto&& rows : m_appendedRows)
+    bytes += rows.second.capacity() * sizeof(Row);
+  return bytes;
+}
+
+SamplingStats DataProcessor::GetSamplingStats() const {
+  SamplingStats stats;
+  for (auto&& test : m_tests) stats.Merge(test.second.sampling);
+  return stats;
+}
+
+bool DataProcessor::Refresh() {
+  try {
+    return Load();
+  } catch (const wpi::json::exception&) {
+    // The file is most likely still being written. The next change to the
+    // file will trigger another attempt.
+    return false;
+  } catch (const std::runtime_error&) {
+    // The same goes for a session archive that fails its checksums.
+    return false;
+  }
+}
+
+bool DataProcessor::LoadSamples(wpi::json json) { return Load(&json); }
+
+bool DataProcessor::AppendSamples(const wpi::json& batch) {
+  if (!batch.is_object())
+    throw std::runtime_error("The samples must be a JSON object.");
+  if (!m_appendedSettings.is_object())
+    m_appendedSettings = wpi::json::object();
+
+  // The batch is converted before it is stored so that a malformed sample
+  // does not leave part of a test behind.
+  for (auto it = batch.begin(); it != batch.end(); ++it) {
+    if (!it.value().is_array()) {
+      m_appendedSettings[it.key()] = it.value();
+      continue;
     }
+    std::vector<Row> rows;
+    rows.reserve(it.value().size());
+    for (auto&& sample : it.value()) rows.push_back(sample.get<Row>());
+    auto& stored = m_appendedRows[it.key()];
+    stored.insert(stored.end(), rows.begin(), rows.end());
+  }
+  return Load();
+}
+
+bool DataProcessor::Load(wpi::json* json) {
+  // The raw samples and other scratch buffers of the last load are no longer
+  // needed, so their memory is reused for this one.
+  m_arena.Reset();
+  auto allocations = GetThreadAllocations();
+
+  bool changed;
+  if (json) {
+    changed = LoadJson(std::move(*json));
+  } else if (m_path.empty()) {
+    changed = LoadAppended();
+  } else if (IsSessionArchive(m_path)) {
+    changed = LoadArchive();
+  } else if (IsRunArchive(m_path)) {
+    changed = LoadRunArchive();
+  } else {
+    std::error_code ec;
+    wpi::raw_fd_istream input(m_path, ec);
+    if (ec) throw std::runtime_error("Could not open " + m_path);
+    wpi::json file;
+    input >> file;
+    changed = LoadJson(std::move(file));
+  }
+  if (changed && m_optimizeTrim) ApplyTrimOptimization();
+
+  m_loadAllocations = GetThreadAllocations() - allocations;
+  return changed;
+}
+
+bool DataProcessor::LoadJson(wpi::json json) {
+  m_archiveStats.reset();
+
+  // If the JSON is missing samples that we have already processed, or its
+  // settings have changed, it is a different run and we have to start over.
+  bool missing = false;
+  for (auto&& test : kTests)
+    missing |= IsOutdated(test.name, json.at(test.name).size());
+  CheckRun(json.at("test").get<std::string>(),
+           units::meter_t(json.at("unitsPerRotation").get<double>()),
+           missing);
+  ReadLatency(json);
+
+  // Converts the samples of a test, starting at the given one, to rows.
+  auto getRows = [&](const wpi::json& samples, size_t begin) {
+    RawData data = MakeRawData();
+    data.reserve(samples.size() - std::min(begin, samples.size()));
+    for (size_t i = begin; i < samples.size(); ++i)
+      data.push_back(samples[i].get<Row>());
+    return data;
   };
 
-  clean({&sf, &sb, &ff, &fb});
+  // Estimate the track width from the rotation test if this is a drivetrain.
+  auto trackWidth = json.find("track-width");
+  if (m_data.m_drivetrain && trackWidth != json.end())
+    m_data.m_trackWidth = CalculateTrackWidth(getRows(*trackWidth, 0));
 
-  // Trim the quasistatic test data.
-  TrimQuasistaticData(&sf);
-  TrimQuasistaticData(&sb);
+  // Process the new samples of each test. Only the samples that we have not
+  // seen yet are converted, and each test is released from the JSON as soon
+  // as it has been processed so that only one raw test is held at a time.
+  bool changed = false;
+  for (auto&& test : kTests) {
+    auto& state = m_tests[test.name];
+    const auto& samples = json.at(test.name);
 
-  // Get prepared quasistatic and step voltage data.
-  auto sfp = PrepareDataForAnalysis(&sf);
-  auto sbp = PrepareDataForAnalysis(&sb);
-  auto ffp = PrepareDataForAnalysis(&ff);
-  auto fbp = PrepareDataForAnalysis(&fb);
+    RawData data = getRows(samples, state.consumed);
+    state.consumed = samples.size();
+    json.erase(test.name);
 
-  // Trim prepared step-voltage data.
-  TrimStepVoltageData(&ffp);
-  TrimStepVoltageData(&fbp);
+    changed |= ProcessTest(&data, &state, test.quasistatic, test.name);
+  }
+  return changed;
+}
 
-  // Store the data inside our map.
-  auto& fwdEntry = m_data["Forward"];
-  fwdEntry = std::move(sfp);
-  fwdEntry.insert(fwdEntry.end(), std::make_move_iterator(ffp.begin()),
-                  std::make_move_iterator(ffp.end()));
-  auto& bwdEntry = m_data["Backward"];
-  bwdEntry = std::move(sbp);
-  bwdEntry.insert(bwdEntry.end(), std::make_move_iterator(fbp.begin()),
-                  std::make_move_iterator(fbp.end()));
-  auto& cmbEntry = m_data["Combined"];
-  cmbEntry.insert(cmbEntry.end(), fwdEntry.begin(), fwdEntry.end());
-  cmbEntry.insert(cmbEntry.end(), bwdEntry.begin(), bwdEntry.end());
+bool DataProcessor::LoadAppended() {
+  m_archiveStats.reset();
+  const auto& settings = m_appendedSettings;
+
+  bool missing = false;
+  for (auto&& test : kTests)
+    missing |= IsOutdated(test.name, m_appendedRows[test.name].size());
+  CheckRun(settings.at("test").get<std::string>(),
+           units::meter_t(settings.at("unitsPerRotation").get<double>()),
+           missing);
+  ReadLatency(settings);
+
+  // Copies the rows of a test, starting at the given one, to the arena.
+  auto getRows = [&](wpi::StringRef name, size_t begin) {
+    const auto& rows = m_appendedRows[name];
+    RawData data = MakeRawData();
+    data.assign(rows.begin() + std::min(begin, rows.size()), rows.end());
+    return data;
+  };
+
+  if (m_data.m_drivetrain && m_appendedRows.count("track-width"))
+    m_data.m_trackWidth = CalculateTrackWidth(getRows("track-width", 0));
+
+  bool changed = false;
+  for (auto&& test : kTests) {
+    auto& state = m_tests[test.name];
+    RawData data = getRows(test.name, state.consumed);
+    state.consumed += data.size();
+    changed |= ProcessTest(&data, &state, test.quasistatic, test.name);
+  }
+  return changed;
+}
+
+bool DataProcessor::LoadArchive() {
+  ArchiveStats stats;
+  Session session = ReadSessionArchive(m_path, &stats);
+  m_archiveStats = stats;
+
+  auto getRows = [&](const char* name, size_t begin) {
+    const SessionTest* test = session.Find(name);
+    if (!test) throw std::runtime_error(std::string("Missing test ") + name);
+    return GetRows(*test, begin);
+  };
+
+  const auto& settings = session.settings;
+  bool missing = false;
+  for (auto&& test : kTests) {
+    const SessionTest* samples = session.Find(test.name);
+    missing |= samples && IsOutdated(test.name, samples->Size());
+  }
+  CheckRun(settings.at("test").get<std::string>(),
+           units::meter_t(settings.at("unitsPerRotation").get<double>()),
+           missing);
+  ReadLatency(settings);
+
+  if (m_data.m_drivetrain && session.Find("track-width"))
+    m_data.m_trackWidth = CalculateTrackWidth(getRows("track-width", 0));
+
+  bool changed = false;
+  for (auto&& test : kTests) {
+    auto& state = m_tests[test.name];
+    RawData data = getRows(test.name, state.consumed);
+    state.consumed += data.size();
+    changed |= ProcessTest(&data, &state, test.quasistatic, test.name);
+  }
+  return changed;
+}
+
+bool DataProcessor::LoadRunArchive() {
+  RunArchive archive(m_path);
+  if (m_run >= archive.GetRuns().size())
+    throw std::runtime_error("The run archive does not contain the run.");
+  const auto& run = archive.GetRuns()[m_run];
+
+  m_runSamples.clear();
+  bool missing = false;
+  for (auto&& segment : run.segments) {
+    m_runSamples[segment.test] = segment.samples;
+    missing |= IsOutdated(segment.test, segment.samples);
+  }
+
+  auto settings = wpi::json::parse(run.settings);
+  bool reset = CheckRun(
+      run.mechanism,
+      units::meter_t(settings.at("unitsPerRotation").get<double>()), missing);
+  if (reset) m_archiveStats = ArchiveStats{};
+  ReadLatency(settings);
+
+  // Only the segments that are needed are read from the archive.
+  auto load = [&](const char* test, size_t begin) {
+    ArchiveStats stats;
+    RawData data = GetRows(archive.LoadSegment(m_run, test, &stats), begin);
+    m_archiveStats->rawBytes += stats.rawBytes;
+    m_archiveStats->archiveBytes += stats.archiveBytes;
+    m_archiveStats->decodeTime += stats.decodeTime;
+    return data;
+  };
+
+  if (reset && m_data.m_drivetrain && run.Find("track-width"))
+    m_data.m_trackWidth = CalculateTrackWidth(load("track-width", 0));
+
+  bool changed = false;
+  for (auto&& test : kTests) {
+    auto& state = m_tests[test.name];
+    if (!IsNeeded(test.name) || state.consumed >= m_runSamples[test.name])
+      continue;
+
+    RawData data = load(test.name, state.consumed);
+    state.consumed += data.size();
+    changed |= ProcessTest(&data, &state, test.quasistatic, test.name);
+  }
+  return changed;
+}
+
+bool DataProcessor::IsOutdated(wpi::StringRef test, size_t samples) {
+  // When smoothing, the estimates of every sample depend on all of the
+  // samples of the test, and when resampling, the grid depends on the period
+  // of the whole test, so new samples require the test to be processed again
+  // from the start. The same goes for a step voltage test that was trimmed
+  // before the peak of its acceleration had been seen. The optimized trim
+  // has already cut every test, and cutting them again would remove more
+  // samples, so new samples of any test require all of them to be processed
+  // again and the trim to be optimized on the untrimmed data.
+  const auto& state = m_tests[test];
+  size_t consumed = state.consumed;
+  return samples < consumed ||
+         ((m_smoothing > 0 || m_resample || state.trimPending) &&
+          consumed > 0 && samples > consumed) ||
+         (m_trim && samples > consumed);
+}
+
+bool DataProcessor::IsNeeded(wpi::StringRef test) const {
+  // The trim is optimized for all of the tests together.
+  if (m_optimizeTrim) return true;
+  for (auto&& segment : m_data.GetSegments(m_dataset)) {
+    if (segment->test == test) return true;
+  }
+  return false;
+}
+
+bool DataProcessor::IsMissingTests() const {
+  if (!IsRunArchive(m_path)) return false;
+  for (auto&& test : kTests) {
+    auto samples = m_runSamples.find(test.name);
+    auto state = m_tests.find(test.name);
+    size_t consumed = state != m_tests.end() ? state->second.consumed : 0;
+    if (IsNeeded(test.name) && samples != m_runSamples.end() &&
+        consumed < samples->second)
+      return true;
+  }
+  return false;
+}
+
+DataProcessor::RawData DataProcessor::GetRows(const SessionTest& test,
+                                              size_t begin) {
+  if (test.columns.size() != std::tuple_size<RawData::value_type>::value)
+    throw std::runtime_error("Unexpected columns in " + test.name);
+
+  RawData data = MakeRawData();
+  data.resize(test.Size() - std::min(begin, test.Size()));
+  for (size_t col = 0; col < test.columns.size(); ++col) {
+    const auto& column = test.columns[col];
+    for (size_t i = 0; i < data.size(); ++i) data[i][col] = column[begin + i];
+  }
+  return data;
+}
+
+bool DataProcessor::CheckRun(std::string projectType, units::meter_t factor,
+                             bool missing) {
+  if (!missing && projectType == m_projectType && factor == m_factor)
+    return false;
+
+  m_projectType = std::move(projectType);
+  m_factor = factor;
+  m_data.m_drivetrain =
+      wpi::StringRef(m_projectType).equals_lower("drivetrain");
+  Reset();
+
+  // Make sure the selected data set exists for this type of mechanism.
+  int sources = m_data.m_drivetrain ? std::size(kDrivetrainDataSources)
+                                    : std::size(kDataSources);
+  m_dataset = std::min(m_dataset, sources - 1);
+  return true;
+}
+
+void DataProcessor::ReadLatency(const wpi::json& settings) {
+  // Data from before the Logger measured latency does not have it.
+  m_measuredLatency.reset();
+  auto latency = settings.find("latency");
+  if (latency == settings.end() || !latency->is_object()) return;
+  auto sensor = latency->find("sensor");
+  if (sensor != latency->end() && sensor->is_number())
+    m_measuredLatency = units::second_t(sensor->get<double>());
+}
+
+void DataProcessor::RegularizeSampling(RawData* data, TestState* state) {
+  // Include the latest sample of the previous load so that the interval
+  // between the loads is measured too.
+  bool resume = std::isfinite(state->latestTime);
+  ArenaVector<double> time{ArenaAllocator<double>(&m_arena)};
+  time.reserve(data->size() + 1);
+  if (resume) time.push_back(state->latestTime);
+  for (auto&& pt : *data) time.push_back(pt[0]);
+  SamplingStats stats = AnalyzeSampling(time.data(), time.size(), &m_arena);
+  stats.samples = data->size();
+  state->sampling.Merge(stats);
+
+  // Samples whose time did not increase would make the secant acceleration
+  // divide by zero (or go backwards), so they are dropped.
+  auto end = std::remove_if(data->begin(), data->end(), [&](const auto& pt) {
+    if (pt[0] <= state->latestTime) return true;
+    state->latestTime = pt[0];
+    return false;
+  });
+  data->erase(end, data->end());
+
+  // The whole test is processed at once when resampling (see IsOutdated()),
+  // so the grid covers all of it at the period of the whole test.
+  if (m_resample) {
+    double period = state->sampling.period;
+    *data = ResampleUniform(*data, period, SamplingStats::kGapPeriods * period,
+                            &m_arena);
+  }
+}
+
+bool DataProcessor::ProcessTest(RawData* data, TestState* state,
+                                bool quasistatic, const char* test) {
+  RegularizeSampling(data, state);
+  if (data->empty()) return false;
+
+  // Clean the new data and trim it if it is quasistatic test data.
+  CleanData(data);
+  if (quasistatic)
+    TrimQuasistaticData(data, m_optimizeTrim
+                                  ? 0.0
+                                  : kQuasistaticVelocityThreshold.to<double>());
+
+  // Put the last two samples from the previous load back in front so that
+  // the previously last sample can now have its acceleration calculated.
+  // Both sides of a drivetrain are prepared in the same pass.
+  data->insert(data->begin(), state->tail.begin(), state->tail.end());
+  Segment* left = GetSegment(test, false);
+  Segment* right = m_data.m_drivetrain ? GetSegment(test, true) : nullptr;
+  size_t leftBegin = left->data.Size();
+  size_t rightBegin = right ? right->data.Size() : 0;
+  PrepareDataForAnalysis(data, &left->data, right ? &right->data : nullptr);
+  state->tail.assign(data->end() - std::min<size_t>(data->size(), 2),
+                     data->end());
+
+  // Trim prepared step-voltage data. This only needs to happen once because
+  // the trimmed samples are all at the start of the test, unless the data
+  // ended before the peak of the acceleration (see IsOutdated()).
+  if (!quasistatic && !state->trimmed && !m_optimizeTrim &&
+      left->data.Size() > 0) {
+    bool confirmed = TrimStepVoltageData(&left->data);
+    if (right) confirmed &= TrimStepVoltageData(&right->data);
+    state->trimmed = true;
+    state->trimPending = !confirmed;
+  }
+
+  if (left->data.Size() == leftBegin) return false;
+
+  // Add the new samples to the regression sums of each side. Large batches
+  // are already summed in parallel chunks by Sums().
+  left->sums += left->data.Sums(leftBegin, left->data.Size());
+  if (right) right->sums += right->data.Sums(rightBegin, right->data.Size());
+
+  return true;
+}
+
+DataProcessor::Segment* DataProcessor::GetSegment(wpi::StringRef test,
+                                                  bool right) {
+  for (auto&& segment : m_data.m_segments) {
+    if (segment->test != test || segment->right != right) continue;
+    if (segment.use_count() > 1) segment = std::make_shared<Segment>(*segment);
+    return segment.get();
+  }
+  return nullptr;
+}
+
+units::meter_t DataProcessor::CalculateTrackWidth(const RawData& data) {
+  if (data.size() < 2) return units::meter_t(std::nan(""));
+
+  // When the robot turns in place, each side travels along a circle whose
+  // diameter is the track width. The distance traveled by both sides
+  // together is therefore the track width multiplied by the angle turned.
+  double left = (data.back()[5] - data.front()[5]) * m_factor.to<double>();
+  double right = (data.back()[6] - data.front()[6]) * m_factor.to<double>();
+  double angle = data.back()[9] - data.front()[9];
+
+  // A gyro that barely turned would divide the distances by about zero.
+  if (std::abs(angle) < kMinTrackWidthAngle)
+    return units::meter_t(std::nan(""));
+  return units::meter_t((std::abs(left) + std::abs(right)) / std::abs(angle));
+}
+
+void DataProcessor::ApplyTrimOptimization() {
+  std::vector<TrimSegment> segments;
+  for (auto&& segment : m_data.m_segments) {
+    std::string name = segment->test;
+    if (m_data.m_drivetrain) name += segment->right ? " (right)" : " (left)";
+    segments.push_back({name, &segment->data, segment->quasistatic});
+  }
+  TrimResult trim = OptimizeTrim(segments, &m_arena);
+
+  // Cut the segments, which may have to be copied first, and sum them again.
+  for (size_t i = 0; i < m_data.m_segments.size(); ++i) {
+    Segment* segment = GetSegment(m_data.m_segments[i]->test,
+                                  m_data.m_segments[i]->right);
+    auto& data = segment->data;
+    if (segments[i].quasistatic) {
+      data.RemoveIf([&](size_t j) {
+        return std::abs(data.Velocity(j)) <= trim.threshold;
+      });
+    } else {
+      data.EraseFront(trim.starts[i]);
+    }
+    segment->sums = data.Sums(0, data.Size());
+  }
+  m_trim = std::move(trim);
+}
+
+void DataProcessor::Reset() {
+  m_data.m_segments.clear();
+  m_trim.reset();
+  m_data.m_trackWidth = units::meter_t(std::nan(""));
+  m_tests.clear();
+
+  // Create a segment for each test, with one for each side of a drivetrain.
+  for (auto&& test : kTests) {
+    for (bool right : {false, true}) {
+      if (right && !m_data.m_drivetrain) continue;
+      m_data.m_segments.push_back(std::make_shared<Segment>(Segment{
+          test.name, right, test.backward, test.quasistatic,
+          PreparedData(m_compact), {}}));
+    }
+  }
 }
 
 void DataProcessor::Update() {
-  CalculateFeedforwardGains();
-  if (m_preset.velocity)
-    CalculateVelocityFeedbackGains();
-  else
-    CalculatePositionFeedbackGains();
-}
-
-void DataProcessor::TrimQuasistaticData(
-    std::vector<std::array<double, 10>>* data) {
-  data->erase(
-      std::remove_if(data->begin(), data->end(),
-                     [](const auto& pt) {
-                       return std::abs(pt[3]) <= 0 || std::abs(pt[4]) <= 0 ||
-                              std::abs(pt[7]) <=
-                                  kQuasistaticVelocityThreshold.to<double>() ||
-                              std::abs(pt[8]) <=
-                                  kQuasistaticVelocityThreshold.to<double>();
-                     }),
-      data->end());
-}
-std::vector<double> DataProcessor::PrepareDataForAnalysis(
-    std::vector<std::array<double, 10>>* data) {
-  // The format for the return vector is as follows:
-  // voltage, intercept term, velocity, acceleration.
-
-  // We will first create the return vector and pre-allocate the memory that
-  // we require.
-  std::vector<double> r;
-  r.reserve(data->size() * 4 - 8);
-
-  for (size_t i = 0; i < data->size(); ++i) {
-    // We don't want to include the first and last data points because they
-    // will purely be used for acceleration calculations.
-    if (i == 0 || i == data->size() - 1) continue;
-
-    // Add voltage, intercept term, and velocity.
-    r.push_back(data->at(i)[3]);
-    r.push_back(std::copysign(1.0, data->at(i)[7]));
-    r.push_back(data->at(i)[7]);
-
-    // Calculate acceleration.
-    double acceleration = (data->at(i + 1)[7] - data->at(i - 1)[7]) /
-                          (data->at(i + 1)[0] - data->at(i - 1)[0]);
-
-    // Add the acceleration value to the vector.
-    r.push_back(acceleration);
-  }
-
-  return r;
-}
-
-void DataProcessor::TrimStepVoltageData(std::vector<double>* data) {
+  if (IsMissingTests()) Refresh();
+
+  // The analysis itself does not allocate, which the allocation test checks.
+  auto allocations = GetThreadAllocations();
+  auto result = Analyze(m_data, {m_dataset, m_preset, m_lqrParams});
+  m_updateAllocations = GetThreadAllocations() - allocations;
+
+  m_ffGains = result.ff;
+  m_fbGains = result.fb;
+}
+
+void DataProcessor::CleanData(RawData* data) {
+  for (auto&& pt : *data) {
+    pt[3] = std::copysign(pt[3], pt[7]);
+    pt[4] = std::copysign(pt[4], pt[8]);
+    pt[7] *= m_factor.to<double>();
+    pt[8] *= m_factor.to<double>();
+  }
+}
+
+void DataProcessor::TrimQuasistaticData(RawData* data, double threshold) {
+  data->erase(std::remove_if(data->begin(), data->end(),
+                             [threshold](const auto& pt) {
+                               return std::abs(pt[3]) <= 0 ||
+                                      std::abs(pt[4]) <= 0 ||
+                                      std::abs(pt[7]) <= threshold ||
+                                      std::abs(pt[8]) <= threshold;
+                             }),
+              data->end());
+}
+void DataProcessor::PrepareDataForAnalysis(RawData* data, PreparedData* left,
+                                           PreparedData* right) {
+  // The prepared data stores the time, voltage, velocity, and acceleration of
+  // each sample. The intercept term is derived from the sign of the velocity.
+  if (data->size() < 3) return;
+
+  // We will first pre-allocate the memory that we require.
+  left->Reserve(left->Size() + data->size() - 2);
+  if (right) right->Reserve(right->Size() + data->size() - 2);
+
+  // If smoothing is enabled, estimate the velocity and acceleration of each
+  // side with the smoother.
+  size_t size = data->size();
+  ArenaAllocator<double> allocator(&m_arena);
+  ArenaVector<double> time(allocator), measured(allocator),
+      smoothVelocity[2] = {ArenaVector<double>(allocator),
+                           ArenaVector<double>(allocator)},
+      smoothAcceleration[2] = {ArenaVector<double>(allocator),
+                               ArenaVector<double>(allocator)};
+  if (m_smoothing > 0) {
+    time.resize(size);
+    measured.resize(size);
+    for (size_t i = 0; i < size; ++i) time[i] = (*data)[i][0];
+    for (size_t side = 0; side < (right ? 2 : 1); ++side) {
+      for (size_t i = 0; i < size; ++i) measured[i] = (*data)[i][7 + side];
+      smoothVelocity[side].resize(size);
+      smoothAcceleration[side].resize(size);
+      SmoothKinematics(time.data(), measured.data(), size, m_smoothing,
+                       smoothVelocity[side].data(),
+                       smoothAcceleration[side].data(), &m_arena);
+    }
+  }
+
+  // Adds one sample of one side, given the voltage and velocity columns.
+  auto add = [&](PreparedData* r, size_t i, size_t voltage, size_t velocity) {
+    const auto& pt = data->at(i);
+    if (m_smoothing > 0) {
+      r->Append(pt[0], pt[voltage], smoothVelocity[velocity - 7][i],
+                smoothAcceleration[velocity - 7][i]);
+      return;
+    }
+
+    // Calculate acceleration and add it with the time, voltage, and velocity.
+    r->Append(pt[0], pt[voltage], pt[velocity],
+              (data->at(i + 1)[velocity] - data->at(i - 1)[velocity]) /
+                  (data->at(i + 1)[0] - data->at(i - 1)[0]));
+  };
+
+  // We don't want to include the first and last data points because they
+  // will purely be used for acceleration calculations.
+  for (size_t i = 1; i < size - 1; ++i) {
+    add(left, i, 3, 7);
+    if (right) add(right, i, 4, 8);
+  }
+}
+
+bool DataProcessor::TrimStepVoltageData(PreparedData* data) {
   // We want to find when the acceleration data roughly stops increasing at
   // the beginning.
-  size_t idx = 3;
+  size_t idx = 0;
 
   // We will use this to make sure that the acceleration is decreasing for 3
   // consecutive entries in a row. This will help avoid false positives from
@@ -143,14 +610,14 @@ void DataProcessor::TrimStepVoltageData(std::vector<double>* data) {
   bool caution = false;
 
   // Iterate through the acceleration values and check where we hit the max.
-  for (size_t i = 3; i < data->size(); i += 4) {
+  for (size_t i = 0; i < data->Size(); ++i) {
     // Get the current acceleration.
-    double acceleration = std::abs(data->at(i));
+    double acceleration = std::abs(data->Acceleration(i));
 
     // If we are not in caution, the acceleration values are still
     // increasing..
     if (!caution) {
-      if (acceleration < std::abs(data->at(idx)))
+      if (acceleration < std::abs(data->Acceleration(idx)))
         // We found a potential candidate. Let's mark the flag and continue
         // checking...
         caution = true;
@@ -160,78 +627,21 @@ void DataProcessor::TrimStepVoltageData(std::vector<double>* data) {
     } else {
       // Check to make sure the acceleration value is still smaller. If it
       // isn't, break out of caution.
-      if (acceleration >= std::abs(data->at(idx))) {
+      if (acceleration >= std::abs(data->Acceleration(idx))) {
         caution = false;
         idx = i;
       }
     }
 
     // If we were in caution for three iterations, we can exit.
-    if (caution && (i - idx) == 12) break;
+    if (caution && (i - idx) == 3) break;
   }
 
-  wpi::outs() << "[INFO] Exit step voltage trim at " << idx << " out of "
-              << data->size() << "\n";
+  // The loop only stops early once the acceleration has decreased for three
+  // samples after the maximum.
+  bool confirmed = caution && data->Size() > idx + 3;
 
   // Remove all values before that maximum.
-  data->erase(data->begin(), data->begin() + idx - 3);
-
-  // Make sure that we still have a multiple of 4 elements in the vector. This
-  // is to catch off-by-one errors.
-  assert(data->size() % 4 == 0);
-}
-
-void DataProcessor::CalculateFeedforwardGains() {
-  const std::vector<double>& vec = m_data[kDataSources[m_dataset]];
-  std::vector<double> results = frcchar::OLS(vec, 3);
-
-  m_ffGains = {units::volt_t(results[0]), units::Kv_t(results[1]),
-               units::Ka_t(results[2]), results[3]};
-}
-
-void DataProcessor::CalculatePositionFeedbackGains() {
-  if (m_ffGains.Ka.to<double>() > 1E-7) {
-    // Get the position system given Kv and Ka.
-    auto system = frc::LinearSystemId::IdentifyPositionSystem<units::meter>(
-        m_ffGains.Kv, m_ffGains.Ka);
-    // Create LQR controller.
-    auto lqr = frc::LinearQuadraticRegulator<2, 1>(
-        system, {m_lqrParams.qp.to<double>(), m_lqrParams.qv.to<double>()},
-        {m_lqrParams.maxEffort.to<double>()}, m_preset.dt);
-    lqr.LatencyCompensate(system, m_preset.dt, m_preset.latency);
-
-    m_fbGains = {lqr.K(0, 0), lqr.K(0, 1)};
-  } else {
-    auto system = frc::LinearSystem<1, 1, 1>(
-        frc::MakeMatrix<1, 1>(0.0), frc::MakeMatrix<1, 1>(1.0),
-        frc::MakeMatrix<1, 1>(1.0), frc::MakeMatrix<1, 1>(0.0));
-    auto lqr = frc::LinearQuadraticRegulator<1, 1>(
-        system, {m_lqrParams.qp.to<double>()}, {m_lqrParams.qv.to<double>()},
-        m_preset.dt);
-    lqr.LatencyCompensate(system, m_preset.dt, m_preset.latency);
-    m_fbGains = {m_ffGains.Kv.to<double>() * lqr.K(0, 0), 0};
-  }
-}
-
-void DataProcessor::CalculateVelocityFeedbackGains() {
-  using namespace frc;
-
-  // If acceleration for velocity control requires no effort, the feedback
-  // control gains approach zero. We special-case it here because numerical
-  // instabilities arise in the LQR otherwise.
-  if (m_ffGains.Ka.to<double>() < 1E-7) m_fbGains = {0, 0};
-
-  // Create a velocity system from our feedforward gains.
-  auto sys = LinearSystemId::IdentifyVelocitySystem<units::meter>(m_ffGains.Kv,
-                                                                  m_ffGains.Ka);
-  // Create LQR controller for optimal gains.
-  auto lqr = LinearQuadraticRegulator<1, 1>(
-      sys, {m_lqrParams.qv.to<double>()}, {m_lqrParams.maxEffort.to<double>()},
-      m_preset.dt);
-
-  // Compensate for sensor delay.
-  lqr.LatencyCompensate(sys, m_preset.dt, m_preset.latency);
-
-  // Return gains.
-  m_fbGains = {lqr.K(0, 0), 0};
+  data->EraseFront(idx);
+  return confirmed;
 }
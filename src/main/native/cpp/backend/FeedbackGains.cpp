@@ -0,0 +1,213 @@
+// MIT License
+
+#include "backend/FeedbackGains.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+
+using namespace frcchar;
+
+namespace {
+// Below this Ka, the mechanism is treated as having no inertia.
+constexpr double kMinKa = 1E-7;
+
+/**
+ * Returns (e^x - 1) / x, taking care of the removable singularity at zero.
+ */
+double Phi1(double x) {
+  if (std::abs(x) < 1E-5) return 1 + x / 2 + x * x / 6;
+  return std::expm1(x) / x;
+}
+
+/**
+ * Returns (e^x - 1 - x) / x^2, taking care of the removable singularity at
+ * zero.
+ */
+double Phi2(double x) {
+  if (std::abs(x) < 1E-3) return 0.5 + x / 6 + x * x / 24 + x * x * x / 120;
+  return (std::expm1(x) - x) / (x * x);
+}
+
+/**
+ * Solves the scalar discrete algebraic Riccati equation in closed form.
+ */
+double SolveDARE(double a, double b, double q, double r) {
+  // S = a^2 S - (abS)^2 / (b^2 S + r) + q rearranges to the quadratic
+  // b^2 S^2 + cS - qr = 0. We want the positive root, written so that it
+  // does not suffer from cancellation.
+  double c = r * (1 - a * a) - q * b * b;
+  double disc = std::sqrt(c * c + 4 * b * b * q * r);
+  return c > 0 ? 2 * q * r / (c + disc) : (disc - c) / (2 * b * b);
+}
+
+/**
+ * Solves the 2x2 discrete algebraic Riccati equation with the
+ * structure-preserving doubling algorithm. This converges quadratically, so
+ * only a handful of iterations are needed.
+ */
+Eigen::Matrix2d SolveDARE(const Eigen::Matrix2d& A, const Eigen::Vector2d& B,
+                          const Eigen::Matrix2d& Q, double R) {
+  Eigen::Matrix2d Ak = A;
+  Eigen::Matrix2d G = B * B.transpose() / R;
+  Eigen::Matrix2d H = Q;
+
+  for (int i = 0; i < 64; ++i) {
+    Eigen::Matrix2d W = (Eigen::Matrix2d::Identity() + G * H).inverse();
+    Eigen::Matrix2d AW = Ak * W;
+
+    Eigen::Matrix2d next = H + Ak.transpose() * H * W * Ak;
+    G += AW * G * Ak.transpose();
+    Ak = AW * Ak;
+
+    bool converged = (next - H).norm() <= 1E-13 * next.norm();
+    H = next;
+    if (converged) break;
+  }
+  return H;
+}
+
+/**
+ * Raises a 2x2 matrix to a real power using its eigenvalues (Sylvester's
+ * formula). This gives the same principal power as Eigen's MatrixPower.
+ */
+Eigen::Matrix2d Pow(const Eigen::Matrix2d& M, double p) {
+  using Complex = std::complex<double>;
+
+  double half = M.trace() / 2;
+  Complex disc = std::sqrt(Complex(half * half - M.determinant()));
+  Complex l1 = half + disc;
+  Complex l2 = half - disc;
+
+  Eigen::Matrix2cd Mc = M.cast<Complex>();
+  Eigen::Matrix2cd I = Eigen::Matrix2cd::Identity();
+
+  Eigen::Matrix2cd result;
+  if (std::abs(l1 - l2) > 1E-9 * std::max(1.0, std::abs(l1))) {
+    result = (std::pow(l1, p) * (Mc - l2 * I) -
+              std::pow(l2, p) * (Mc - l1 * I)) /
+             (l1 - l2);
+  } else {
+    result = std::pow(l1, p) * I + p * std::pow(l1, p - 1) * (Mc - l1 * I);
+  }
+  return result.real();
+}
+
+/**
+ * Calculates the LQR gain of a discrete scalar system, compensated for input
+ * latency.
+ */
+double ScalarGain(double a, double b, double q, double r, double dt,
+                  double latency) {
+  double S = SolveDARE(a, b, q, r);
+  double K = a * b * S / (b * b * S + r);
+  if (latency != 0) K *= std::pow(a - b * K, latency / dt);
+  return K;
+}
+
+FBGains PositionGains(double Kv, double Ka, double qp, double qv,
+                      double maxEffort, double dt, double latency) {
+  if (Ka > kMinKa) {
+    // Discretize x' = [[0, 1], [0, -Kv/Ka]] x + [0, 1/Ka]' u exactly.
+    double x = -Kv / Ka * dt;
+    Eigen::Matrix2d A;
+    A << 1, dt * Phi1(x), 0, std::exp(x);
+    Eigen::Vector2d B{dt * dt * Phi2(x) / Ka, dt * Phi1(x) / Ka};
+
+    Eigen::Matrix2d Q =
+        Eigen::Vector2d{1 / (qp * qp), 1 / (qv * qv)}.asDiagonal();
+    double R = 1 / (maxEffort * maxEffort);
+
+    Eigen::Matrix2d S = SolveDARE(A, B, Q, R);
+    Eigen::RowVector2d K = B.transpose() * S * A / (B.dot(S * B) + R);
+
+    // Compensate for sensor delay.
+    if (latency != 0) K = K * Pow(A - B * K, latency / dt);
+    return {K(0), K(1)};
+  } else {
+    // With no inertia, this is the x' = u system that DataProcessor uses.
+    double K = ScalarGain(1, dt, 1 / (qp * qp), 1 / (qv * qv), dt, latency);
+    return {Kv * K, 0};
+  }
+}
+
+FBGains VelocityGains(double Kv, double Ka, double qv, double maxEffort,
+                      double dt, double latency) {
+  // If acceleration for velocity control requires no effort, the feedback
+  // control gains approach zero.
+  if (Ka < kMinKa) return {0, 0};
+
+  // Discretize x' = -Kv/Ka x + 1/Ka u exactly.
+  double x = -Kv / Ka * dt;
+  double K = ScalarGain(std::exp(x), dt * Phi1(x) / Ka, 1 / (qv * qv),
+                        1 / (maxEffort * maxEffort), dt, latency);
+  return {K, 0};
+}
+
+/**
+ * Calculates the feedback gains in volts for the loop type, period, and
+ * latency of the given preset.
+ */
+FBGains SolveGains(const FFGains& ff, const GainPreset& preset,
+                   const LQRParameters& params) {
+  double Kv = ff.Kv.to<double>();
+  double Ka = ff.Ka.to<double>();
+  double dt = preset.dt.to<double>();
+  double latency = preset.latency.to<double>();
+
+  if (preset.velocity) {
+    return VelocityGains(Kv, Ka, params.qv.to<double>(),
+                         params.maxEffort.to<double>(), dt, latency);
+  } else {
+    return PositionGains(Kv, Ka, params.qp.to<double>(), params.qv.to<double>(),
+                         params.maxEffort.to<double>(), dt, latency);
+  }
+}
+}  // namespace
+
+const ControllerPreset frcchar::kControllerPresets[kNumControllerPresets] = {
+    {"Spark", 20_ms, 1 / 1_V, true},
+    {"Victor", 20_ms, 1 / 1_V, true},
+    {"VictorSP", 20_ms, 1 / 1_V, true},
+    {"PWMTalonSRX", 20_ms, 1 / 1_V, true},
+    {"WPI_TalonSRX", 1_ms, 1023 / 12_V, false},
+    {"WPI_VictorSPX", 1_ms, 1023 / 12_V, false},
+    {"WPI_TalonFX", 1_ms, 1023 / 12_V, false},
+    {"CANSparkMax", 1_ms, 1 / 12_V, false}};
+
+FBGains frcchar::CalculateFeedbackGains(const FFGains& ff,
+                                        const GainPreset& preset,
+                                        const LQRParameters& params) {
+  return ScaleFeedbackGains(SolveGains(ff, preset, params), preset);
+}
+
+FBGains frcchar::ScaleFeedbackGains(const FBGains& gains,
+                                    const GainPreset& preset) {
+  double output = preset.output.to<double>();
+  double Kd = gains.Kd * output;
+  if (!preset.normalized) Kd /= preset.dt.to<double>();
+  return {gains.Kp * output, Kd};
+}
+
+PresetGains frcchar::CalculatePresetGains(const FFGains& ff,
+                                          const GainPreset& preset,
+                                          const LQRParameters& params) {
+  // The solutions in volts, of which only the first one of each period is
+  // calculated.
+  PresetGains solved;
+  PresetGains gains;
+  for (size_t i = 0; i < kNumControllerPresets; ++i) {
+    const auto& controller = kControllerPresets[i];
+    GainPreset scaled{preset.velocity, controller.dt, preset.latency,
+                      controller.output, controller.normalized};
+
+    size_t same = 0;
+    while (kControllerPresets[same].dt != controller.dt) ++same;
+    if (same == i) solved[i] = SolveGains(ff, scaled, params);
+    gains[i] = ScaleFeedbackGains(solved[same], scaled);
+  }
+  return gains;
+}
@@ -0,0 +1,90 @@
+// MIT License
+
+#include "backend/FileWatcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <array>
+#else
+#if defined(__GNUG__) && !defined(__clang__) && __GNUC__ < 8
+#include <experimental/filesystem>
+
+namespace fs = std::experimental::filesystem;
+#else
+#include <filesystem>
+namespace fs = std::filesystem;
+#endif
+
+#include <system_error>
+#endif
+
+using namespace frcchar;
+
+FileWatcher::FileWatcher(const std::string& path) : m_path(path) {
+#ifdef __linux__
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+  AddWatch();
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+  if (m_fd >= 0) close(m_fd);
+#endif
+}
+
+void FileWatcher::AddWatch() {
+#ifdef __linux__
+  if (m_fd < 0) return;
+  m_wd = inotify_add_watch(m_fd, m_path.c_str(),
+                           IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF |
+                               IN_DELETE_SELF | IN_ATTRIB);
+#else
+  std::error_code ec;
+  auto time = fs::last_write_time(m_path, ec);
+  if (!ec) m_lastWriteTime = time.time_since_epoch().count();
+#endif
+}
+
+bool FileWatcher::Poll() {
+#ifdef __linux__
+  if (m_fd < 0) return false;
+
+  bool modified = false;
+  bool replaced = false;
+
+  // Drain all of the pending events. Many writes can happen between two
+  // frames, but they only need to result in a single refresh.
+  alignas(inotify_event) std::array<char, 4096> buffer;
+  ssize_t len;
+  while ((len = read(m_fd, buffer.data(), buffer.size())) > 0) {
+    for (char* ptr = buffer.data(); ptr < buffer.data() + len;) {
+      auto event = reinterpret_cast<const inotify_event*>(ptr);
+      if (event->mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB))
+        modified = true;
+      if (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED))
+        replaced = true;
+      ptr += sizeof(inotify_event) + event->len;
+    }
+  }
+
+  // The file was swapped out from under us (e.g. written to a temporary file
+  // and renamed). Watch the new file at the same path.
+  if (replaced) {
+    if (m_wd >= 0) inotify_rm_watch(m_fd, m_wd);
+    AddWatch();
+    modified = m_wd >= 0;
+  }
+
+  // Keep trying to watch the path if it did not exist the last time.
+  if (m_wd < 0) AddWatch();
+
+  return modified;
+#else
+  int64_t previous = m_lastWriteTime;
+  AddWatch();
+  return m_lastWriteTime != previous;
+#endif
+}
@@ -0,0 +1,91 @@
+// MIT License
+
+#include "backend/FitDiagnostics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "backend/Parallel.h"
+
+using namespace frcchar;
+
+namespace {
+// The number of samples between checks of the cancellation flag.
+constexpr size_t kCancelInterval = 4096;
+}  // namespace
+
+FitDiagnostics frcchar::CalculateFitDiagnostics(
+    const wpi::SmallVectorImpl<TestData>& tests,
+    const FFGains& gains, const std::atomic<bool>& cancel, size_t bins,
+    size_t maxScatter) {
+  double Ks = gains.Ks.to<double>();
+  double Kv = gains.Kv.to<double>();
+  double Ka = gains.Ka.to<double>();
+
+  // Calculate the residuals of each test, along with the measured and
+  // predicted voltage over time.
+  FitDiagnostics result;
+  result.tests.resize(tests.size());
+  std::vector<std::vector<double>> residuals(tests.size());
+  ParallelFor(tests.size(), [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      const PreparedData& data = *tests[t].data;
+      size_t size = data.Size();
+      std::vector<double> time(size), measured(size), predicted(size);
+      residuals[t].resize(size);
+
+      for (size_t i = 0; i < size; ++i) {
+        if (i % kCancelInterval == 0 && cancel) return;
+        time[i] = data.Time(i);
+        measured[i] = data.Voltage(i);
+        predicted[i] = Ks * data.Intercept(i) + Kv * data.Velocity(i) +
+                       Ka * data.Acceleration(i);
+        residuals[t][i] = measured[i] - predicted[i];
+      }
+
+      result.tests[t].name = tests[t].name;
+      result.tests[t].measured = MinMaxPyramid(time, std::move(measured));
+      result.tests[t].predicted =
+          MinMaxPyramid(std::move(time), std::move(predicted));
+    }
+  });
+
+  size_t total = 0;
+  double squares = 0.0;
+  for (auto&& test : residuals) {
+    total += test.size();
+    for (double residual : test) squares += residual * residual;
+  }
+  if (cancel || total == 0 || bins == 0) return result;
+  result.rms = std::sqrt(squares / total);
+
+  // Center the histogram on zero and make it wide enough for nearly all of
+  // the residuals of a normal distribution.
+  double range = result.rms > 0 ? 4 * result.rms : 1.0;
+  result.histogram.assign(bins, 0.0);
+  result.histogramMin = -range;
+  result.binWidth = 2 * range / bins;
+
+  // Keep evenly spaced samples for the scatter plots, so that they stay
+  // interactive no matter how much data there is.
+  size_t stride = std::max<size_t>(1, (total + maxScatter - 1) / maxScatter);
+  size_t index = 0;
+  for (size_t t = 0; t < tests.size(); ++t) {
+    const PreparedData& data = *tests[t].data;
+    for (size_t i = 0; i < data.Size(); ++i, ++index) {
+      if (index % kCancelInterval == 0 && cancel) return result;
+
+      double residual = residuals[t][i];
+      auto bin = static_cast<long>(
+          std::floor((residual - result.histogramMin) / result.binWidth));
+      ++result.histogram[std::clamp<long>(bin, 0, bins - 1)];
+
+      if (index % stride == 0) {
+        result.velocity.push_back(data.Velocity(i));
+        result.acceleration.push_back(data.Acceleration(i));
+        result.residual.push_back(residual);
+      }
+    }
+  }
+  return result;
+}
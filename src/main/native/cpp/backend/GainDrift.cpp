@@ -0,0 +1,125 @@
+// MIT License
+
+#include "backend/GainDrift.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "backend/Parallel.h"
+
+using namespace frcchar;
+
+namespace {
+// The smallest determinant of the velocity terms of a window, relative to the
+// product of their variances, that Ks and Kv are fit for. Below it, the
+// velocity is too nearly constant to separate them.
+constexpr double kMinDeterminant = 1E-9;
+
+/**
+ * Calculates the range [begin, end) of samples of each window.
+ */
+void FindWindows(const PreparedData& data, double window, size_t windows,
+                 std::vector<double>* centers, std::vector<size_t>* begins,
+                 std::vector<size_t>* ends) {
+  size_t size = data.Size();
+  double start = data.Time(0);
+  double end = data.Time(size - 1);
+
+  // A test that is shorter than the window is a single window.
+  double span = end - start - window;
+  if (span <= 0 || windows < 2) {
+    centers->push_back((start + end) / 2);
+    begins->push_back(0);
+    ends->push_back(size);
+    return;
+  }
+
+  // The first window starts at the start of the test and the last one ends at
+  // its end. Both bounds only move forward, so finding them is a single pass.
+  size_t begin = 0;
+  size_t stop = 0;
+  for (size_t k = 0; k < windows; ++k) {
+    double center = start + window / 2 + span * k / (windows - 1);
+    while (begin < size && data.Time(begin) < center - window / 2) ++begin;
+    while (stop < size && data.Time(stop) <= center + window / 2) ++stop;
+    centers->push_back(center);
+    begins->push_back(begin);
+    ends->push_back(stop);
+  }
+}
+}  // namespace
+
+GainDrift frcchar::CalculateGainDrift(const Dataset& data, int dataset,
+                                      const FFGains& gains, double window,
+                                      size_t windows) {
+  double Ks = gains.Ks.to<double>();
+  double Kv = gains.Kv.to<double>();
+  double Ka = gains.Ka.to<double>();
+  double nan = std::nan("");
+
+  auto segments = data.GetSegments(dataset);
+  auto names = data.GetData(dataset);
+  GainDrift result;
+  result.tests.resize(segments.size());
+
+  ParallelFor(segments.size(), [&](size_t first, size_t last) {
+    for (size_t t = first; t < last; ++t) {
+      const auto& segment = *segments[t];
+      const PreparedData& samples = segment.data;
+      auto& test = result.tests[t];
+      test.name = names[t].name;
+      if (samples.Size() == 0) continue;
+
+      std::vector<size_t> begins, ends;
+      FindWindows(samples, window, windows, &test.time, &begins, &ends);
+
+      // Record the sums of all samples before the bounds of each window, in
+      // one pass over the samples.
+      size_t count = test.time.size();
+      std::vector<OLSSums> beginSums(count), endSums(count);
+      OLSSums cumulative;
+      size_t nextBegin = 0;
+      size_t nextEnd = 0;
+      for (size_t i = 0; i <= samples.Size(); ++i) {
+        while (nextBegin < count && begins[nextBegin] == i)
+          beginSums[nextBegin++] = cumulative;
+        while (nextEnd < count && ends[nextEnd] == i)
+          endSums[nextEnd++] = cumulative;
+        if (i == samples.Size()) break;
+
+        double sample[] = {samples.Voltage(i), samples.Intercept(i),
+                           samples.Velocity(i), samples.Acceleration(i)};
+        cumulative.Add(sample);
+      }
+
+      for (size_t k = 0; k < count; ++k) {
+        OLSSums sums = endSums[k];
+        sums -= beginSums[k];
+        const auto& XtX = sums.XtX;
+        const auto& Xty = sums.Xty;
+
+        if (segment.quasistatic) {
+          // Regress the voltage that is not explained by Ka on the intercept
+          // and the velocity.
+          double b0 = Xty(0) - Ka * XtX(0, 2);
+          double b1 = Xty(1) - Ka * XtX(1, 2);
+          double det = XtX(0, 0) * XtX(1, 1) - XtX(0, 1) * XtX(0, 1);
+          bool fit = sums.n >= 3 &&
+                     det > kMinDeterminant * XtX(0, 0) * XtX(1, 1);
+          test.Ks.push_back(fit ? (b0 * XtX(1, 1) - b1 * XtX(0, 1)) / det
+                                : nan);
+          test.Kv.push_back(fit ? (b1 * XtX(0, 0) - b0 * XtX(0, 1)) / det
+                                : nan);
+        } else {
+          // Regress the voltage that is not explained by Ks and Kv on the
+          // acceleration.
+          bool fit = sums.n >= 2 && XtX(2, 2) > 0;
+          test.Ka.push_back(
+              fit ? (Xty(2) - Ks * XtX(2, 0) - Kv * XtX(2, 1)) / XtX(2, 2)
+                  : nan);
+        }
+      }
+    }
+  });
+  return result;
+}
@@ -0,0 +1,99 @@
+// MIT License
+
+#include "backend/KinematicSmoother.h"
+
+#include <algorithm>
+
+#include <Eigen/Core>
+#include <Eigen/LU>
+#include <wpi/math>
+
+using namespace frcchar;
+
+namespace {
+// The initial variance of the state, which is large enough that the first
+// measurements decide the initial velocity and acceleration.
+constexpr double kInitialVariance = 1E9;
+
+/**
+ * Returns the median time between consecutive samples, or zero if there are
+ * fewer than two.
+ */
+double MedianPeriod(const double* time, size_t size, MonotonicArena* arena) {
+  if (size < 2) return 0.0;
+  ArenaVector<double> periods(size - 1, ArenaAllocator<double>(arena));
+  for (size_t i = 1; i < size; ++i) periods[i - 1] = time[i] - time[i - 1];
+  auto median = periods.begin() + periods.size() / 2;
+  std::nth_element(periods.begin(), median, periods.end());
+  return *median;
+}
+
+/**
+ * Returns the state transition matrix of the constant-acceleration model.
+ */
+Eigen::Matrix2d Transition(double dt) {
+  Eigen::Matrix2d F;
+  F << 1, dt, 0, 1;
+  return F;
+}
+}  // namespace
+
+void frcchar::SmoothKinematics(const double* time, const double* velocity,
+                               size_t size, double bandwidth,
+                               double* smoothedVelocity,
+                               double* acceleration, MonotonicArena* arena) {
+  if (size == 0) return;
+
+  // The measurement noise of each sample is normalized to one, which is a
+  // noise spectral density of one sample period, so the jerk spectral density
+  // is the fourth power of the bandwidth times the period (see the header).
+  double omega = 2 * wpi::math::pi * bandwidth;
+  double q = omega * omega * omega * omega *
+             MedianPeriod(time, size, arena);
+
+  // The filtered state and covariance of each sample, along with the
+  // covariance predicted from the previous sample.
+  ArenaVector<Eigen::Vector2d> filtered(
+      size, ArenaAllocator<Eigen::Vector2d>(arena));
+  ArenaVector<Eigen::Matrix2d> covariance(
+      size, ArenaAllocator<Eigen::Matrix2d>(arena));
+  ArenaVector<Eigen::Matrix2d> predicted(
+      size, ArenaAllocator<Eigen::Matrix2d>(arena));
+
+  Eigen::Vector2d x(velocity[0], 0.0);
+  Eigen::Matrix2d P = Eigen::Matrix2d::Identity() * kInitialVariance;
+  for (size_t i = 0; i < size; ++i) {
+    if (i > 0) {
+      double dt = time[i] - time[i - 1];
+      Eigen::Matrix2d F = Transition(dt);
+      Eigen::Matrix2d Q;
+      Q << dt * dt * dt / 3, dt * dt / 2, dt * dt / 2, dt;
+      x = F * x;
+      P = F * P * F.transpose() + q * Q;
+    }
+    predicted[i] = P;
+
+    // Only the velocity is measured, so the Kalman gain is the first column
+    // of the covariance divided by the innovation variance.
+    Eigen::Vector2d K = P.col(0) / (P(0, 0) + 1.0);
+    x += K * (velocity[i] - x(0));
+    P -= K * P.row(0);
+    P = 0.5 * (P + P.transpose());
+
+    filtered[i] = x;
+    covariance[i] = P;
+  }
+
+  // Smooth the states from the last sample back to the first.
+  Eigen::Vector2d smoothed = filtered[size - 1];
+  smoothedVelocity[size - 1] = smoothed(0);
+  acceleration[size - 1] = smoothed(1);
+  for (size_t i = size - 1; i-- > 0;) {
+    Eigen::Matrix2d F = Transition(time[i + 1] - time[i]);
+    Eigen::Matrix2d G =
+        covariance[i] * F.transpose() * predicted[i + 1].inverse();
+    smoothed = filtered[i] + G * (smoothed - F * filtered[i]);
+    smoothedVelocity[i] = smoothed(0);
+    acceleration[i] = smoothed(1);
+  }
+}
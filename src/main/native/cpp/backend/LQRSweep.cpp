@@ -0,0 +1,98 @@
+// MIT License
+
+#include "backend/LQRSweep.h"
+
+#include <stdexcept>
+#include <system_error>
+
+#include <wpi/Format.h>
+#include <wpi/raw_ostream.h>
+
+#include "backend/FeedbackGains.h"
+#include "backend/Parallel.h"
+
+using namespace frcchar;
+
+namespace {
+/**
+ * Sets the value of a swept parameter inside the preset or LQR parameters.
+ */
+void SetParameter(int parameter, double value, GainPreset* preset,
+                  LQRParameters* params) {
+  switch (parameter) {
+    case SweepAxis::kQp:
+      params->qp = units::meter_t(value);
+      break;
+    case SweepAxis::kQv:
+      params->qv = units::meters_per_second_t(value);
+      break;
+    case SweepAxis::kMaxEffort:
+      params->maxEffort = units::volt_t(value);
+      break;
+    case SweepAxis::kDt:
+      preset->dt = units::second_t(value);
+      break;
+    case SweepAxis::kLatency:
+      preset->latency = units::second_t(value);
+      break;
+  }
+}
+}  // namespace
+
+SweepResult frcchar::SweepFeedbackGains(const FFGains& ff,
+                                        const GainPreset& preset,
+                                        const LQRParameters& params,
+                                        const SweepAxis& x,
+                                        const SweepAxis& y) {
+  SweepResult result{x, y, {}, {}};
+  result.Kp.resize(static_cast<size_t>(x.steps) * y.steps);
+  result.Kd.resize(result.Kp.size());
+
+  // Each worker solves a contiguous batch of rows. The solves use fixed-size
+  // matrices, so the workers never allocate or share anything but the output.
+  ParallelFor(y.steps, [&](size_t begin, size_t end) {
+    auto rowPreset = preset;
+    auto rowParams = params;
+    for (size_t row = begin; row < end; ++row) {
+      SetParameter(y.parameter, y.Value(row), &rowPreset, &rowParams);
+      for (int col = 0; col < x.steps; ++col) {
+        SetParameter(x.parameter, x.Value(col), &rowPreset, &rowParams);
+        auto gains = CalculateFeedbackGains(ff, rowPreset, rowParams);
+
+        size_t idx = row * x.steps + col;
+        result.Kp[idx] = gains.Kp;
+        result.Kd[idx] = gains.Kd;
+      }
+    }
+  });
+
+  return result;
+}
+
+void frcchar::ExportSweep(const SweepResult& result, const std::string& path) {
+  std::error_code ec;
+  wpi::raw_fd_ostream csv(path, ec);
+  if (ec) {
+    throw std::runtime_error("Could not write " + path + ": " +
+                             ec.message());
+  }
+
+  csv << SweepAxis::kParameters[result.x.parameter] << ","
+      << SweepAxis::kParameters[result.y.parameter] << ",Kp,Kd\n";
+  for (int row = 0; row < result.y.steps; ++row) {
+    for (int col = 0; col < result.x.steps; ++col) {
+      size_t idx = static_cast<size_t>(row) * result.x.steps + col;
+      csv << wpi::format("%.9g,%.9g,%.9g,%.9g\n", result.x.Value(col),
+                         result.y.Value(row), result.Kp[idx], result.Kd[idx]);
+    }
+  }
+
+  // The error has to be cleared before the stream is destroyed, which would
+  // otherwise report it as a fatal error.
+  csv.close();
+  if (csv.has_error()) {
+    std::string message = csv.error().message();
+    csv.clear_error();
+    throw std::runtime_error("Could not write " + path + ": " + message);
+  }
+}
@@ -0,0 +1,98 @@
+// MIT License
+
+#include "backend/LatencyProbe.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <networktables/NetworkTableValue.h>
+
+using namespace frcchar;
+
+void RunningStats::Add(double value) {
+  ++count;
+  double delta = value - mean;
+  mean += delta / count;
+  m2 += delta * (value - mean);
+  min = std::min(min, value);
+  max = std::max(max, value);
+}
+
+double RunningStats::StdDev() const {
+  return count > 1 ? std::sqrt(m2 / (count - 1)) : 0.0;
+}
+
+LatencyProbe::LatencyProbe(NT_Inst inst)
+    : m_inst(inst),
+      m_pingEntry(nt::GetEntry(inst, kPingEntry)),
+      m_poller(nt::CreateEntryListenerPoller(inst)) {
+  nt::AddPolledEntryListener(m_poller, kPongEntry,
+                             NT_NOTIFY_NEW | NT_NOTIFY_UPDATE);
+}
+
+LatencyProbe::~LatencyProbe() { nt::DestroyEntryListenerPoller(m_poller); }
+
+void LatencyProbe::Poll() {
+  bool timedOut;
+  for (auto&& event : nt::PollEntryListener(m_poller, 0, &timedOut)) {
+    // Ignore other entries that share the prefix and malformed values.
+    if (event.name != kPongEntry || !event.value ||
+        !event.value->IsDoubleArray())
+      continue;
+
+    auto pong = event.value->GetDoubleArray();
+    if (pong.size() != 5) continue;
+
+    // Answers to pings that were never sent (e.g. by an earlier session of
+    // the Logger) or that were already processed are ignored.
+    double sequence = pong[0];
+    if (sequence <= m_lastAnswered || sequence > m_sequence) continue;
+    m_lastAnswered = sequence;
+
+    // The value is stamped with the host time at which it was received.
+    double hostSend = pong[1];
+    double robotReceive = pong[2];
+    double robotSend = pong[3];
+    double hostReceive = ToSeconds(event.value->last_change());
+
+    Exchange exchange;
+    exchange.roundTrip =
+        (hostReceive - hostSend) - (robotSend - robotReceive);
+    exchange.offset =
+        ((robotReceive - hostSend) + (robotSend - hostReceive)) / 2;
+    if (exchange.roundTrip < 0) continue;
+
+    m_exchanges[m_roundTrip.count % kOffsetWindow] = exchange;
+    m_roundTrip.Add(exchange.roundTrip);
+    m_sensorDelay.Add(pong[4]);
+  }
+
+  double now = GetHostTime();
+  if (now - m_lastPing >= kPingPeriod) {
+    m_lastPing = now;
+    ++m_sent;
+    std::array<double, 2> ping{static_cast<double>(++m_sequence), now};
+    nt::SetEntryValue(m_pingEntry, nt::Value::MakeDoubleArray(ping));
+    nt::Flush(m_inst);
+  }
+}
+
+void LatencyProbe::Reset() {
+  // The sequence keeps counting up so that answers to the pings that are
+  // still in flight are not mistaken for answers to new ones.
+  m_lastAnswered = m_sequence;
+  m_sent = 0;
+  m_lastPing = -std::numeric_limits<double>::infinity();
+  m_roundTrip = RunningStats{};
+  m_sensorDelay = RunningStats{};
+}
+
+std::optional<double> LatencyProbe::GetClockOffset() const {
+  if (m_roundTrip.count == 0) return std::nullopt;
+  auto end = m_exchanges.begin() + std::min(m_roundTrip.count, kOffsetWindow);
+  return std::min_element(m_exchanges.begin(), end,
+                          [](const auto& a, const auto& b) {
+                            return a.roundTrip < b.roundTrip;
+                          })
+      ->offset;
+}
@@ -0,0 +1,29 @@
+// MIT License
+
+#include "backend/MemoryUsage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+size_t frcchar::GetPeakMemoryUsage() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return 0;
+  return counters.PeakWorkingSetSize;
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  // macOS reports the maximum resident set size in bytes.
+  return usage.ru_maxrss;
+#else
+  // Linux reports the maximum resident set size in kilobytes.
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
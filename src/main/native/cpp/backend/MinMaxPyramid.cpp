@@ -0,0 +1,75 @@
+// MIT License
+
+#include "backend/MinMaxPyramid.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace frcchar;
+
+MinMaxPyramid::MinMaxPyramid(std::vector<double> x, std::vector<double> y) {
+  m_levels.push_back({std::move(x), std::move(y)});
+
+  // Each level reduces every group of four points of the level below it to
+  // their minimum and maximum. The first level has one point per sample and
+  // the others have two points per bin, so each level has bins that are
+  // twice as large and half as many points.
+  while (m_levels.back().x.size() > 2) {
+    const Level& below = m_levels.back();
+    size_t size = below.x.size();
+
+    Level level;
+    level.x.reserve(size / 2 + 2);
+    level.y.reserve(size / 2 + 2);
+    for (size_t i = 0; i < size; i += 4) {
+      size_t end = std::min(i + 4, size);
+      auto begin = below.y.begin() + i;
+      auto [min, max] = std::minmax_element(begin, below.y.begin() + end);
+
+      // Keep the points in the order in which they occur.
+      if (max < min) std::swap(min, max);
+      for (auto it : {min, max}) {
+        size_t index = it - below.y.begin();
+        level.x.push_back(below.x[index]);
+        level.y.push_back(below.y[index]);
+      }
+    }
+    m_levels.push_back(std::move(level));
+  }
+}
+
+void MinMaxPyramid::Query(double xMin, double xMax, size_t maxPoints,
+                          std::vector<double>* xs,
+                          std::vector<double>* ys) const {
+  xs->clear();
+  ys->clear();
+  if (m_levels.empty()) return;
+
+  // Find the visible samples, along with the one on each side of them.
+  const auto& samples = m_levels.front().x;
+  size_t begin = std::lower_bound(samples.begin(), samples.end(), xMin) -
+                 samples.begin();
+  size_t end = std::upper_bound(samples.begin(), samples.end(), xMax) -
+               samples.begin();
+  begin = begin > 0 ? begin - 1 : 0;
+  end = std::min(end + 1, samples.size());
+  if (begin >= end) return;
+
+  // Use the finest level that does not have too many points. Level L has
+  // bins of 2^(L + 1) samples with two points each.
+  size_t visible = end - begin;
+  size_t level = 0;
+  while (level + 1 < m_levels.size() &&
+         (visible >> level) > std::max<size_t>(maxPoints, 2))
+    ++level;
+
+  const Level& points = m_levels[level];
+  size_t first = begin, last = end;
+  if (level > 0) {
+    first = 2 * (begin >> (level + 1));
+    last = std::min(2 * (((end - 1) >> (level + 1)) + 1), points.x.size());
+  }
+
+  xs->assign(points.x.begin() + first, points.x.begin() + last);
+  ys->assign(points.y.begin() + first, points.y.begin() + last);
+}
@@ -2,11 +2,194 @@
 
 #include "backend/OLS.h"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
 #include <Eigen/Cholesky>
 #include <Eigen/Core>
+#include <wpi/SmallVector.h>
+
+#include "backend/Parallel.h"
+
+using namespace frcchar;
+
+namespace {
+// The number of samples in each chunk. Four doubles per sample makes each
+// chunk 128 KiB, which fits in the L2 cache of most processors.
+constexpr size_t kChunkSize = 4096;
+
+// The number of chunk sums that are kept on the stack.
+constexpr size_t kMaxInlineChunks = 32;
+
+/**
+ * Accumulates a sum with Neumaier's variant of Kahan summation, which keeps
+ * track of the low-order bits that are lost with each addition.
+ */
+class CompensatedSum {
+ public:
+  void Add(double value) {
+    double t = m_sum + value;
+    if (std::abs(m_sum) >= std::abs(value))
+      m_compensation += (m_sum - t) + value;
+    else
+      m_compensation += (value - t) + m_sum;
+    m_sum = t;
+  }
+
+  double Value() const { return m_sum + m_compensation; }
+
+ private:
+  double m_sum = 0.0;
+  double m_compensation = 0.0;
+};
+
+/**
+ * Calculates the sums of a single chunk of samples with compensated
+ * summation. The sample function is called with the index of a sample and
+ * stores its dependent and independent variables in the given arguments.
+ */
+template <typename F>
+OLSSums SumChunk(size_t begin, size_t end, F&& sample) {
+  // X'X is symmetric, so only its upper triangle needs to be accumulated.
+  std::array<CompensatedSum, 6> XtX;
+  std::array<CompensatedSum, 3> Xty;
+  CompensatedSum yty;
+  CompensatedSum ySum;
+
+  for (size_t i = begin; i < end; ++i) {
+    double y;
+    std::array<double, 3> x;
+    sample(i, &y, &x);
+
+    XtX[0].Add(x[0] * x[0]);
+    XtX[1].Add(x[0] * x[1]);
+    XtX[2].Add(x[0] * x[2]);
+    XtX[3].Add(x[1] * x[1]);
+    XtX[4].Add(x[1] * x[2]);
+    XtX[5].Add(x[2] * x[2]);
+    for (int j = 0; j < 3; ++j) Xty[j].Add(x[j] * y);
+    yty.Add(y * y);
+    ySum.Add(y);
+  }
+
+  OLSSums sums;
+  sums.XtX << XtX[0].Value(), XtX[1].Value(), XtX[2].Value(),  //
+      XtX[1].Value(), XtX[3].Value(), XtX[4].Value(),           //
+      XtX[2].Value(), XtX[4].Value(), XtX[5].Value();
+  sums.Xty << Xty[0].Value(), Xty[1].Value(), Xty[2].Value();
+  sums.yty = yty.Value();
+  sums.ySum = ySum.Value();
+  sums.n = end - begin;
+  return sums;
+}
+
+/**
+ * Splits the samples into fixed-size chunks that are summed on all cores, and
+ * combines the sums of the chunks pairwise. The order of the additions only
+ * depends on the number of chunks, which keeps the result reproducible.
+ */
+template <typename F>
+OLSSums SumChunked(size_t samples, size_t threads, F&& sample) {
+  size_t chunks = (samples + kChunkSize - 1) / kChunkSize;
+  if (chunks == 0) return {};
+  if (chunks == 1) return SumChunk(0, samples, sample);
+
+  // Batches of up to kMaxInlineChunks * kChunkSize samples are summed without
+  // allocating.
+  wpi::SmallVector<OLSSums, kMaxInlineChunks> chunkSums(chunks);
+  ParallelFor(
+      chunks,
+      [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          chunkSums[i] = SumChunk(i * kChunkSize,
+                                  std::min((i + 1) * kChunkSize, samples),
+                                  sample);
+        }
+      },
+      threads);
+
+  for (size_t step = 1; step < chunks; step *= 2) {
+    for (size_t i = 0; i + step < chunks; i += 2 * step)
+      chunkSums[i] += chunkSums[i + step];
+  }
+  return chunkSums[0];
+}
+}  // namespace
+
+void OLSSums::Add(const double* sample) {
+  Eigen::Map<const Eigen::Vector3d> x(sample + 1);
+  double y = sample[0];
+
+  XtX.noalias() += x * x.transpose();
+  Xty += x * y;
+  yty += y * y;
+  ySum += y;
+  ++n;
+}
+
+void OLSSums::Add(const std::vector<double>& data) {
+  Add(data.data(), data.size() / 4);
+}
+
+void OLSSums::Add(const double* data, size_t samples, size_t threads) {
+  *this += SumChunked(samples, threads,
+                      [data](size_t i, double* y, std::array<double, 3>* x) {
+                        const double* sample = data + i * 4;
+                        *y = sample[0];
+                        *x = {sample[1], sample[2], sample[3]};
+                      });
+}
+
+template <typename T>
+void OLSSums::Add(const T* y, const T* x1, const T* x2, size_t samples,
+                  size_t threads) {
+  *this += SumChunked(samples, threads,
+                      [=](size_t i, double* yi, std::array<double, 3>* x) {
+                        *yi = y[i];
+                        *x = {std::copysign(1.0, x1[i]),
+                              static_cast<double>(x1[i]),
+                              static_cast<double>(x2[i])};
+                      });
+}
+
+template void OLSSums::Add<float>(const float*, const float*, const float*,
+                                  size_t, size_t);
+template void OLSSums::Add<double>(const double*, const double*,
+                                   const double*, size_t, size_t);
+
+OLSSums& OLSSums::operator+=(const OLSSums& other) {
+  XtX += other.XtX;
+  Xty += other.Xty;
+  yty += other.yty;
+  ySum += other.ySum;
+  n += other.n;
+  return *this;
+}
+
+OLSSums& OLSSums::operator-=(const OLSSums& other) {
+  XtX -= other.XtX;
+  Xty -= other.Xty;
+  yty -= other.yty;
+  ySum -= other.ySum;
+  n -= other.n;
+  return *this;
+}
 
 std::vector<double> frcchar::OLS(const std::vector<double>& data,
                                  size_t variables) {
+  // The sums only support the three independent variables of the
+  // feedforward model.
+  assert(variables == 3);
+
+  OLSSums sums;
+  sums.Add(data);
+  auto result = OLS(sums);
+  return std::vector<double>(result.begin(), result.end());
+}
+
+std::array<double, 4> frcchar::OLS(const OLSSums& sums) {
   // The linear model can be written as follows:
   // y = Xβ + u, where y is the dependent observed variable, X is the matrix
   // of independent variables, β is a vector of coefficients, and u is a
@@ -14,36 +197,25 @@ std::vector<double> frcchar::OLS(const std::vector<double>& data,
 
   // We want to minimize u^2 = u'u = (y - Xβ)'(y - Xβ).
   // β = (X'X)^-1 (X'y)
-
-  // Get the number of elements.
-  int n = data.size() / (variables + 1);
-
-  // Create y and X matrices.
-  Eigen::Map<const Eigen::MatrixXd, 0, Eigen::Stride<1, Eigen::Dynamic>> y(
-      data.data(), n, 1, Eigen::Stride<1, Eigen::Dynamic>(1, variables + 1));
-  Eigen::Map<const Eigen::MatrixXd, 0, Eigen::Stride<1, Eigen::Dynamic>> X(
-      data.data() + 1, n, 3,
-      Eigen::Stride<1, Eigen::Dynamic>(1, variables + 1));
+  double n = static_cast<double>(sums.n);
 
   // Calculate b = β that minimizes u'u.
-  Eigen::MatrixXd b = (X.transpose() * X).llt().solve(X.transpose() * y);
+  Eigen::Vector3d b = sums.XtX.llt().solve(sums.Xty);
 
   // We will now calculate r^2 or the coefficient of determination, which
   // tells us how much of the total variation (variation in y) can be
   // explained by the regression model.
 
   // We will first calculate the sum of the squares of the error, or the
-  // variation in error (SSE).
-  double SSE = (y - X * b).squaredNorm();
+  // variation in error (SSE). Expanding (y - Xb)'(y - Xb) and using
+  // X'Xb = X'y gives y'y - b'X'y.
+  double SSE = sums.yty - b.dot(sums.Xty);
 
   // Now we will calculate the total variation in y, known as SSTO.
-  double SSTO = ((y.transpose() * y) - (1 / n) * (y.transpose() * y)).value();
+  double SSTO = sums.yty - sums.ySum * sums.ySum / n;
 
   double rSquared = (SSTO - SSE) / SSTO;
   double adjRSquared = 1 - (1 - rSquared) * ((n - 1.0) / (n - 3));
 
-  std::vector<double> vec(b.data(), b.data() + b.rows());
-  vec.push_back(adjRSquared);
-
-  return vec;
+  return {b(0), b(1), b(2), adjRSquared};
 }
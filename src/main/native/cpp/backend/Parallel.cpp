@@ -0,0 +1,134 @@
+// MIT License
+
+#include "backend/Parallel.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+using namespace frcchar;
+
+namespace {
+/**
+ * A call of RunBatches(). It lives on the stack of the calling thread, and is
+ * linked into the pool's list of jobs while it has batches that no thread
+ * has started yet.
+ */
+struct Job {
+  void (*run)(void* context, size_t batch);
+  void* context;
+  size_t batches;
+
+  // The next batch to start and the number of finished batches. These are
+  // only used while the pool's mutex is held.
+  size_t next = 0;
+  size_t finished = 0;
+  std::exception_ptr exception;
+
+  Job* nextJob = nullptr;
+  std::condition_variable done;
+};
+
+/**
+ * The threads that run the batches of every job. Jobs are served in the
+ * order in which they were started, so nested jobs are helped by idle
+ * threads as well as run by the thread that started them.
+ */
+class WorkerPool {
+ public:
+  static WorkerPool& GetInstance() {
+    static WorkerPool pool;
+    return pool;
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_work.notify_all();
+    for (auto&& worker : m_workers) worker.join();
+  }
+
+  /**
+   * Runs all batches of the job and waits until they are done.
+   */
+  void Run(Job* job) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_tail)
+      m_tail->nextJob = job;
+    else
+      m_head = job;
+    m_tail = job;
+    m_work.notify_all();
+
+    // Run the batches that no worker has taken yet, then wait for the rest.
+    while (job->next < job->batches) RunBatch(job, &lock);
+    job->done.wait(lock, [job] { return job->finished == job->batches; });
+    if (job->exception) std::rethrow_exception(job->exception);
+  }
+
+ private:
+  WorkerPool() {
+    unsigned int threads = std::thread::hardware_concurrency();
+    for (unsigned int i = 1; i < threads; ++i)
+      m_workers.emplace_back([this] { Work(); });
+  }
+
+  /**
+   * Takes the next batch of a job that has batches left, and runs it without
+   * holding the lock. The job is unlinked once its last batch is taken.
+   */
+  void RunBatch(Job* job, std::unique_lock<std::mutex>* lock) {
+    size_t batch = job->next++;
+    if (job->next == job->batches) Unlink(job);
+
+    lock->unlock();
+    std::exception_ptr exception;
+    try {
+      job->run(job->context, batch);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    lock->lock();
+
+    if (exception && !job->exception) job->exception = exception;
+    if (++job->finished == job->batches) job->done.notify_all();
+  }
+
+  void Unlink(Job* job) {
+    Job* previous = nullptr;
+    for (Job* it = m_head; it != job; it = it->nextJob) previous = it;
+    (previous ? previous->nextJob : m_head) = job->nextJob;
+    if (m_tail == job) m_tail = previous;
+    job->nextJob = nullptr;
+  }
+
+  void Work() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+      m_work.wait(lock, [this] { return m_stopping || m_head; });
+      if (m_stopping) return;
+      RunBatch(m_head, &lock);
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_work;
+  Job* m_head = nullptr;
+  Job* m_tail = nullptr;
+  bool m_stopping = false;
+  std::vector<std::thread> m_workers;
+};
+}  // namespace
+
+void detail::RunBatches(size_t batches,
+                        void (*run)(void* context, size_t batch),
+                        void* context) {
+  Job job;
+  job.run = run;
+  job.context = context;
+  job.batches = batches;
+  WorkerPool::GetInstance().Run(&job);
+}
@@ -0,0 +1,75 @@
+// MIT License
+
+#include "backend/PreparedData.h"
+
+#include <type_traits>
+
+using namespace frcchar;
+
+void PreparedData::Reserve(size_t size) {
+  auto reserve = [size](auto& columns) {
+    columns.voltage.reserve(size);
+    columns.velocity.reserve(size);
+    columns.acceleration.reserve(size);
+  };
+
+  m_time.reserve(size);
+  if (m_compact)
+    reserve(m_float);
+  else
+    reserve(m_double);
+}
+
+void PreparedData::Append(double time, double voltage, double velocity,
+                          double acceleration) {
+  auto append = [&](auto& columns) {
+    columns.voltage.push_back(voltage);
+    columns.velocity.push_back(velocity);
+    columns.acceleration.push_back(acceleration);
+  };
+
+  m_time.push_back(time);
+  if (m_compact)
+    append(m_float);
+  else
+    append(m_double);
+}
+
+void PreparedData::EraseFront(size_t count) {
+  auto erase = [count](auto& columns) {
+    for (auto column :
+         {&columns.voltage, &columns.velocity, &columns.acceleration})
+      column->erase(column->begin(), column->begin() + count);
+  };
+
+  m_time.erase(m_time.begin(), m_time.begin() + count);
+  if (m_compact)
+    erase(m_float);
+  else
+    erase(m_double);
+}
+
+OLSSums PreparedData::Sums(size_t begin, size_t end, size_t threads) const {
+  OLSSums sums;
+  auto add = [&](const auto& columns) {
+    sums.Add(columns.voltage.data() + begin, columns.velocity.data() + begin,
+             columns.acceleration.data() + begin, end - begin, threads);
+  };
+
+  if (m_compact)
+    add(m_float);
+  else
+    add(m_double);
+  return sums;
+}
+
+size_t PreparedData::MemoryUsage() const {
+  auto usage = [](const auto& columns) {
+    using T = typename std::decay_t<decltype(columns.voltage)>::value_type;
+    return (columns.voltage.capacity() + columns.velocity.capacity() +
+            columns.acceleration.capacity()) *
+           sizeof(T);
+  };
+  return m_time.capacity() * sizeof(double) + usage(m_float) +
+         usage(m_double);
+}
@@ -52,7 +52,8 @@ void ProjectCreator::CreateProject() {
   if (ec) wpi::outs() << ec.message() << "\n";
 }
 
-void ProjectCreator::DeployProject(std::string* result) {
+void ProjectCreator::DeployProject(std::string* result,
+                                   const std::function<void()>& onOutput) {
   std::string jdk = std::getenv("HOME");
   jdk += ((jdk.back() == fs::path::preferred_separator ? "" : "/")) +
          std::string("wpilib/2021/jdk");
@@ -74,6 +75,7 @@ void ProjectCreator::DeployProject(std::string* result) {
   while (!feof(pipe)) {
     if (std::fgets(buffer.data(), 128, pipe) != nullptr) {
       *result += buffer.data();
+      if (onOutput) onOutput();
     }
   }
 
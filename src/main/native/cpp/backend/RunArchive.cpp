@@ -0,0 +1,292 @@
+// MIT License
+
+#include "backend/RunArchive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#include "backend/ByteCodec.h"
+
+using namespace frcchar;
+
+namespace {
+// Identifies a file as a run archive, along with the format version. It is
+// at the start of the file and at the end of each footer.
+constexpr char kMagic[8] = {'F', 'R', 'C', 'R', 'U', 'N', 'S', '2'};
+
+// The footer holds the offset and size of its index and the end of the
+// footer of the previous index in the chain (or zero), followed by the magic.
+constexpr size_t kFooterSize = 3 * sizeof(uint64_t) + sizeof(kMagic);
+
+// The size of the blocks in which the end of a file is searched for the last
+// valid footer.
+constexpr uint64_t kScanBlock = 64 << 10;
+
+/**
+ * The contents of a footer.
+ */
+struct Footer {
+  uint64_t indexOffset;
+  uint64_t indexSize;
+  uint64_t previous;
+};
+
+/**
+ * Reads the given range of a file.
+ */
+std::vector<uint8_t> ReadRange(std::ifstream& input, uint64_t offset,
+                               uint64_t size) {
+  std::vector<uint8_t> bytes(size);
+  input.seekg(offset);
+  input.read(reinterpret_cast<char*>(bytes.data()), size);
+  if (!input) throw std::runtime_error("The run archive is corrupt.");
+  return bytes;
+}
+
+/**
+ * Parses the footer that ends at the given offset of the file. Returns false
+ * if it is not a valid footer.
+ */
+bool ParseFooter(const uint8_t* bytes, uint64_t footerEnd, Footer* footer) {
+  ByteReader reader(bytes, bytes + kFooterSize);
+  footer->indexOffset = reader.Fixed<uint64_t>();
+  footer->indexSize = reader.Fixed<uint64_t>();
+  footer->previous = reader.Fixed<uint64_t>();
+  return std::memcmp(reader.Skip(sizeof(kMagic)), kMagic, sizeof(kMagic)) ==
+             0 &&
+         footer->indexOffset >= sizeof(kMagic) &&
+         footer->indexOffset <= footerEnd - kFooterSize &&
+         footer->indexSize == footerEnd - kFooterSize - footer->indexOffset &&
+         (footer->previous == 0 ||
+          (footer->previous >= sizeof(kMagic) + kFooterSize &&
+           footer->previous <= footer->indexOffset));
+}
+
+/**
+ * Returns the number of runs before the first run of the index that is
+ * written when the archive grows to the given number of runs. The indexes
+ * cover the runs like the nodes of a Fenwick tree: the index of run n holds
+ * the runs after n with its lowest set bit cleared, so each run is written
+ * to a logarithmic number of indexes, and a chain of at most log2(n) indexes
+ * covers all runs.
+ */
+size_t IndexStart(size_t runs) { return runs & (runs - 1); }
+}  // namespace
+
+const RunArchive::Segment* RunArchive::Run::Find(wpi::StringRef test) const {
+  for (auto&& segment : segments) {
+    if (segment.test == test) return &segment;
+  }
+  return nullptr;
+}
+
+RunArchive::RunArchive(std::string path) : m_path(std::move(path)) {
+  ReadIndex();
+}
+
+void RunArchive::ReadIndex() {
+  m_runs.clear();
+  m_indexes.clear();
+  m_dataEnd = 0;
+  m_end = 0;
+
+  // A file that doesn't exist yet is an empty archive.
+  std::ifstream input(m_path, std::ios::binary | std::ios::ate);
+  if (!input) return;
+  uint64_t size = input.tellg();
+  if (size < sizeof(kMagic) + kFooterSize ||
+      std::memcmp(ReadRange(input, 0, sizeof(kMagic)).data(), kMagic,
+                  sizeof(kMagic)) != 0)
+    throw std::runtime_error(m_path + " is not a run archive.");
+
+  // The footer is normally at the very end of the file. If adding a run was
+  // interrupted, the end of the file is only part of the new run, so the
+  // last valid footer before it is used instead, which still describes all
+  // of the earlier runs.
+  Footer footer;
+  uint64_t end = size;
+  while (m_end == 0) {
+    uint64_t begin = end - std::min(end - sizeof(kMagic), kScanBlock);
+    auto block = ReadRange(input, begin, end - begin);
+    for (uint64_t footerEnd = end;
+         m_end == 0 && footerEnd >= begin + kFooterSize; --footerEnd) {
+      if (ParseFooter(block.data() + (footerEnd - kFooterSize - begin),
+                      footerEnd, &footer))
+        m_end = footerEnd;
+    }
+
+    // The next block overlaps this one by all but one byte of a footer.
+    if (begin == sizeof(kMagic)) break;
+    end = begin + kFooterSize - 1;
+  }
+  if (m_end == 0) throw std::runtime_error(m_path + " is not a run archive.");
+  m_dataEnd = footer.indexOffset;
+
+  // Follow the chain of indexes back to the first one, and read them from
+  // the oldest to the newest. Each footer points to an earlier one, so the
+  // chain always ends.
+  std::vector<std::pair<Footer, uint64_t>> chain{{footer, m_end}};
+  while (chain.back().first.previous != 0) {
+    uint64_t footerEnd = chain.back().first.previous;
+    auto bytes = ReadRange(input, footerEnd - kFooterSize, kFooterSize);
+    if (!ParseFooter(bytes.data(), footerEnd, &footer)) ByteReader::Corrupt();
+    chain.emplace_back(footer, footerEnd);
+  }
+
+  for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+    auto index =
+        ReadRange(input, link->first.indexOffset, link->first.indexSize);
+    ByteReader reader(index.data(), index.data() + index.size());
+    size_t start = reader.Varint();
+    size_t count = reader.Varint();
+    if (start != m_runs.size() || count > reader.Remaining())
+      ByteReader::Corrupt();
+
+    m_runs.resize(start + count);
+    for (size_t i = start; i < m_runs.size(); ++i) {
+      auto& run = m_runs[i];
+      run.robot = reader.String();
+      run.date = reader.String();
+      run.mechanism = reader.String();
+      run.settings = reader.String();
+
+      size_t segments = reader.Varint();
+      if (segments > reader.Remaining()) ByteReader::Corrupt();
+      run.segments.resize(segments);
+      for (auto&& segment : run.segments) {
+        segment.test = reader.String();
+        segment.offset = reader.Varint();
+        segment.size = reader.Varint();
+        segment.samples = reader.Varint();
+      }
+    }
+    m_indexes.push_back({m_runs.size(), link->second});
+  }
+}
+
+ArchiveStats RunArchive::AddRun(const wpi::json& json,
+                                const std::string& robot, std::string date) {
+  // Pick up any runs that were added since the index was read.
+  ReadIndex();
+
+  if (date.empty()) date = json.value("date", "");
+  if (date.empty()) {
+    char now[32];
+    std::time_t time = std::time(nullptr);
+    std::strftime(now, sizeof(now), "%Y-%m-%d %H:%M:%S",
+                  std::localtime(&time));
+    date = now;
+  }
+
+  Run run{robot, std::move(date), json.at("test").get<std::string>(), "",
+          {}};
+
+  // Encode each test as its own segment, right after the footer of the
+  // earlier runs.
+  std::vector<uint8_t> data;
+  bool create = m_end == 0;
+  if (create) data.assign(std::begin(kMagic), std::end(kMagic));
+  wpi::json settings = wpi::json::object();
+  ArchiveStats stats;
+  for (auto it = json.begin(); it != json.end(); ++it) {
+    if (!it.value().is_array()) {
+      settings[it.key()] = it.value();
+      continue;
+    }
+
+    size_t begin = data.size();
+    stats.rawBytes += EncodeSessionTest(it.key(), it.value(), &data);
+    run.segments.push_back(
+        {it.key(), m_end + begin, data.size() - begin, it.value().size()});
+  }
+  run.settings = settings.dump();
+  stats.archiveBytes = data.size();
+
+  // Write the index of the new run, which also holds the runs since the
+  // start of the index (see IndexStart()), and points back to the index
+  // that ends there.
+  size_t start = IndexStart(m_runs.size() + 1);
+  while (!m_indexes.empty() && m_indexes.back().runs > start)
+    m_indexes.pop_back();
+  uint64_t previous = m_indexes.empty() ? 0 : m_indexes.back().footerEnd;
+
+  uint64_t indexOffset = m_end + data.size();
+  WriteVarint(&data, start);
+  WriteVarint(&data, m_runs.size() + 1 - start);
+  for (size_t i = start; i <= m_runs.size(); ++i) {
+    const Run& entry = i < m_runs.size() ? m_runs[i] : run;
+    WriteString(&data, entry.robot);
+    WriteString(&data, entry.date);
+    WriteString(&data, entry.mechanism);
+    WriteString(&data, entry.settings);
+    WriteVarint(&data, entry.segments.size());
+    for (auto&& segment : entry.segments) {
+      WriteString(&data, segment.test);
+      WriteVarint(&data, segment.offset);
+      WriteVarint(&data, segment.size);
+      WriteVarint(&data, segment.samples);
+    }
+  }
+  uint64_t indexSize = m_end + data.size() - indexOffset;
+  WriteFixed<uint64_t>(&data, indexOffset);
+  WriteFixed<uint64_t>(&data, indexSize);
+  WriteFixed<uint64_t>(&data, previous);
+  data.insert(data.end(), std::begin(kMagic), std::end(kMagic));
+
+  // Nothing before the end of the old footer is written, so the earlier runs
+  // stay readable even if this write is interrupted. Anything after it is
+  // what is left of an earlier interrupted write.
+  auto mode = std::ios::binary | std::ios::out;
+  if (!create) mode |= std::ios::in;
+  std::fstream output(m_path, mode);
+  output.seekp(m_end);
+  output.write(reinterpret_cast<const char*>(data.data()), data.size());
+  output.close();
+  if (!output) throw std::runtime_error("Could not write " + m_path + ".");
+
+  m_runs.push_back(std::move(run));
+  m_dataEnd = indexOffset;
+  m_end += data.size();
+  m_indexes.push_back({m_runs.size(), m_end});
+  return stats;
+}
+
+SessionTest RunArchive::LoadSegment(size_t run, wpi::StringRef test,
+                                    ArchiveStats* stats) const {
+  if (run >= m_runs.size())
+    throw std::runtime_error("The run archive does not contain the run.");
+  const Segment* segment = m_runs[run].Find(test);
+  if (!segment) {
+    throw std::runtime_error("The run does not contain " + test.str() +
+                             ".");
+  }
+  if (segment->offset > m_dataEnd ||
+      segment->size > m_dataEnd - segment->offset)
+    throw std::runtime_error("The run archive is corrupt.");
+
+  auto start = std::chrono::steady_clock::now();
+  std::ifstream input(m_path, std::ios::binary);
+  if (!input) throw std::runtime_error("Could not read " + m_path + ".");
+  auto bytes = ReadRange(input, segment->offset, segment->size);
+  auto tests = DecodeSessionTests(bytes.data(), bytes.size(), 1);
+  if (tests[0].name != segment->test)
+    throw std::runtime_error("The run archive is corrupt.");
+
+  if (stats) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    *stats = {tests[0].Size() * tests[0].columns.size() * sizeof(double),
+              bytes.size(), elapsed.count()};
+  }
+  return std::move(tests[0]);
+}
+
+bool frcchar::IsRunArchive(wpi::StringRef path) {
+  return path.endswith_lower(kRunArchiveExtension);
+}
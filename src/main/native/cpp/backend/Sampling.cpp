@@ -0,0 +1,70 @@
+// MIT License
+
+#include "backend/Sampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace frcchar;
+
+void SamplingStats::Merge(const SamplingStats& other) {
+  if (other.samples == 0) return;
+  if (samples == 0) {
+    *this = other;
+    return;
+  }
+
+  double total = samples + other.samples;
+  double weight = samples / total;
+  double otherWeight = other.samples / total;
+  period = weight * period + otherWeight * other.period;
+  jitter = std::sqrt(weight * jitter * jitter +
+                     otherWeight * other.jitter * other.jitter);
+  samples += other.samples;
+  duplicates += other.duplicates;
+  gaps += other.gaps;
+  maxGap = std::max(maxGap, other.maxGap);
+}
+
+SamplingStats frcchar::AnalyzeSampling(const double* time, size_t size,
+                                       MonotonicArena* arena) {
+  SamplingStats stats;
+  stats.samples = size;
+  if (size < 2) return stats;
+
+  // Each sample is compared with the latest one before it, so a sample that
+  // goes back in time is a duplicate rather than making the next one a gap.
+  ArenaVector<double> intervals{ArenaAllocator<double>(arena)};
+  intervals.reserve(size - 1);
+  double latest = time[0];
+  for (size_t i = 1; i < size; ++i) {
+    if (time[i] <= latest) {
+      ++stats.duplicates;
+      continue;
+    }
+    intervals.push_back(time[i] - latest);
+    latest = time[i];
+  }
+  if (intervals.empty()) return stats;
+
+  // The median is not thrown off by gaps or bursts the way the mean is.
+  auto median = intervals.begin() + intervals.size() / 2;
+  std::nth_element(intervals.begin(), median, intervals.end());
+  stats.period = *median;
+
+  double maxRegular = SamplingStats::kGapPeriods * stats.period;
+  double sumSquares = 0.0;
+  size_t regular = 0;
+  for (double interval : intervals) {
+    if (interval > maxRegular) {
+      ++stats.gaps;
+      stats.maxGap = std::max(stats.maxGap, interval);
+    } else {
+      double error = interval - stats.period;
+      sumSquares += error * error;
+      ++regular;
+    }
+  }
+  if (regular > 0) stats.jitter = std::sqrt(sumSquares / regular);
+  return stats;
+}
@@ -0,0 +1,335 @@
+// MIT License
+
+#include "backend/SessionArchive.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <wpi/raw_ostream.h>
+
+#include "backend/ByteCodec.h"
+#include "backend/Parallel.h"
+
+using namespace frcchar;
+
+namespace {
+using Bytes = std::vector<uint8_t>;
+
+// Identifies a file as a session archive, along with the format version.
+constexpr char kMagic[8] = {'F', 'R', 'C', 'C', 'H', 'A', 'R', '1'};
+
+// Each value is stored as the nearest multiple of 1 / kScale.
+constexpr double kScale = 1E6;
+
+// Quantized values must be exactly representable as doubles.
+constexpr double kMaxQuantized = 9007199254740992.0;
+
+// The largest number of samples in a block.
+constexpr size_t kBlockSize = 4096;
+
+// The highest order of differences that a block of a column can be stored as.
+constexpr uint8_t kMaxOrder = 2;
+
+/**
+ * Calculates the CRC-32 (as used by zlib) of the given bytes.
+ */
+uint32_t Crc32(const uint8_t* data, size_t size) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < table.size(); ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+      table[i] = crc;
+    }
+    return table;
+  }();
+
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+/**
+ * Maps signed integers to unsigned ones so that values close to zero stay
+ * small (0, -1, 1, -2, ... become 0, 1, 2, 3, ...).
+ */
+uint64_t ZigZag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+size_t VarintSize(uint64_t value) {
+  size_t size = 1;
+  for (; value >= 0x80; value >>= 7) ++size;
+  return size;
+}
+
+/**
+ * Replaces the values with their differences of the given order. The first
+ * value of each pass is kept so that the differences can be undone.
+ */
+void Differentiate(int64_t* values, size_t size, uint8_t order) {
+  for (size_t pass = 0; pass < order; ++pass) {
+    for (size_t i = size; i-- > pass + 1;) values[i] -= values[i - 1];
+  }
+}
+
+void Integrate(int64_t* values, size_t size, uint8_t order) {
+  for (size_t pass = order; pass-- > 0;) {
+    for (size_t i = pass + 1; i < size; ++i) values[i] += values[i - 1];
+  }
+}
+
+int64_t Quantize(double value) {
+  double scaled = std::round(value * kScale);
+  if (!(std::abs(scaled) < kMaxQuantized)) {
+    throw std::runtime_error("The value " + std::to_string(value) +
+                             " cannot be stored in a session archive.");
+  }
+  return static_cast<int64_t>(scaled);
+}
+
+/**
+ * Appends a block of one column to the payload of a block, stored as the
+ * order of differences that takes the fewest bytes.
+ */
+void EncodeColumn(const int64_t* values, size_t size, Bytes* out) {
+  std::array<int64_t, kBlockSize> residuals;
+  uint8_t bestOrder = 0;
+  size_t bestSize = SIZE_MAX;
+  for (uint8_t order = 0; order <= kMaxOrder; ++order) {
+    std::copy(values, values + size, residuals.begin());
+    Differentiate(residuals.data(), size, order);
+
+    size_t encoded = 0;
+    for (size_t i = 0; i < size; ++i)
+      encoded += VarintSize(ZigZag(residuals[i]));
+    if (encoded < bestSize) {
+      bestSize = encoded;
+      bestOrder = order;
+    }
+  }
+
+  std::copy(values, values + size, residuals.begin());
+  Differentiate(residuals.data(), size, bestOrder);
+  out->push_back(bestOrder);
+  for (size_t i = 0; i < size; ++i) WriteVarint(out, ZigZag(residuals[i]));
+}
+
+/**
+ * The location of a block within an archive, and where its samples go.
+ */
+struct Block {
+  SessionTest* test;
+  size_t begin, size;
+  uint32_t crc;
+  const uint8_t* payload;
+  size_t payloadSize;
+};
+
+/**
+ * Decodes a block directly into the columns of its test.
+ */
+void DecodeBlock(const Block& block) {
+  if (Crc32(block.payload, block.payloadSize) != block.crc)
+    ByteReader::Corrupt();
+
+  std::array<int64_t, kBlockSize> values;
+  ByteReader reader(block.payload, block.payload + block.payloadSize);
+  for (auto&& column : block.test->columns) {
+    uint8_t order = *reader.Skip(1);
+    if (order > kMaxOrder) ByteReader::Corrupt();
+    for (size_t i = 0; i < block.size; ++i)
+      values[i] = UnZigZag(reader.Varint());
+    Integrate(values.data(), block.size, order);
+
+    double* out = column.data() + block.begin;
+    for (size_t i = 0; i < block.size; ++i) out[i] = values[i] / kScale;
+  }
+  if (reader.Remaining() != 0) ByteReader::Corrupt();
+}
+}  // namespace
+
+const SessionTest* Session::Find(wpi::StringRef name) const {
+  for (auto&& test : tests) {
+    if (test.name == name) return &test;
+  }
+  return nullptr;
+}
+
+bool frcchar::IsSessionArchive(wpi::StringRef path) {
+  return path.endswith_lower(kArchiveExtension);
+}
+
+size_t frcchar::EncodeSessionTest(const std::string& name,
+                                  const wpi::json& samples,
+                                  std::vector<uint8_t>* out) {
+  // Quantize each column of the test.
+  size_t size = samples.size();
+  size_t columns = size > 0 ? samples[0].size() : 0;
+  std::vector<std::vector<int64_t>> quantized(columns,
+                                              std::vector<int64_t>(size));
+  for (size_t i = 0; i < size; ++i) {
+    if (samples[i].size() != columns) {
+      throw std::runtime_error("The samples of " + name +
+                               " do not all have the same size.");
+    }
+    for (size_t col = 0; col < columns; ++col)
+      quantized[col][i] = Quantize(samples[i][col].get<double>());
+  }
+
+  WriteString(out, name);
+  WriteVarint(out, columns);
+  WriteVarint(out, size);
+  WriteVarint(out, (size + kBlockSize - 1) / kBlockSize);
+
+  Bytes payload;
+  for (size_t begin = 0; begin < size; begin += kBlockSize) {
+    size_t blockSize = std::min(kBlockSize, size - begin);
+    payload.clear();
+    for (auto&& column : quantized)
+      EncodeColumn(column.data() + begin, blockSize, &payload);
+
+    WriteVarint(out, blockSize);
+    WriteFixed<uint32_t>(out, Crc32(payload.data(), payload.size()));
+    WriteVarint(out, payload.size());
+    out->insert(out->end(), payload.begin(), payload.end());
+  }
+
+  return size * columns * sizeof(double);
+}
+
+std::vector<SessionTest> frcchar::DecodeSessionTests(const uint8_t* data,
+                                                     size_t size,
+                                                     size_t count) {
+  // Find all of the blocks first so that they can be decoded in parallel.
+  // Every sample of every column takes at least one byte, which bounds the
+  // sizes that are allocated before the blocks are checked.
+  ByteReader reader(data, data + size);
+  if (count > reader.Remaining()) ByteReader::Corrupt();
+  std::vector<SessionTest> tests(count);
+  std::vector<Block> blocks;
+  for (auto&& test : tests) {
+    test.name = reader.String();
+    size_t columns = reader.Varint();
+    size_t samples = reader.Varint();
+    size_t blockCount = reader.Varint();
+    if (columns > reader.Remaining() || samples > reader.Remaining() ||
+        (columns > 0 && samples > reader.Remaining() / columns) ||
+        blockCount > reader.Remaining())
+      ByteReader::Corrupt();
+
+    size_t begin = 0;
+    for (size_t i = 0; i < blockCount; ++i) {
+      Block block;
+      block.test = &test;
+      block.begin = begin;
+      block.size = reader.Varint();
+      block.crc = reader.Fixed<uint32_t>();
+      block.payloadSize = reader.Varint();
+      block.payload = reader.Skip(block.payloadSize);
+      if (block.size > kBlockSize || block.size > samples - begin)
+        ByteReader::Corrupt();
+      begin += block.size;
+      blocks.push_back(block);
+    }
+    if (begin != samples) ByteReader::Corrupt();
+
+    test.columns.assign(columns, std::vector<double>(samples));
+  }
+  if (reader.Remaining() != 0) ByteReader::Corrupt();
+
+  // Worker threads can't throw, so corruption is reported once all of them
+  // are done.
+  std::atomic<bool> corrupt{false};
+  ParallelFor(blocks.size(), [&](size_t begin, size_t end) {
+    try {
+      for (size_t i = begin; i < end; ++i) DecodeBlock(blocks[i]);
+    } catch (const std::runtime_error&) {
+      corrupt = true;
+    }
+  });
+  if (corrupt) ByteReader::Corrupt();
+
+  return tests;
+}
+
+ArchiveStats frcchar::WriteSessionArchive(const wpi::json& json,
+                                          const std::string& path) {
+  ArchiveStats stats;
+  wpi::json settings = wpi::json::object();
+  Bytes tests;
+  size_t count = 0;
+
+  for (auto it = json.begin(); it != json.end(); ++it) {
+    if (it.value().is_array()) {
+      stats.rawBytes += EncodeSessionTest(it.key(), it.value(), &tests);
+      ++count;
+    } else {
+      settings[it.key()] = it.value();
+    }
+  }
+
+  Bytes archive(std::begin(kMagic), std::end(kMagic));
+  WriteString(&archive, settings.dump());
+  WriteVarint(&archive, count);
+  archive.insert(archive.end(), tests.begin(), tests.end());
+  stats.archiveBytes = archive.size();
+
+  std::error_code ec;
+  wpi::raw_fd_ostream output(path, ec);
+  if (ec) {
+    throw std::runtime_error("Could not write " + path + ": " +
+                             ec.message());
+  }
+  output.write(reinterpret_cast<const char*>(archive.data()), archive.size());
+  output.close();
+  if (output.has_error())
+    throw std::runtime_error("Could not write " + path + ".");
+
+  return stats;
+}
+
+Session frcchar::ReadSessionArchive(const std::string& path,
+                                    ArchiveStats* stats) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input) throw std::runtime_error("Could not read " + path + ".");
+  Bytes archive((std::istreambuf_iterator<char>(input)),
+                std::istreambuf_iterator<char>());
+
+  auto start = std::chrono::steady_clock::now();
+  if (archive.size() < sizeof(kMagic) ||
+      std::memcmp(archive.data(), kMagic, sizeof(kMagic)) != 0)
+    throw std::runtime_error(path + " is not a session archive.");
+
+  ByteReader reader(archive.data() + sizeof(kMagic),
+                    archive.data() + archive.size());
+  Session session;
+  session.settings = wpi::json::parse(reader.String());
+  size_t count = reader.Varint();
+  size_t remaining = reader.Remaining();
+  session.tests = DecodeSessionTests(reader.Skip(remaining), remaining, count);
+
+  if (stats) {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    *stats = {0, archive.size(), elapsed.count()};
+    for (auto&& test : session.tests)
+      stats->rawBytes += test.Size() * test.columns.size() * sizeof(double);
+  }
+  return session;
+}
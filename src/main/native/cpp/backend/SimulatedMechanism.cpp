@@ -0,0 +1,172 @@
+// MIT License
+
+#include "backend/SimulatedMechanism.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <frc/system/Discretization.h>
+#include <frc/system/plant/LinearSystemId.h>
+
+#include "backend/LatencyProbe.h"
+#include "backend/TelemetryCapture.h"
+
+using namespace frcchar;
+
+namespace {
+// The battery voltage of the simulated robot.
+constexpr double kBatteryVoltage = 12.0;
+}  // namespace
+
+SimulatedMechanism::SimulatedMechanism(const Parameters& params,
+                                       unsigned int port)
+    : m_params(params), m_inst(nt::CreateInstance()) {
+  // Start a server that only listens on localhost, and send updates as often
+  // as NetworkTables allows.
+  nt::SetUpdateRate(m_inst, 0.01);
+  nt::StartServer(m_inst, "", "127.0.0.1", port);
+  m_thread = std::thread([this] { Run(); });
+}
+
+SimulatedMechanism::~SimulatedMechanism() {
+  m_running = false;
+  m_thread.join();
+  nt::StopServer(m_inst);
+  nt::DestroyInstance(m_inst);
+}
+
+void SimulatedMechanism::Run() {
+  units::hertz_t rate = std::min(m_params.rate, kMaxRate);
+  units::second_t dt{1.0 / rate.to<double>()};
+
+  // Discretize the plant of a single side.
+  auto system = frc::LinearSystemId::IdentifyPositionSystem<units::meter>(
+      m_params.Kv, m_params.Ka);
+  Eigen::Matrix<double, 2, 2> A;
+  Eigen::Matrix<double, 2, 1> B;
+  frc::DiscretizeAB<2, 1>(system.A(), system.B(), dt, &A, &B);
+
+  // Advances a single side, whose state is its position and velocity.
+  double Ks = m_params.Ks.to<double>();
+  auto step = [&](Eigen::Vector2d* x, double voltage) {
+    double velocity = (*x)(1);
+
+    // A side that is not moving stays put until the voltage overcomes the
+    // static friction.
+    if (velocity == 0 && std::abs(voltage) <= Ks) return;
+
+    double u = voltage - std::copysign(Ks, velocity != 0 ? velocity : voltage);
+    Eigen::Vector2d next = A * *x + B * u;
+
+    // Friction can stop a side, but it can never reverse it.
+    if (std::abs(voltage) <= Ks && next(1) * velocity < 0) next(1) = 0;
+    *x = next;
+  };
+
+  NT_Entry autospeedEntry =
+      nt::GetEntry(m_inst, TelemetryCapture::kAutospeedEntry);
+  NT_Entry rotateEntry = nt::GetEntry(m_inst, TelemetryCapture::kRotateEntry);
+  NT_Entry telemetryEntry =
+      nt::GetEntry(m_inst, TelemetryCapture::kTelemetryEntry);
+  NT_Entry pingEntry = nt::GetEntry(m_inst, LatencyProbe::kPingEntry);
+  NT_Entry pongEntry = nt::GetEntry(m_inst, LatencyProbe::kPongEntry);
+  double lastPing = 0.0;
+
+  std::mt19937 rng;
+  std::normal_distribution<double> normal;
+  auto noise = [&] { return m_params.noise.to<double>() * normal(rng); };
+
+  // The measurements of the last few steps, used to delay them by the
+  // latency. Each one holds the positions and velocities of both sides.
+  size_t delay = std::lround((m_params.latency / dt).to<double>());
+  std::deque<std::array<double, 4>> measurements;
+
+  Eigen::Vector2d left = Eigen::Vector2d::Zero();
+  Eigen::Vector2d right = Eigen::Vector2d::Zero();
+  auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(dt.to<double>()));
+  auto nextStep = std::chrono::steady_clock::now();
+
+  // NetworkTables only sends the latest value of an entry at each flush, so
+  // the samples are published in batches, which are flushed less often than
+  // NetworkTables allows.
+  size_t batchSize = std::max<long>(
+      std::lround((kPublishPeriod / dt).to<double>()), 1);
+  std::vector<double> batch;
+  batch.reserve(batchSize * TelemetryCapture::kSampleSize);
+
+  for (size_t i = 0; m_running; ++i) {
+    double time = i * dt.to<double>();
+
+    // Answer new pings of the Logger the same way that the robot does. Pings
+    // are only read once per step, so they are received and answered at the
+    // same time, and the sensor delay is the delay of the measurements.
+    auto pingValue = nt::GetEntryValue(pingEntry);
+    if (pingValue && pingValue->IsDoubleArray()) {
+      auto ping = pingValue->GetDoubleArray();
+      if (ping.size() == 2 && ping[0] != lastPing) {
+        lastPing = ping[0];
+        std::array<double, 5> pong{ping[0], ping[1], time, time,
+                                   delay * dt.to<double>()};
+        nt::SetEntryValue(pongEntry, nt::Value::MakeDoubleArray(pong));
+      }
+    }
+
+    // Read the voltage command sent by the Logger.
+    auto autospeedValue = nt::GetEntryValue(autospeedEntry);
+    auto rotateValue = nt::GetEntryValue(rotateEntry);
+    double autospeed = autospeedValue && autospeedValue->IsDouble()
+                           ? autospeedValue->GetDouble()
+                           : 0.0;
+    bool rotate = m_params.drivetrain && rotateValue &&
+                  rotateValue->IsBoolean() && rotateValue->GetBoolean();
+
+    double rightVoltage = autospeed * kBatteryVoltage;
+    double leftVoltage = rotate ? -rightVoltage : rightVoltage;
+
+    // Mechanisms with a single side report it as both sides.
+    step(&left, leftVoltage);
+    if (m_params.drivetrain)
+      step(&right, rightVoltage);
+    else
+      right = left;
+
+    measurements.push_back({left(0), right(0), left(1), right(1)});
+    if (measurements.size() > delay + 1) measurements.pop_front();
+    const auto& m = measurements.front();
+
+    // Publish the telemetry in the same format as the robot.
+    double leftVelocity = m[2] + noise();
+    double rightVelocity = m_params.drivetrain ? m[3] + noise() : leftVelocity;
+    double gyro = m_params.drivetrain
+                      ? (m[1] - m[0]) / m_params.trackWidth.to<double>()
+                      : 0.0;
+    TelemetryCapture::Sample telemetry{
+        time,
+        kBatteryVoltage,
+        autospeed,
+        leftVoltage,
+        rightVoltage,
+        m[0],
+        m[1],
+        leftVelocity,
+        rightVelocity,
+        gyro};
+    batch.insert(batch.end(), telemetry.begin(), telemetry.end());
+    if (batch.size() == batchSize * TelemetryCapture::kSampleSize) {
+      nt::SetEntryValue(telemetryEntry, nt::Value::MakeDoubleArray(batch));
+      nt::Flush(m_inst);
+      m_samples += batchSize;
+      batch.clear();
+    }
+
+    nextStep += period;
+    std::this_thread::sleep_until(nextStep);
+  }
+}
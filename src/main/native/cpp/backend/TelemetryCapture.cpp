@@ -0,0 +1,108 @@
+// MIT License
+
+#include "backend/TelemetryCapture.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <networktables/NetworkTableValue.h>
+
+using namespace frcchar;
+
+TelemetryCapture::TelemetryCapture(NT_Inst inst)
+    : m_poller(nt::CreateEntryListenerPoller(inst)) {
+  nt::AddPolledEntryListener(m_poller, kTelemetryEntry,
+                             NT_NOTIFY_NEW | NT_NOTIFY_UPDATE);
+}
+
+TelemetryCapture::~TelemetryCapture() {
+  nt::DestroyEntryListenerPoller(m_poller);
+}
+
+void TelemetryCapture::Poll(double timeout) {
+  bool timedOut;
+  for (auto&& event : nt::PollEntryListener(m_poller, timeout, &timedOut)) {
+    // Ignore other entries that share the prefix and malformed values.
+    if (event.name != kTelemetryEntry || !event.value ||
+        !event.value->IsDoubleArray())
+      continue;
+
+    auto values = event.value->GetDoubleArray();
+    if (values.empty() || values.size() % kSampleSize != 0) continue;
+
+    for (size_t i = 0; i < values.size(); i += kSampleSize) {
+      Sample sample;
+      std::copy(values.begin() + i, values.begin() + i + kSampleSize,
+                sample.begin());
+
+      // The value is stamped with the host time at which it was received.
+      if (m_clockOffset) {
+        double hostTime = sample[0] - *m_clockOffset;
+        sample[0] = hostTime - m_hostOrigin;
+        m_deliveryDelay.Add(
+            LatencyProbe::ToSeconds(event.value->last_change()) - hostTime);
+      }
+      AddSample(sample);
+    }
+  }
+
+  // Update the rate once the current window is a second long.
+  auto now = std::chrono::steady_clock::now();
+  std::chrono::duration<double> elapsed = now - m_windowStart;
+  if (elapsed.count() >= 1.0) {
+    m_rate = m_windowSamples / elapsed.count();
+    m_windowStart = now;
+    m_windowSamples = 0;
+  }
+}
+
+void TelemetryCapture::SetClockOffset(std::optional<double> offset) {
+  m_clockOffset = offset;
+  m_hostOrigin = LatencyProbe::GetHostTime();
+}
+
+std::optional<double> TelemetryCapture::GetTimestampShift() const {
+  if (!m_clockOffset) return std::nullopt;
+  return *m_clockOffset + m_hostOrigin;
+}
+
+void TelemetryCapture::Reset() {
+  m_samples.clear();
+  m_period = 0.0;
+  m_gaps.clear();
+  m_dropped = 0;
+  m_deliveryDelay = RunningStats{};
+  m_windowStart = std::chrono::steady_clock::now();
+  m_windowSamples = 0;
+  m_rate = 0.0;
+}
+
+void TelemetryCapture::AddSample(const Sample& sample) {
+  ++m_windowSamples;
+  if (!m_samples.empty()) {
+    double dt = sample[0] - m_samples.back()[0];
+
+    // Only gaps within a test say anything about lost samples.
+    if (dt > 0 && dt < kMaxGap) {
+      if (m_period > 0) {
+        CountDropped(dt);
+      } else {
+        m_gaps.push_back(dt);
+        if (m_gaps.size() == kPeriodSamples) {
+          // The median ignores the few gaps that are caused by drops.
+          auto median = m_gaps.begin() + m_gaps.size() / 2;
+          std::nth_element(m_gaps.begin(), median, m_gaps.end());
+          m_period = *median;
+          for (double gap : m_gaps) CountDropped(gap);
+          m_gaps.clear();
+        }
+      }
+    }
+  }
+  m_samples.push_back(sample);
+}
+
+void TelemetryCapture::CountDropped(double dt) {
+  long periods = std::lround(dt / m_period);
+  if (periods > 1) m_dropped += periods - 1;
+}
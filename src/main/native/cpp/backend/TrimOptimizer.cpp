@@ -0,0 +1,227 @@
+// MIT License
+
+#include "backend/TrimOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+#include "backend/OLS.h"
+
+using namespace frcchar;
+
+namespace {
+// The most times that each cut point is optimized.
+constexpr size_t kMaxRounds = 16;
+
+using SumsVector = ArenaVector<OLSSums>;
+
+/**
+ * Returns the adjusted r-squared of the regression of the given sums, or
+ * negative infinity if they do not determine the regression.
+ */
+double Fit(const OLSSums& sums) {
+  if (sums.n <= 3) return -std::numeric_limits<double>::infinity();
+  double rSquared = OLS(sums)[3];
+  return std::isfinite(rSquared) ? rSquared
+                                 : -std::numeric_limits<double>::infinity();
+}
+
+/**
+ * Adds a single prepared sample to regression sums.
+ */
+void AddSample(const PreparedData& data, size_t i, OLSSums* sums) {
+  double sample[] = {data.Voltage(i), data.Intercept(i), data.Velocity(i),
+                     data.Acceleration(i)};
+  sums->Add(sample);
+}
+
+/**
+ * Calculates the sums of the samples at positions [i, size) of the given
+ * order of the samples, for every i up to the given maximum.
+ */
+template <typename Index>
+SumsVector SuffixSums(const PreparedData& data, size_t max, Index&& index,
+                      MonotonicArena* arena) {
+  SumsVector suffix(max + 1, OLSSums{}, ArenaAllocator<OLSSums>(arena));
+  OLSSums sums;
+  for (size_t i = data.Size(); i-- > 0;) {
+    AddSample(data, index(i), &sums);
+    if (i <= max) suffix[i] = sums;
+  }
+  return suffix;
+}
+
+/**
+ * Evaluates each of the given number of candidates, and returns the one with
+ * the highest fit. Ties go to the first candidate, which cuts the least. The
+ * fit of each candidate and the best one are stored in the curve if one is
+ * given.
+ */
+template <typename F>
+size_t Best(size_t candidates, F&& fit, TrimCurve* curve = nullptr) {
+  size_t best = 0;
+  double bestFit = -std::numeric_limits<double>::infinity();
+  for (size_t i = 0; i < candidates; ++i) {
+    double value = fit(i);
+    if (curve) curve->rSquared.push_back(value);
+    if (value > bestFit) {
+      best = i;
+      bestFit = value;
+    }
+  }
+  if (curve) curve->chosen = best;
+  return best;
+}
+}  // namespace
+
+TrimResult frcchar::OptimizeTrim(const std::vector<TrimSegment>& segments,
+                                 MonotonicArena* arena) {
+  TrimResult result;
+  result.starts.assign(segments.size(), 0);
+
+  // The candidate thresholds are spaced evenly up to the speed below which
+  // kMaxTrimFraction of the quasistatic samples are.
+  ArenaVector<double> speeds{ArenaAllocator<double>(arena)};
+  for (auto&& segment : segments) {
+    if (!segment.quasistatic) continue;
+    for (size_t i = 0; i < segment.data->Size(); ++i)
+      speeds.push_back(std::abs(segment.data->Velocity(i)));
+  }
+  double maxThreshold = 0.0;
+  if (!speeds.empty()) {
+    auto quantile =
+        speeds.begin() +
+        static_cast<size_t>(kMaxTrimFraction * (speeds.size() - 1));
+    std::nth_element(speeds.begin(), quantile, speeds.end());
+    maxThreshold = *quantile;
+  }
+  size_t thresholds = speeds.empty() ? 0 : kThresholdCandidates;
+  auto threshold = [&](size_t j) {
+    return maxThreshold * j / (kThresholdCandidates - 1);
+  };
+
+  // Sum the quasistatic samples that each threshold keeps. Sorting the
+  // samples of each segment by speed makes the samples that a threshold
+  // keeps a suffix of them.
+  SumsVector thresholdSums(thresholds, OLSSums{},
+                           ArenaAllocator<OLSSums>(arena));
+  for (auto&& segment : segments) {
+    if (!segment.quasistatic || segment.data->Size() == 0) continue;
+    const auto& data = *segment.data;
+
+    ArenaVector<size_t> order(data.Size(), 0, ArenaAllocator<size_t>(arena));
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return std::abs(data.Velocity(a)) < std::abs(data.Velocity(b));
+    });
+
+    // The number of samples that each threshold removes.
+    ArenaVector<size_t> cuts(thresholds, 0, ArenaAllocator<size_t>(arena));
+    size_t cut = 0;
+    for (size_t j = 0; j < thresholds; ++j) {
+      while (cut < order.size() &&
+             std::abs(data.Velocity(order[cut])) <= threshold(j))
+        ++cut;
+      cuts[j] = cut;
+    }
+
+    auto suffix = SuffixSums(
+        data, cuts.back(), [&](size_t i) { return order[i]; }, arena);
+    for (size_t j = 0; j < thresholds; ++j) thresholdSums[j] += suffix[cuts[j]];
+  }
+
+  // Sum the samples of each dynamic segment that each start keeps.
+  ArenaVector<SumsVector> startSums{ArenaAllocator<SumsVector>(arena)};
+  ArenaVector<size_t> dynamic{ArenaAllocator<size_t>(arena)};
+  for (size_t s = 0; s < segments.size(); ++s) {
+    const auto& data = *segments[s].data;
+    if (segments[s].quasistatic || data.Size() == 0) {
+      startSums.emplace_back(ArenaAllocator<OLSSums>(arena));
+      continue;
+    }
+    // A step voltage test is cut no later than the peak of its acceleration,
+    // since the samples after it are the ones that determine Ka.
+    size_t limit = static_cast<size_t>(kMaxTrimFraction * data.Size());
+    size_t max = 0;
+    for (size_t i = 0; i <= limit && i < data.Size(); ++i) {
+      if (std::abs(data.Acceleration(i)) > std::abs(data.Acceleration(max)))
+        max = i;
+    }
+    startSums.push_back(
+        SuffixSums(data, max, [](size_t i) { return i; }, arena));
+    dynamic.push_back(s);
+  }
+
+  // The sums of all segments with the chosen cuts, except for the threshold
+  // or the start of the given segment.
+  size_t chosenThreshold = 0;
+  auto rest = [&](bool withThreshold, size_t skip) {
+    OLSSums sums;
+    if (withThreshold && thresholds > 0) sums += thresholdSums[chosenThreshold];
+    for (size_t s : dynamic) {
+      if (s != skip) sums += startSums[s][result.starts[s]];
+    }
+    return sums;
+  };
+
+  // Optimizes the threshold, and then the start of each dynamic segment,
+  // with the other cut points fixed. Returns whether any of them changed.
+  auto optimize = [&](bool record) {
+    bool changed = false;
+    if (thresholds > 0) {
+      OLSSums others = rest(false, segments.size());
+      TrimCurve* curve = record ? &result.thresholdCurve : nullptr;
+      size_t best = Best(
+          thresholds,
+          [&](size_t j) {
+            OLSSums sums = others;
+            sums += thresholdSums[j];
+            return Fit(sums);
+          },
+          curve);
+      changed |= best != chosenThreshold;
+      chosenThreshold = best;
+    }
+
+    for (size_t s : dynamic) {
+      OLSSums others = rest(true, s);
+      TrimCurve* curve = nullptr;
+      if (record) {
+        curve = &result.startCurves.emplace_back();
+        curve->name = segments[s].name;
+      }
+      size_t best = Best(
+          startSums[s].size(),
+          [&](size_t k) {
+            OLSSums sums = others;
+            sums += startSums[s][k];
+            return Fit(sums);
+          },
+          curve);
+      changed |= best != result.starts[s];
+      result.starts[s] = best;
+    }
+    return changed;
+  };
+
+  for (size_t round = 0; round < kMaxRounds; ++round) {
+    if (!optimize(false)) break;
+  }
+
+  // Evaluate every candidate once more around the chosen cut points so that
+  // they can be plotted.
+  optimize(true);
+  result.thresholdCurve.name = "Motion Threshold";
+  for (size_t j = 0; j < thresholds; ++j)
+    result.thresholdCurve.values.push_back(threshold(j));
+  for (size_t c = 0; c < dynamic.size(); ++c) {
+    const auto& data = *segments[dynamic[c]].data;
+    for (size_t k = 0; k < startSums[dynamic[c]].size(); ++k)
+      result.startCurves[c].values.push_back(data.Time(k) - data.Time(0));
+  }
+
+  result.threshold = thresholds > 0 ? threshold(chosenThreshold) : 0.0;
+  result.rSquared = Fit(rest(true, segments.size()));
+  return result;
+}
@@ -4,19 +4,42 @@
 
 #include <implot.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
 #include <future>
+#include <iterator>
+#include <utility>
 
 #include <imgui.h>
 #include <imgui_stdlib.h>
+#include <wpi/Format.h>
+#include <wpi/json.h>
+#include <wpi/raw_istream.h>
 #include <wpi/raw_ostream.h>
 
 #include "backend/DataProcessor.h"
+#include "backend/FeedbackGains.h"
+#include "backend/FitDiagnostics.h"
+#include "backend/GainDrift.h"
+#include "backend/MemoryUsage.h"
+#include "backend/MinMaxPyramid.h"
+#include "backend/Parallel.h"
+#include "backend/PreparedData.h"
+#include "backend/RunArchive.h"
+#include "backend/SessionArchive.h"
+#include "backend/TrimOptimizer.h"
 #include "display/FRCCharacterization.h"
+#include "display/FrameAudit.h"
+#include "display/IdleThrottle.h"
+#include "display/ScaledFont.h"
 
 using namespace frcchar;
 
 void Analyzer::Initialize() {
-  auto window = FRCCharacterization::Manager.AddWindow("Analyzer", [&] {
+  auto window = FrameAudit::AddWindow("Analyzer", [&] {
     // Get the current width of the window. This will be used to scale the UI
     // elements.
     float width = ImGui::GetContentRegionAvail().x;
@@ -25,32 +48,110 @@ void Analyzer::Initialize() {
     ImGui::Text("File Selection");
 
     // Scale the font size down to fit more of the path.
-    ImFont f = *ImGui::GetFont();
-    f.Scale *= 0.85;
-    ImGui::PushFont(&f);
-
-    ImGui::SetNextItemWidth(width / 1.5);
-    ImGui::InputText("##label", const_cast<char*>(m_modifiedLocation.c_str()),
-                     m_modifiedLocation.capacity() + 1,
-                     ImGuiInputTextFlags_ReadOnly);
-    ImGui::PopFont();
+    {
+      ScaledFont font(0.85f);
+      ImGui::SetNextItemWidth(width / 1.5);
+      ImGui::InputText("##label",
+                       const_cast<char*>(m_modifiedLocation.c_str()),
+                       m_modifiedLocation.capacity() + 1,
+                       ImGuiInputTextFlags_ReadOnly);
+    }
     ImGui::SameLine();
 
     // Create button to select folder location.
     if (ImGui::Button("Choose..")) {
-      m_fileOpener = std::make_unique<pfd::open_file>("Select Data JSON");
+      m_fileOpener = std::make_unique<pfd::open_file>(
+          "Select Data", "",
+          std::vector<std::string>{"Data Files",
+                                   std::string("*.json *") +
+                                       kArchiveExtension + " *" +
+                                       kRunArchiveExtension,
+                                   "All Files", "*"});
     }
     OpenData();
 
+    // Add a checkbox to refresh the analysis whenever the file changes.
+    ImGui::SameLine();
+    ImGui::Checkbox("Watch", &m_watchFile);
+    WatchData();
+    DisplayRuns();
+    if (!m_loadError.empty())
+      ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", m_loadError.c_str());
+
+    // Add a checkbox to store the data as float to reduce memory usage. The
+    // data has to be reloaded when this changes.
+    if (ImGui::Checkbox("Compact Storage", &m_compactStorage) && m_processor)
+      LoadData();
+
+    // Add a checkbox to estimate velocity and acceleration with the smoother
+    // instead of the secant, along with the bandwidth of the smoother.
+    ImGui::SameLine();
+    bool smoothingChanged = ImGui::Checkbox("Smoothing", &m_smoothing);
+    if (m_smoothing) {
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(width / 8);
+      ImGui::InputDouble("Hz", &m_smoothingBandwidth, 0, 0, "%.1f");
+      if (ImGui::IsItemDeactivatedAfterEdit()) {
+        m_smoothingBandwidth = std::max(m_smoothingBandwidth, 0.1);
+        smoothingChanged = true;
+      }
+    }
+    if (smoothingChanged && m_processor) LoadData();
+
+    // Add a checkbox to resample the tests onto a uniform grid.
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Resample", &m_resample) && m_processor) LoadData();
+
+    // Add a checkbox to choose the trim of the tests by how well they fit.
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Optimize Trim", &m_optimizeTrim) && m_processor)
+      LoadData();
+
+    // Display how much memory the data uses, along with the peak memory usage
+    // of the whole process.
+    if (m_processor) {
+      ImGui::SameLine();
+      ImGui::Text("Data: %.1f MB, Peak: %.1f MB",
+                  m_processor->GetMemoryUsage() / 1E6,
+                  GetPeakMemoryUsage() / 1E6);
+
+      // Show the heap allocations of the last load and analysis. The scratch
+      // buffers of a load come from an arena, and analyses do not allocate.
+      auto load = m_processor->GetLoadAllocations();
+      ImGui::Text(
+          "Allocations: %zu in last load (%.1f MB, arena %.1f / %.1f MB), "
+          "%zu in last update",
+          load.allocations, load.bytes / 1E6,
+          m_processor->GetArenaUsage() / 1E6,
+          m_processor->GetArenaCapacity() / 1E6,
+          m_processor->GetUpdateAllocations().allocations);
+    }
+    DisplaySampling();
+    DisplayTrim();
+    DisplayArchive();
+
     ImGui::Separator();
     ImGui::Spacing();
     ImGui::Text("Feedforward Gains");
     ImGui::SameLine(width / 2);
     ImGui::SetNextItemWidth(width / 3);
-    if (ImGui::Combo("##datatype", &m_dataType, DataProcessor::kDataSources,
-                     IM_ARRAYSIZE(DataProcessor::kDataSources)) &&
-        m_processor)
-      m_processor->Update();
+    bool drivetrain = m_processor && m_processor->IsDrivetrain();
+    if (ImGui::Combo("##datatype", &m_dataType,
+                     drivetrain ? DataProcessor::kDrivetrainDataSources
+                                : DataProcessor::kDataSources,
+                     drivetrain
+                         ? IM_ARRAYSIZE(DataProcessor::kDrivetrainDataSources)
+                         : IM_ARRAYSIZE(DataProcessor::kDataSources)) &&
+        m_processor) {
+      UpdateGains();
+      InvalidateBootstrap();
+      m_driftValid = false;
+      m_voltagePointsValid = false;
+      UpdateTimeSeries();
+
+      // The diagnostics of the previous data set are no longer needed.
+      CancelDiagnostics();
+    }
 
     auto showGain = [&](double* source, const char* name) {
       ImGui::SetNextItemWidth(width / 8);
@@ -60,6 +161,12 @@ void Analyzer::Initialize() {
 
     // Display feedforward gains and r-squared for fit.
     showGain(reinterpret_cast<double*>(&m_ffGains.Ks), "Ks");
+    ImGui::SameLine(width / 2);
+    if (ImGui::Button("Gain Drift") && m_processor) {
+      ImPlot::FitNextPlotAxes();
+      ImGui::OpenPopup("Gain Drift");
+    }
+    DisplayDrift();
     showGain(reinterpret_cast<double*>(&m_ffGains.Kv), "Kv");
     ImGui::SameLine(width / 2);
     if (ImGui::Button("Voltage-Domain Plots")) {
@@ -68,19 +175,27 @@ void Analyzer::Initialize() {
     }
 
     if (ImGui::BeginPopupModal("Voltage-Domain Plots")) {
-      if (ImPlot::BeginPlot("Voltage-Domain Plots")) {
-        auto& data = m_processor->GetData();
-        std::vector<ImPlotPoint> points;
-        for (size_t i = 0; i < data.size(); i += 4) {
-          points.emplace_back(data[i] - m_ffGains.Ks.to<double>() -
-                                  m_ffGains.Ka.to<double>() * data[i + 3],
-                              data[i + 2]);
+      // The points are only rebuilt when the data or the gains change.
+      if (!m_voltagePointsValid && m_processor) {
+        m_voltagePoints.clear();
+        for (auto&& test : m_processor->GetData()) {
+          auto data = test.data;
+          for (size_t i = 0; i < data->Size(); ++i) {
+            m_voltagePoints.emplace_back(
+                data->Voltage(i) -
+                    m_ffGains.Ks.to<double>() * data->Intercept(i) -
+                    m_ffGains.Ka.to<double>() * data->Acceleration(i),
+                data->Velocity(i));
+          }
         }
+        m_voltagePointsValid = true;
+      }
 
+      if (ImPlot::BeginPlot("Voltage-Domain Plots")) {
         ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 1,
                                    ImVec4(0, 1, 0, 0.5f), IMPLOT_AUTO);
-        ImPlot::PlotScatter("Velocity-Portion Voltage", points.data(),
-                            points.size());
+        ImPlot::PlotScatter("Velocity-Portion Voltage", m_voltagePoints.data(),
+                            m_voltagePoints.size());
         ImPlot::EndPlot();
       }
 
@@ -89,15 +204,66 @@ void Analyzer::Initialize() {
     }
 
     showGain(reinterpret_cast<double*>(&m_ffGains.Ka), "Ka");
+    ImGui::SameLine(width / 2);
+    if (ImGui::Button("Time-Domain Plots") && m_processor) {
+      m_timeFit = true;
+      ImGui::OpenPopup("Time-Domain Plots");
+    }
+    DisplayTimeDomainPlots();
     showGain(&m_ffGains.CoD, "R-Squared");
+    ImGui::SameLine(width / 2);
+    if (ImGui::Button("Fit Diagnostics") && m_processor)
+      ImGui::OpenPopup("Fit Diagnostics");
+    DisplayDiagnostics();
+
+    // Display the track width estimated from the gyro for drivetrains.
+    if (drivetrain) {
+      double trackWidth = m_processor->GetTrackWidth().to<double>();
+      if (std::isnan(trackWidth)) {
+        ImGui::Text("Track Width (m) unavailable");
+      } else {
+        showGain(&trackWidth, "Track Width (m)");
+      }
+    }
 
     ImGui::Separator();
     ImGui::Spacing();
     ImGui::Text("Feedback Gains");
 
+    // The latency of the measurements defaults to the one that the Logger
+    // measured, if it did.
+    double latency = m_preset.latency.to<double>() * 1E3;
+    ImGui::SetNextItemWidth(width / 8);
+    if (ImGui::InputDouble("Latency (ms)", &latency, 0, 0, "%.2f",
+                           ImGuiInputTextFlags_EnterReturnsTrue)) {
+      m_preset.latency = units::millisecond_t(std::max(latency, 0.0));
+      UpdateGains();
+      InvalidateBootstrap();
+    }
+    if (m_processor && m_processor->GetMeasuredLatency()) {
+      ImGui::SameLine();
+      ImGui::TextDisabled("(measured %.2f ms)",
+                          m_processor->GetMeasuredLatency()->to<double>() *
+                              1E3);
+    }
+
     // Display feedback gains.
     showGain(&m_fbGains.Kp, "Kp");
+    ImGui::SameLine(width / 2);
+    if (ImGui::Button("Controller Presets"))
+      ImGui::OpenPopup("Controller Presets");
+    DisplayPresets();
     showGain(&m_fbGains.Kd, "Kd");
+
+    // Add a button to sweep the LQR parameters.
+    ImGui::SameLine(width / 2);
+    if (ImGui::Button("LQR Sweep")) {
+      ImPlot::FitNextPlotAxes();
+      ImGui::OpenPopup("LQR Sweep");
+    }
+    DisplaySweep();
+
+    DisplayBootstrap();
   });
 
   window->DisableRenamePopup();
@@ -119,12 +285,762 @@ void Analyzer::OpenData() {
         m_modifiedLocation.replace(index, len, trailingSlash ? "~/" : "~");
     }
 
+    m_run = 0;
+    LoadData();
+    m_fileOpener.reset();
+  }
+}
+
+void Analyzer::LoadData() {
+  CancelDiagnostics();
+  m_diagnostics.clear();
+  m_processor.reset();
+  m_watcher.reset();
+  InvalidateBootstrap();
+  m_driftValid = false;
+  m_voltagePointsValid = false;
+  m_archiveStatus.clear();
+
+  m_loadError.clear();
+
+  // Files that are not valid data (or archives that fail their checksums)
+  // are reported in the window instead of closing the application.
+  try {
+    // List the runs if this is a run archive. Only the index is read here.
+    m_runNames.clear();
+    if (IsRunArchive(m_fileLocation)) {
+      for (auto&& run : RunArchive(m_fileLocation).GetRuns())
+        m_runNames.push_back(run.robot + " | " + run.date + " | " +
+                             run.mechanism);
+      if (m_run >= static_cast<int>(m_runNames.size())) m_run = 0;
+    }
+
+    m_processor = std::make_unique<DataProcessor>(
+        &m_fileLocation, &m_ffGains, &m_fbGains, &m_preset, &m_params,
+        &m_dataType, m_compactStorage, m_run,
+        m_smoothing ? m_smoothingBandwidth : 0.0, m_resample, m_optimizeTrim);
+  } catch (const std::exception& e) {
+    m_runNames.clear();
     m_processor.reset();
-    m_processor =
-        std::make_unique<DataProcessor>(&m_fileLocation, &m_ffGains, &m_fbGains,
-                                        &m_preset, &m_params, &m_dataType);
-    m_processor->Update();
+    m_loadError = "Could not load " + m_modifiedLocation + ": " + e.what();
+    return;
+  }
 
-    m_fileOpener.reset();
+  if (auto latency = m_processor->GetMeasuredLatency())
+    m_preset.latency = *latency;
+  UpdateGains();
+  UpdateTimeSeries();
+}
+
+void Analyzer::UpdateGains() {
+  if (m_processor) m_processor->Update();
+  m_presetGains = CalculatePresetGains(m_ffGains, m_preset, m_params);
+}
+
+void Analyzer::WatchData() {
+  if (!m_watchFile || !m_processor) {
+    m_watcher.reset();
+    return;
+  }
+
+  if (!m_watcher) m_watcher = std::make_unique<FileWatcher>(m_fileLocation);
+  if (m_watcher->Poll() && m_processor->Refresh()) {
+    UpdateGains();
+    UpdateTimeSeries();
+    CancelDiagnostics();
+    m_diagnostics.clear();
+    InvalidateBootstrap();
+    m_driftValid = false;
+    m_voltagePointsValid = false;
+  }
+}
+
+void Analyzer::DisplaySampling() {
+  if (!m_processor) return;
+  auto stats = m_processor->GetSamplingStats();
+  if (stats.period <= 0) return;
+
+  ImGui::Text("Sampling: %.1f Hz, %.2f ms jitter, %zu duplicates, %zu gaps",
+              1 / stats.period, stats.jitter * 1E3, stats.duplicates,
+              stats.gaps);
+  if (stats.gaps > 0) {
+    ImGui::SameLine();
+    ImGui::Text("(longest %.0f ms)", stats.maxGap * 1E3);
+  }
+}
+
+void Analyzer::DisplayTrim() {
+  if (!m_processor || !m_processor->GetTrim()) return;
+  const TrimResult& trim = *m_processor->GetTrim();
+
+  // Show the chosen threshold, and where each step voltage test starts.
+  ImGui::Text("Trim: %.3f threshold, %.4f R-Squared", trim.threshold,
+              trim.rSquared);
+  ImGui::SameLine();
+  if (ImGui::Button("Trim Plots")) {
+    ImPlot::FitNextPlotAxes();
+    ImGui::OpenPopup("Trim Plots");
+  }
+  for (auto&& curve : trim.startCurves) {
+    if (curve.values.empty()) continue;
+    ImGui::Text("%s: starts at sample %zu (%.3f s)", curve.name.c_str(),
+                curve.chosen, curve.values[curve.chosen]);
+  }
+
+  auto size = ImGui::GetIO().DisplaySize;
+  ImGui::SetNextWindowSize(ImVec2(size.x * 0.6f, size.y * 0.7f));
+  if (!ImGui::BeginPopupModal("Trim Plots")) return;
+
+  // Plot the fit of each candidate of each cut point, with the chosen one
+  // marked. Candidates that leave too few samples to fit are left out.
+  if (ImGui::BeginTabBar("Trim")) {
+    ImVec2 plotSize(-1, ImGui::GetContentRegionAvail().y -
+                            ImGui::GetFrameHeightWithSpacing() * 2);
+    auto createTab = [&](const TrimCurve& curve, const char* label) {
+      if (curve.values.empty() || !ImGui::BeginTabItem(curve.name.c_str()))
+        return;
+      if (ImPlot::BeginPlot(curve.name.c_str(), label, "R-Squared",
+                            plotSize)) {
+        m_plotX.clear();
+        m_plotY.clear();
+        for (size_t i = 0; i < curve.values.size(); ++i) {
+          if (!std::isfinite(curve.rSquared[i])) continue;
+          m_plotX.push_back(curve.values[i]);
+          m_plotY.push_back(curve.rSquared[i]);
+        }
+        ImPlot::PlotLine("R-Squared", m_plotX.data(), m_plotY.data(),
+                         m_plotX.size());
+        if (std::isfinite(curve.rSquared[curve.chosen])) {
+          ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 4);
+          ImPlot::PlotScatter("Chosen", &curve.values[curve.chosen],
+                              &curve.rSquared[curve.chosen], 1);
+        }
+        ImPlot::EndPlot();
+      }
+      ImGui::EndTabItem();
+    };
+    createTab(trim.thresholdCurve, "Motion Threshold (units/s)");
+    for (auto&& curve : trim.startCurves) createTab(curve, "Start (s)");
+    ImGui::EndTabBar();
+  }
+
+  if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+  ImGui::EndPopup();
+}
+
+void Analyzer::DisplayArchive() {
+  if (m_archiveJob.valid() && m_archiveJob.wait_for(std::chrono::seconds(0)) ==
+                                  std::future_status::ready)
+    m_archiveStatus = m_archiveJob.get();
+  if (!m_processor) return;
+
+  // Show how well the data compressed if it came from a session archive.
+  // Otherwise, offer to archive the JSON.
+  if (auto& stats = m_processor->GetArchiveStats()) {
+    ImGui::Text("Archive: %.1fx smaller, decoded at %.0f MB/s",
+                stats->CompressionRatio(), stats->DecodeThroughput() / 1E6);
+    return;
+  }
+
+  if (m_archiveJob.valid()) {
+    ImGui::Text("Saving archive...");
+    return;
+  }
+
+  // Reads the opened JSON and writes it to an archive in the background.
+  auto save = [&](std::function<ArchiveStats(const wpi::json&)> write,
+                  std::string path) {
+    m_archiveJob = std::async(
+        std::launch::async,
+        [json = m_fileLocation, write = std::move(write),
+         path = std::move(path)]() -> std::string {
+          std::string status;
+          try {
+            std::error_code ec;
+            wpi::raw_fd_istream input(json, ec);
+            wpi::json data;
+            input >> data;
+
+            auto stats = write(data);
+            wpi::raw_string_ostream os(status);
+            os << "Saved to " << path << " ("
+               << wpi::format("%.1f", stats.CompressionRatio())
+               << "x smaller)";
+            os.flush();
+          } catch (const std::exception& e) {
+            status = std::string("Could not save archive: ") + e.what();
+          }
+          IdleThrottle::Wake();
+          return status;
+        });
+  };
+
+  if (ImGui::Button("Save Archive")) {
+    // Store the archive next to the JSON, with the same name.
+    std::string path = m_fileLocation;
+    if (wpi::StringRef(path).endswith_lower(".json"))
+      path.resize(path.size() - 5);
+    path += kArchiveExtension;
+    save(
+        [path](const wpi::json& data) {
+          return WriteSessionArchive(data, path);
+        },
+        path);
+  }
+
+  // Add the run to the run archive in the same folder as the JSON, under the
+  // given robot name.
+  ImGui::SameLine();
+  if (ImGui::Button("Add to Run Archive")) {
+    std::string path = m_fileLocation;
+    path.resize(path.find_last_of("/\\") + 1);
+    path += std::string("runs") + kRunArchiveExtension;
+    save(
+        [path, robot = m_robotName](const wpi::json& data) {
+          return RunArchive(path).AddRun(data, robot);
+        },
+        path);
+  }
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+  ImGui::InputTextWithHint("##robot", "Robot", &m_robotName);
+
+  if (!m_archiveStatus.empty()) {
+    ImGui::SameLine();
+    ImGui::TextWrapped("%s", m_archiveStatus.c_str());
+  }
+}
+
+void Analyzer::DisplayRuns() {
+  if (m_runNames.empty()) return;
+
+  // The runs can be filtered by any part of their robot, date, and
+  // mechanism.
+  bool changed = false;
+  ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x / 1.5f);
+  if (ImGui::BeginCombo("Run", m_runNames[m_run].c_str())) {
+    m_runFilter.Draw("Filter");
+    for (int i = 0; i < static_cast<int>(m_runNames.size()); ++i) {
+      if (!m_runFilter.PassFilter(m_runNames[i].c_str())) continue;
+      if (ImGui::Selectable(m_runNames[i].c_str(), m_run == i)) {
+        changed = m_run != i;
+        m_run = i;
+      }
+    }
+    ImGui::EndCombo();
+  }
+  if (changed) LoadData();
+}
+
+void Analyzer::UpdateTimeSeries() {
+  // Only one build runs at a time. If the data changes during a build, the
+  // series are built again once it finishes.
+  if (m_timeSeriesStatus.valid()) {
+    m_timeSeriesDirty = true;
+    return;
   }
+  m_timeSeriesDirty = false;
+
+  // The series are built from a snapshot of the data, so the data can keep
+  // loading while they are built.
+  m_timeSeriesStatus = std::async(
+      std::launch::async,
+      [data = m_processor->GetDataset(), dataset = m_dataType] {
+        auto tests = data->GetData(dataset);
+        std::vector<TimeSeries> series(tests.size());
+        ParallelFor(tests.size(), [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            const PreparedData& test = *tests[i].data;
+            std::vector<double> time(test.Size()), voltage(test.Size()),
+                velocity(test.Size()), acceleration(test.Size());
+            for (size_t j = 0; j < test.Size(); ++j) {
+              time[j] = test.Time(j);
+              voltage[j] = test.Voltage(j);
+              velocity[j] = test.Velocity(j);
+              acceleration[j] = test.Acceleration(j);
+            }
+
+            series[i].name = tests[i].name;
+            series[i].voltage = MinMaxPyramid(time, std::move(voltage));
+            series[i].velocity = MinMaxPyramid(time, std::move(velocity));
+            series[i].acceleration =
+                MinMaxPyramid(std::move(time), std::move(acceleration));
+          }
+        });
+        IdleThrottle::Wake();
+        return series;
+      });
+}
+
+void Analyzer::DisplayTimeDomainPlots() {
+  // Pick up the series once they have been built.
+  if (m_timeSeriesStatus.valid() &&
+      m_timeSeriesStatus.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    m_timeSeries = m_timeSeriesStatus.get();
+    m_timeFit = true;
+    if (m_timeSeriesDirty) UpdateTimeSeries();
+  }
+
+  auto size = ImGui::GetIO().DisplaySize;
+  ImGui::SetNextWindowSize(ImVec2(size.x * 0.75f, size.y * 0.9f));
+  if (!ImGui::BeginPopupModal("Time-Domain Plots")) return;
+
+  if (m_timeSeriesStatus.valid()) ImGui::Text("Building plots...");
+
+  // Each plot only draws about two points per pixel, taken from the level of
+  // the pyramid that matches the visible range. Fitting the axes needs all
+  // of the data, so it queries the whole range instead.
+  struct Plot {
+    const char* title;
+    const char* label;
+    MinMaxPyramid TimeSeries::*signal;
+  };
+  static constexpr Plot kPlots[] = {
+      {"Voltage", "Voltage (V)", &TimeSeries::voltage},
+      {"Velocity", "Velocity (m/s)", &TimeSeries::velocity},
+      {"Acceleration", "Acceleration (m/s^2)", &TimeSeries::acceleration}};
+
+  float width = ImGui::GetContentRegionAvail().x;
+  float height = (ImGui::GetContentRegionAvail().y -
+                  ImGui::GetFrameHeightWithSpacing()) /
+                 std::size(kPlots);
+  bool fit = m_timeFit;
+  m_timeFit = false;
+
+  for (auto&& plot : kPlots) {
+    ImPlot::LinkNextPlotLimits(&m_timeRange[0], &m_timeRange[1], nullptr,
+                               nullptr);
+    if (fit) ImPlot::FitNextPlotAxes();
+    if (ImPlot::BeginPlot(plot.title, "Time (s)", plot.label,
+                          ImVec2(-1, height))) {
+      auto limits = ImPlot::GetPlotLimits();
+      for (auto&& series : m_timeSeries) {
+        (series.*plot.signal)
+            .Query(fit ? -INFINITY : limits.X.Min,
+                   fit ? INFINITY : limits.X.Max, 2 * width, &m_plotX,
+                   &m_plotY);
+        ImPlot::PlotLine(series.name.c_str(), m_plotX.data(), m_plotY.data(),
+                         m_plotX.size());
+      }
+
+      // ImPlot fits the axes to the points drawn in the next frame, which
+      // only cover the visible range, so fit them to all of the data instead.
+      if (ImPlot::IsPlotHovered() && ImGui::IsMouseDoubleClicked(0))
+        m_timeFit = true;
+      ImPlot::EndPlot();
+    }
+  }
+
+  if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+  ImGui::EndPopup();
+}
+
+void Analyzer::CancelDiagnostics() {
+  if (m_diagnosticsCancel) *m_diagnosticsCancel = true;
+}
+
+void Analyzer::DisplayDiagnostics() {
+  // Pick up the diagnostics once they have been calculated. Cancelled
+  // results are incomplete, so they are dropped.
+  if (m_diagnosticsStatus.valid() &&
+      m_diagnosticsStatus.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    auto diagnostics = m_diagnosticsStatus.get();
+    if (!*m_diagnosticsCancel) {
+      if (m_diagnostics.size() >= kMaxCachedDiagnostics)
+        m_diagnostics.erase(m_diagnostics.begin());
+      m_diagnostics[m_diagnosticsJob] = std::move(diagnostics);
+    }
+    m_diagnosticsCancel.reset();
+  }
+
+  auto size = ImGui::GetIO().DisplaySize;
+  ImGui::SetNextWindowSize(ImVec2(size.x * 0.6f, size.y * 0.7f));
+  if (!ImGui::BeginPopupModal("Fit Diagnostics")) return;
+
+  // The diagnostics are only calculated while this popup is open, and are
+  // cached for each data set and set of gains.
+  DiagnosticsKey key{m_dataType, m_ffGains.Ks.to<double>(),
+                     m_ffGains.Kv.to<double>(), m_ffGains.Ka.to<double>()};
+  auto cached = m_diagnostics.find(key);
+  if (cached == m_diagnostics.end() && !m_diagnosticsStatus.valid() &&
+      m_processor) {
+    m_diagnosticsJob = key;
+    m_diagnosticsCancel = std::make_shared<std::atomic<bool>>(false);
+    m_diagnosticsStatus = std::async(
+        std::launch::async,
+        [data = m_processor->GetDataset(), dataset = m_dataType,
+         gains = m_ffGains, cancel = m_diagnosticsCancel] {
+          auto diagnostics = std::make_shared<const FitDiagnostics>(
+              CalculateFitDiagnostics(data->GetData(dataset), gains, *cancel));
+          IdleThrottle::Wake();
+          return diagnostics;
+        });
+  }
+
+  if (cached == m_diagnostics.end()) {
+    ImGui::Text("Calculating...");
+  } else {
+    const FitDiagnostics& diagnostics = *cached->second;
+    ImGui::Text("RMS Residual: %.4f V", diagnostics.rms);
+
+    if (ImGui::BeginTabBar("Diagnostics")) {
+      ImVec2 plotSize(-1, ImGui::GetContentRegionAvail().y -
+                              ImGui::GetFrameHeightWithSpacing() * 2);
+
+      if (ImGui::BeginTabItem("Histogram")) {
+        auto& centers = m_plotX;
+        centers.resize(diagnostics.histogram.size());
+        for (size_t i = 0; i < centers.size(); ++i) {
+          centers[i] = diagnostics.histogramMin +
+                       (i + 0.5) * diagnostics.binWidth;
+        }
+        if (ImPlot::BeginPlot("Residual Histogram", "Residual (V)", "Samples",
+                              plotSize)) {
+          ImPlot::PlotBars("Residuals", centers.data(),
+                           diagnostics.histogram.data(), centers.size(),
+                           diagnostics.binWidth);
+          ImPlot::EndPlot();
+        }
+        ImGui::EndTabItem();
+      }
+
+      auto createScatterTab = [&](const char* name, const char* label,
+                                  const std::vector<double>& x) {
+        if (!ImGui::BeginTabItem(name)) return;
+        if (ImPlot::BeginPlot(name, label, "Residual (V)", plotSize)) {
+          ImPlot::SetNextMarkerStyle(ImPlotMarker_Circle, 1,
+                                     ImVec4(0, 1, 0, 0.5f), IMPLOT_AUTO);
+          ImPlot::PlotScatter("Residuals", x.data(),
+                              diagnostics.residual.data(), x.size());
+          ImPlot::EndPlot();
+        }
+        ImGui::EndTabItem();
+      };
+      createScatterTab("Residuals vs. Velocity", "Velocity (m/s)",
+                       diagnostics.velocity);
+      createScatterTab("Residuals vs. Acceleration", "Acceleration (m/s^2)",
+                       diagnostics.acceleration);
+
+      if (ImGui::BeginTabItem("Predicted vs. Measured")) {
+        if (ImPlot::BeginPlot("Predicted vs. Measured", "Time (s)",
+                              "Voltage (V)", plotSize)) {
+          auto limits = ImPlot::GetPlotLimits();
+          float width = ImGui::GetContentRegionAvail().x;
+          for (auto&& test : diagnostics.tests) {
+            for (auto [pyramid, suffix] :
+                 {std::make_pair(&test.measured, " (measured)"),
+                  std::make_pair(&test.predicted, " (predicted)")}) {
+              char label[64];
+              std::snprintf(label, sizeof(label), "%s%s", test.name.c_str(),
+                            suffix);
+              pyramid->Query(limits.X.Min, limits.X.Max, 2 * width, &m_plotX,
+                             &m_plotY);
+              ImPlot::PlotLine(label, m_plotX.data(), m_plotY.data(),
+                               m_plotX.size());
+            }
+          }
+          ImPlot::EndPlot();
+        }
+        ImGui::EndTabItem();
+      }
+      ImGui::EndTabBar();
+    }
+  }
+
+  if (ImGui::Button("Close")) {
+    CancelDiagnostics();
+    ImGui::CloseCurrentPopup();
+  }
+  ImGui::EndPopup();
+}
+
+void Analyzer::DisplayDrift() {
+  if (m_driftStatus.valid() &&
+      m_driftStatus.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready)
+    m_drift = m_driftStatus.get();
+
+  auto size = ImGui::GetIO().DisplaySize;
+  ImGui::SetNextWindowSize(ImVec2(size.x * 0.6f, size.y * 0.7f));
+  if (!ImGui::BeginPopupModal("Gain Drift")) return;
+
+  ImGui::SetNextItemWidth(80);
+  ImGui::InputDouble("Window (s)", &m_driftWindow, 0, 0, "%.2f");
+  if (ImGui::IsItemDeactivatedAfterEdit()) {
+    m_driftWindow = std::max(m_driftWindow, 0.05);
+    m_driftValid = false;
+  }
+  ImGui::SameLine();
+  ImGui::TextDisabled(
+      "(Ks and Kv from quasistatic tests, Ka from dynamic tests)");
+
+  // The drift is recalculated in the background whenever the data, the data
+  // set, the gains, or the window change while this popup is open. This is
+  // a single pass over the data, so it keeps up with edits of the window.
+  if (!m_driftValid && !m_driftStatus.valid() && m_processor) {
+    m_driftValid = true;
+    m_driftStatus = std::async(
+        std::launch::async, [data = m_processor->GetDataset(),
+                             dataset = m_dataType, gains = m_ffGains,
+                             window = m_driftWindow] {
+          auto drift = CalculateGainDrift(*data, dataset, gains, window);
+          IdleThrottle::Wake();
+          return drift;
+        });
+  }
+
+  // Plot each gain against time, with a line for each test that determines
+  // it. Windows with too few samples to fit are left out.
+  ImVec2 plotSize(-1, (ImGui::GetContentRegionAvail().y -
+                       ImGui::GetFrameHeightWithSpacing()) /
+                          3);
+  auto plotGain = [&](const char* name, const char* label,
+                      std::vector<double> GainDrift::Test::*gain) {
+    if (!ImPlot::BeginPlot(name, "Time (s)", label, plotSize)) return;
+    for (auto&& test : m_drift.tests) {
+      const auto& values = test.*gain;
+      m_plotX.clear();
+      m_plotY.clear();
+      for (size_t i = 0; i < values.size(); ++i) {
+        if (!std::isfinite(values[i])) continue;
+        m_plotX.push_back(test.time[i]);
+        m_plotY.push_back(values[i]);
+      }
+      if (!m_plotX.empty())
+        ImPlot::PlotLine(test.name.c_str(), m_plotX.data(), m_plotY.data(),
+                         m_plotX.size());
+    }
+    ImPlot::EndPlot();
+  };
+  plotGain("Ks", "Ks (V)", &GainDrift::Test::Ks);
+  plotGain("Kv", "Kv (V s/unit)", &GainDrift::Test::Kv);
+  plotGain("Ka", "Ka (V s^2/unit)", &GainDrift::Test::Ka);
+
+  if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+  ImGui::EndPopup();
+}
+
+void Analyzer::DisplayPresets() {
+  if (!ImGui::BeginPopupModal("Controller Presets")) return;
+
+  ImGui::TextDisabled("%s loop, %.2f ms latency",
+                      m_preset.velocity ? "Velocity" : "Position",
+                      m_preset.latency.to<double>() * 1E3);
+  ImGui::Columns(5, "presets");
+  ImGui::SetColumnWidth(0, 120);
+  for (const char* header :
+       {"Controller", "Period (ms)", "Output", "Kp", "Kd"}) {
+    ImGui::Text("%s", header);
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+
+  for (size_t i = 0; i < kNumControllerPresets; ++i) {
+    const auto& controller = kControllerPresets[i];
+    ImGui::Text("%s", controller.name);
+    ImGui::NextColumn();
+    ImGui::Text("%.0f", controller.dt.to<double>() * 1E3);
+    ImGui::NextColumn();
+    ImGui::Text("%.4g / V%s", controller.output.to<double>(),
+                controller.normalized ? "" : ", per loop");
+    ImGui::NextColumn();
+    ImGui::Text("%.4g", m_presetGains[i].Kp);
+    ImGui::NextColumn();
+    ImGui::Text("%.4g", m_presetGains[i].Kd);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
+
+  if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+  ImGui::EndPopup();
+}
+
+void Analyzer::DisplaySweep() {
+  if (!ImGui::BeginPopupModal("LQR Sweep")) return;
+
+  // Create inputs for the parameter and range of each axis. The parameter
+  // of the other axis cannot be chosen, since sweeping the same parameter
+  // along both axes would only vary it along the last one.
+  auto createAxisInputs = [](const char* name, SweepAxis* axis,
+                             const SweepAxis& other) {
+    ImGui::PushID(name);
+    ImGui::Text("%s", name);
+    ImGui::SameLine(60);
+    ImGui::SetNextItemWidth(120);
+    if (ImGui::BeginCombo("##parameter",
+                          SweepAxis::kParameters[axis->parameter])) {
+      for (int i = 0; i < IM_ARRAYSIZE(SweepAxis::kParameters); ++i) {
+        if (ImGui::Selectable(SweepAxis::kParameters[i], i == axis->parameter,
+                              i == other.parameter
+                                  ? ImGuiSelectableFlags_Disabled
+                                  : 0))
+          axis->parameter = i;
+      }
+      ImGui::EndCombo();
+    }
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(60);
+    ImGui::InputDouble("Min", &axis->min);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(60);
+    ImGui::InputDouble("Max", &axis->max);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(60);
+    ImGui::InputInt("Steps", &axis->steps, 0);
+    axis->steps = std::max(axis->steps, 1);
+    ImGui::PopID();
+  };
+
+  createAxisInputs("X Axis", &m_sweepX, m_sweepY);
+  createAxisInputs("Y Axis", &m_sweepY, m_sweepX);
+
+  // Run the sweep in the background with the current gains and settings.
+  if (!m_sweepStatus.valid()) {
+    if (ImGui::Button("Run")) {
+      m_sweepStatus = std::async(
+          std::launch::async, [ff = m_ffGains, preset = m_preset,
+                               params = m_params, x = m_sweepX, y = m_sweepY] {
+            auto start = std::chrono::steady_clock::now();
+            auto result = SweepFeedbackGains(ff, preset, params, x, y);
+            std::chrono::duration<double> duration =
+                std::chrono::steady_clock::now() - start;
+            IdleThrottle::Wake();
+            return std::make_pair(std::move(result), duration.count());
+          });
+    }
+  } else if (m_sweepStatus.wait_for(std::chrono::seconds(0)) !=
+             std::future_status::ready) {
+    ImGui::Button("Running...");
+  } else {
+    std::tie(m_sweep, m_sweepDuration) = m_sweepStatus.get();
+
+    // Flip the rows so that the smallest y value is at the bottom.
+    int rows = m_sweep.y.steps;
+    int cols = m_sweep.x.steps;
+    const std::vector<double>* grids[] = {&m_sweep.Kp, &m_sweep.Kd};
+    for (int i = 0; i < 2; ++i) {
+      m_sweepHeatmaps[i].resize(grids[i]->size());
+      for (int row = 0; row < rows; ++row) {
+        std::copy_n(grids[i]->begin() + static_cast<size_t>(row) * cols, cols,
+                    m_sweepHeatmaps[i].begin() +
+                        static_cast<size_t>(rows - 1 - row) * cols);
+      }
+    }
+    ImPlot::FitNextPlotAxes();
+  }
+
+  ImGui::SameLine();
+  ImGui::RadioButton("Kp", &m_sweepGain, 0);
+  ImGui::SameLine();
+  ImGui::RadioButton("Kd", &m_sweepGain, 1);
+
+  // Show the gains as a heatmap along with their color scale.
+  auto& heatmap = m_sweepHeatmaps[m_sweepGain];
+  if (!heatmap.empty()) {
+    ImGui::SameLine();
+    ImGui::Text("%zu points in %.1f ms", heatmap.size(),
+                m_sweepDuration * 1000);
+
+    auto [min, max] = std::minmax_element(heatmap.begin(), heatmap.end());
+    if (ImPlot::BeginPlot(
+            "##sweep", SweepAxis::kParameters[m_sweep.x.parameter],
+            SweepAxis::kParameters[m_sweep.y.parameter], ImVec2(-80, 0))) {
+      ImPlot::PlotHeatmap(m_sweepGain == 0 ? "Kp" : "Kd", heatmap.data(),
+                          m_sweep.y.steps, m_sweep.x.steps, *min, *max,
+                          nullptr, ImPlotPoint(m_sweep.x.min, m_sweep.y.min),
+                          ImPlotPoint(m_sweep.x.max, m_sweep.y.max));
+      ImPlot::EndPlot();
+    }
+    ImGui::SameLine();
+    ImPlot::ShowColormapScale(*min, *max, ImGui::GetItemRectSize().y);
+
+    // Export the grid to a CSV file.
+    if (ImGui::Button("Export CSV")) {
+      m_sweepSaver = std::make_unique<pfd::save_file>(
+          "Save Sweep", "sweep.csv",
+          std::vector<std::string>{"CSV Files", "*.csv"});
+    }
+    ImGui::SameLine();
+  }
+
+  if (m_sweepSaver && m_sweepSaver->ready(0)) {
+    auto path = m_sweepSaver->result();
+    if (!path.empty()) {
+      try {
+        ExportSweep(m_sweep, path);
+        m_sweepExportStatus = "Saved " + path;
+      } catch (const std::exception& e) {
+        m_sweepExportStatus = e.what();
+      }
+    }
+    m_sweepSaver.reset();
+  }
+  if (!m_sweepExportStatus.empty())
+    ImGui::TextWrapped("%s", m_sweepExportStatus.c_str());
+
+  if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+  ImGui::EndPopup();
+}
+
+void Analyzer::InvalidateBootstrap() {
+  m_bootstrapValid = false;
+  ++m_bootstrapGeneration;
+}
+
+void Analyzer::DisplayBootstrap() {
+  ImGui::Separator();
+  ImGui::Spacing();
+  ImGui::Text("Confidence Intervals (95%%)");
+
+  float width = ImGui::GetContentRegionAvail().x;
+  ImGui::SetNextItemWidth(width / 6);
+  ImGui::InputInt("Replicates", &m_bootstrapReplicates, 0);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(width / 6);
+  ImGui::InputInt("Seed", &m_bootstrapSeed, 0);
+  m_bootstrapReplicates = std::max(m_bootstrapReplicates, 1);
+
+  // Run the bootstrap in the background on a snapshot of the current data
+  // set.
+  ImGui::SameLine();
+  if (!m_bootstrapStatus.valid()) {
+    if (ImGui::Button("Bootstrap") && m_processor) {
+      m_bootstrapJobGeneration = m_bootstrapGeneration;
+      m_bootstrapStatus = std::async(
+          std::launch::async,
+          [data = m_processor->GetDataset(), dataset = m_dataType,
+           preset = m_preset, params = m_params,
+           replicates = m_bootstrapReplicates,
+           seed = static_cast<uint64_t>(m_bootstrapSeed)] {
+            auto result = BootstrapGains(data->GetData(dataset), preset,
+                                         params, replicates, seed);
+            IdleThrottle::Wake();
+            return result;
+          });
+    }
+  } else if (m_bootstrapStatus.wait_for(std::chrono::seconds(0)) !=
+             std::future_status::ready) {
+    ImGui::Button("Running...");
+  } else {
+    // The result is only shown if the data and the parameters are still
+    // the ones that it was calculated for.
+    m_bootstrap = m_bootstrapStatus.get();
+    m_bootstrapValid = m_bootstrapJobGeneration == m_bootstrapGeneration;
+  }
+
+  if (!m_bootstrapValid) return;
+
+  auto showInterval = [&](const char* name, const GainInterval& interval) {
+    ImGui::Text("%s", name);
+    ImGui::SameLine(width / 8);
+    ImGui::Text("[%2.3f, %2.3f]", interval.lower, interval.upper);
+  };
+
+  showInterval("Ks", m_bootstrap.Ks);
+  showInterval("Kv", m_bootstrap.Kv);
+  showInterval("Ka", m_bootstrap.Ka);
+  showInterval("Kp", m_bootstrap.Kp);
+  showInterval("Kd", m_bootstrap.Kd);
 }
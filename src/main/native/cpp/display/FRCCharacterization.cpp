@@ -5,7 +5,9 @@
 #include <wpigui.h>
 
 #include "display/Analyzer.h"
+#include "display/FrameAudit.h"
 #include "display/Generator.h"
+#include "display/IdleThrottle.h"
 #include "display/Logger.h"
 
 using namespace frcchar;
@@ -25,9 +27,11 @@ void FRCCharacterization::GlobalInit() {
 
   // Add all of our widgets.
   wpi::gui::AddInit([] {
+    IdleThrottle::Initialize();
     LoggerGUI->Initialize();
     AnalyzerGUI->Initialize();
     GeneratorGUI->Initialize();
+    FrameAudit::Initialize();
   });
 
   // Add the main menu bar.
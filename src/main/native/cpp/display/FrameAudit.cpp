@@ -0,0 +1,164 @@
+// MIT License
+
+#include "display/FrameAudit.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <imgui.h>
+
+#include "backend/AllocationCounter.h"
+#include "display/FRCCharacterization.h"
+
+using namespace frcchar;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// How long the measurements are averaged over before they are shown.
+constexpr std::chrono::seconds kPeriod{1};
+
+// The fraction of frames that a window may allocate in before it is
+// highlighted. Occasional allocations come from clicks and finished jobs.
+constexpr double kAllocatingThreshold = 0.5;
+
+/**
+ * Returns the CPU time used by the calling thread in seconds. Where there is
+ * no per-thread CPU clock, the wall-clock time is returned instead, which is
+ * close to it because the display functions never block.
+ */
+double GetThreadTime() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0)
+    return time.tv_sec + time.tv_nsec * 1E-9;
+#endif
+  return std::chrono::duration<double>(Clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * The measurements of a single window. They are accumulated over each period
+ * and then averaged per frame.
+ */
+struct WindowStats {
+  const char* name;
+
+  // The number of frames that the window has been displayed in, and the
+  // allocations of the last one.
+  size_t totalFrames = 0;
+  AllocationCount lastAllocations;
+
+  // The totals of the current period.
+  Clock::time_point start;
+  int frames = 0;
+  int allocatingFrames = 0;
+  AllocationCount allocations;
+  double time = 0.0;
+  double maxTime = 0.0;
+
+  // The averages and extremes of the last period.
+  double frameAllocations = 0.0;
+  double frameBytes = 0.0;
+  double frameTime = 0.0;
+  double peakTime = 0.0;
+  double allocatingFraction = 0.0;
+
+  /**
+   * Adds the measurements of a single frame.
+   */
+  void Add(const AllocationCount& count, double duration,
+           Clock::time_point now) {
+    ++totalFrames;
+    lastAllocations = count;
+    ++frames;
+    if (count.allocations > 0) ++allocatingFrames;
+    allocations.allocations += count.allocations;
+    allocations.bytes += count.bytes;
+    time += duration;
+    maxTime = std::max(maxTime, duration);
+    if (now - start < kPeriod) return;
+
+    frameAllocations = static_cast<double>(allocations.allocations) / frames;
+    frameBytes = static_cast<double>(allocations.bytes) / frames;
+    frameTime = time / frames;
+    peakTime = maxTime;
+    allocatingFraction = static_cast<double>(allocatingFrames) / frames;
+
+    start = now;
+    frames = 0;
+    allocatingFrames = 0;
+    allocations = {};
+    time = 0.0;
+    maxTime = 0.0;
+  }
+};
+
+// The windows are only added and measured on the GUI thread.
+std::vector<std::unique_ptr<WindowStats>> gWindows;
+}  // namespace
+
+void FrameAudit::Initialize() {
+  auto window = FRCCharacterization::Manager.AddWindow("Frame Audit", [] {
+    ImGui::TextDisabled("Per frame, averaged over the last second");
+    ImGui::Columns(5, "audit");
+    for (const char* header :
+         {"Window", "Allocations", "Bytes", "CPU (ms)", "Peak (ms)"}) {
+      ImGui::Text("%s", header);
+      ImGui::NextColumn();
+    }
+    ImGui::Separator();
+
+    for (auto&& stats : gWindows) {
+      if (stats->allocatingFraction > kAllocatingThreshold)
+        ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", stats->name);
+      else
+        ImGui::Text("%s", stats->name);
+      ImGui::NextColumn();
+      ImGui::Text("%.1f", stats->frameAllocations);
+      ImGui::NextColumn();
+      ImGui::Text("%.0f", stats->frameBytes);
+      ImGui::NextColumn();
+      ImGui::Text("%.3f", stats->frameTime * 1000);
+      ImGui::NextColumn();
+      ImGui::Text("%.3f", stats->peakTime * 1000);
+      ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+  });
+
+  window->DisableRenamePopup();
+  window->SetVisible(false);
+  window->SetDefaultPos(912, 530);
+  window->SetDefaultSize(342, 150);
+}
+
+glass::Window* FrameAudit::AddWindow(const char* name,
+                                     std::function<void()> display) {
+  gWindows.push_back(std::make_unique<WindowStats>());
+  WindowStats* stats = gWindows.back().get();
+  stats->name = name;
+  stats->start = Clock::now();
+
+  auto measured = [stats, display = std::move(display)] {
+    auto allocations = GetThreadAllocations();
+    double start = GetThreadTime();
+    display();
+    double end = GetThreadTime();
+
+    stats->Add(GetThreadAllocations() - allocations, end - start,
+               Clock::now());
+  };
+  return FRCCharacterization::Manager.AddWindow(name, std::move(measured));
+}
+
+void FrameAudit::ForEachWindow(
+    const std::function<void(const char* name, size_t frames,
+                             const AllocationCount& allocations)>& func) {
+  for (auto&& stats : gWindows)
+    func(stats->name, stats->totalFrames, stats->lastAllocations);
+}
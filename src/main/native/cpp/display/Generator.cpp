@@ -2,6 +2,7 @@
 
 #include "display/Generator.h"
 
+#include <cstdio>
 #include <cstdlib>
 
 #include <glass/Context.h>
@@ -10,8 +11,12 @@
 #include <imgui_stdlib.h>
 #include <wpi/raw_ostream.h>
 
+#include "backend/FeedbackGains.h"
 #include "backend/ProjectCreator.h"
 #include "display/FRCCharacterization.h"
+#include "display/FrameAudit.h"
+#include "display/IdleThrottle.h"
+#include "display/ScaledFont.h"
 
 using namespace frcchar;
 
@@ -19,9 +24,6 @@ const char* Generator::kProjectTypes[] = {"Drivetrain", "Arm", "Elevator",
                                           "Simple"};
 const char* Generator::kGyros[] = {"NavX", "Pigeon", "ADXRS450", "AnalogGyro",
                                    "None"};
-const char* Generator::kMotorControllers[] = {
-    "Spark",        "Victor",        "VictorSP",    "PWMTalonSRX",
-    "WPI_TalonSRX", "WPI_VictorSPX", "WPI_TalonFX", "CANSparkMax"};
 
 void Generator::Initialize() {
   // Initialize the team number to the storage value.
@@ -30,7 +32,7 @@ void Generator::Initialize() {
                                                *m_teamNumber);
 
   // Add a new window to the GUI.
-  auto window = FRCCharacterization::Manager.AddWindow("Generator", [&] {
+  auto window = FrameAudit::AddWindow("Generator", [&] {
     // Get the current width of the window. This will be used to scale the
     // UI elements.
     int width = ImGui::GetContentRegionAvail().x;
@@ -67,8 +69,15 @@ void Generator::Initialize() {
 
     // Add motor controller input.
     ImGui::SetNextItemWidth(width / 2.5);
-    ImGui::Combo("Motor Controller", &m_motorController, kMotorControllers,
-                 IM_ARRAYSIZE(kMotorControllers));
+    // The motor controllers are the ones of the Analyzer's controller
+    // presets, so that the two lists cannot get out of sync.
+    ImGui::Combo(
+        "Motor Controller", &m_motorController,
+        [](void*, int i, const char** name) {
+          *name = kControllerPresets[i].name;
+          return true;
+        },
+        nullptr, static_cast<int>(kNumControllerPresets));
     createHelperMarker(
         "This represents the physical motor controller that is connected "
         "to "
@@ -88,24 +97,30 @@ void Generator::Initialize() {
         m_rightMotorPorts.emplace_back(1);
       }
 
+      // Format the labels of the ports on the stack so that they are not
+      // allocated on every frame.
+      char port[32];
+      char label[40];
+      if (i == 0)
+        std::snprintf(port, sizeof(port), "Leader");
+      else
+        std::snprintf(port, sizeof(port), "Follower %zu", i);
+
       // Create input field for motor ports (left for drivetrain.).
+      if (m_projectType == 0)
+        std::snprintf(label, sizeof(label), "L##%zu", i);
+      else
+        std::snprintf(label, sizeof(label), "%s", port);
       ImGui::SetNextItemWidth(width / 8);
-      ImGui::InputInt(
-          m_projectType == 0
-              ? ("L##" + std::to_string(i)).c_str()
-              : (i == 0 ? "Leader" : ("Follower " + std::to_string(i)).c_str()),
-          &m_leftMotorPorts[i], 0);
+      ImGui::InputInt(label, &m_leftMotorPorts[i], 0);
 
       // Create input fields for right motor ports if we have drivetrain
       // selected.
       if (m_projectType == 0) {
         ImGui::SameLine();
         ImGui::SetNextItemWidth(width / 8);
-        ImGui::InputInt(
-            (std::string("R ") +
-             (i == 0 ? "Leader" : ("Follower " + std::to_string(i))))
-                .c_str(),
-            &m_rightMotorPorts[i], 0);
+        std::snprintf(label, sizeof(label), "R %s", port);
+        ImGui::InputInt(label, &m_rightMotorPorts[i], 0);
       }
 
       // Add minus button to remove extra ports.
@@ -208,14 +223,13 @@ void Generator::Initialize() {
     ImGui::SetNextItemWidth(width * 0.5);
 
     // Scale the font size down to fit more of the path.
-    ImFont f = *ImGui::GetFont();
-    f.Scale *= 0.85;
-    ImGui::PushFont(&f);
-
-    ImGui::InputText("##labelb", const_cast<char*>(m_modifiedLocation.c_str()),
-                     m_modifiedLocation.capacity() + 1,
-                     ImGuiInputTextFlags_ReadOnly);
-    ImGui::PopFont();
+    {
+      ScaledFont font(0.85f);
+      ImGui::InputText("##labelb",
+                       const_cast<char*>(m_modifiedLocation.c_str()),
+                       m_modifiedLocation.capacity() + 1,
+                       ImGuiInputTextFlags_ReadOnly);
+    }
     ImGui::SameLine();
 
     if (ImGui::Button("Choose..")) {
@@ -254,9 +268,10 @@ void Generator::Initialize() {
     if (ImGui::BeginPopupModal("Deploy Status...")) {
       ImGui::Text("GradleRIO Output");
 
-      ImGui::PushFont(&f);
-      ImGui::Text("%s", m_deployOutput.c_str());
-      ImGui::PopFont();
+      {
+        ScaledFont font(0.85f);
+        ImGui::Text("%s", m_deployOutput.c_str());
+      }
 
       ImGui::Separator();
       ImGui::Spacing();
@@ -289,14 +304,16 @@ void Generator::SelectProjectLocation() {
 }
 
 void Generator::GenerateProject() {
-  m_generationStatus =
-      std::async(std::launch::async, [&] { m_creator->CreateProject(); });
+  m_generationStatus = std::async(std::launch::async, [&] {
+    m_creator->CreateProject();
+    IdleThrottle::Wake();
+  });
 }
 
 void Generator::DeployProject() {
   m_deployStatus = std::async(std::launch::async, [&] {
     m_deployOutput = "";
-    m_creator->DeployProject(&m_deployOutput);
+    m_creator->DeployProject(&m_deployOutput, [] { IdleThrottle::Wake(); });
   });
 }
 
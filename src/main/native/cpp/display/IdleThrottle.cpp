@@ -0,0 +1,190 @@
+// MIT License
+
+#include "display/IdleThrottle.h"
+
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+
+#include <imgui.h>
+#include <imgui_impl_glfw.h>
+#include <wpigui.h>
+
+using namespace frcchar;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// How long the GUI has to be inactive before it becomes idle.
+constexpr std::chrono::seconds kIdleDelay{1};
+
+// The longest time between two frames while the GUI is idle.
+constexpr double kIdlePeriod = 0.25;
+
+// The most key releases that are held back from Dear ImGui during a wait.
+constexpr size_t kMaxHeldReleases = 16;
+
+/**
+ * A key event, as it is passed to GLFW key callbacks.
+ */
+struct KeyEvent {
+  int key;
+  int scancode;
+  int mods;
+};
+
+std::atomic<bool> gInitialized{false};
+std::atomic<bool> gWoken{false};
+bool gKeepAwake = false;
+bool gEnabled = true;
+bool gIdle = false;
+Clock::time_point gLastActivity;
+
+// The key callback that was installed before the throttle's (the one of Dear
+// ImGui), and the key releases that are held back from it.
+GLFWkeyfun gNextKeyCallback = nullptr;
+bool gWaiting = false;
+std::array<KeyEvent, kMaxHeldReleases> gHeldReleases;
+size_t gHeldReleaseCount = 0;
+
+// Frame time and CPU usage, which are updated once per second.
+Clock::time_point gWindowStart;
+std::clock_t gWindowCpuStart;
+int gWindowFrames = 0;
+double gFrameTime = 0.0;
+double gCpuUsage = 0.0;
+
+/**
+ * Returns whether there was any user input since the last frame.
+ */
+bool HasInput() {
+  auto& io = ImGui::GetIO();
+  if (io.MouseDelta.x != 0 || io.MouseDelta.y != 0 || io.MouseWheel != 0 ||
+      io.MouseWheelH != 0 || io.InputQueueCharacters.Size > 0)
+    return true;
+  for (bool down : io.MouseDown) {
+    if (down) return true;
+  }
+  for (bool down : io.KeysDown) {
+    if (down) return true;
+  }
+  return false;
+}
+
+/**
+ * Passes key events on to Dear ImGui. A key that is pressed and released
+ * while waiting would be up again before the frame, so the releases during a
+ * wait are held back until the next frame, which sees the key as pressed.
+ */
+void KeyCallback(GLFWwindow* window, int key, int scancode, int action,
+                 int mods) {
+  if (gWaiting && action == GLFW_RELEASE &&
+      gHeldReleaseCount < kMaxHeldReleases) {
+    gHeldReleases[gHeldReleaseCount++] = {key, scancode, mods};
+    return;
+  }
+  if (gNextKeyCallback) gNextKeyCallback(window, key, scancode, action, mods);
+}
+
+/**
+ * Waits for the next event, or until the idle period is over, and starts the
+ * frame again so that it includes the input that arrived while waiting. The
+ * wait happens after the frame has started, and ending a frame discards the
+ * mouse wheel and text input of it, so those are carried over.
+ */
+void WaitForEvents() {
+  gWaiting = true;
+  glfwWaitEventsTimeout(kIdlePeriod);
+  gWaiting = false;
+
+  // The text input is copied into a buffer that is kept, so that restarting
+  // the frame does not allocate once the buffer is large enough.
+  static ImVector<ImWchar> characters;
+  auto& io = ImGui::GetIO();
+  float wheel = io.MouseWheel;
+  float wheelH = io.MouseWheelH;
+  characters.resize(0);
+  for (ImWchar character : io.InputQueueCharacters)
+    characters.push_back(character);
+
+  ImGui::EndFrame();
+  io.MouseWheel = wheel;
+  io.MouseWheelH = wheelH;
+  for (ImWchar character : characters)
+    io.InputQueueCharacters.push_back(character);
+  ImGui_ImplGlfw_NewFrame();
+  ImGui::NewFrame();
+}
+
+/**
+ * Updates the frame time and CPU usage of the last second.
+ */
+void UpdateStats(Clock::time_point now) {
+  ++gWindowFrames;
+  std::chrono::duration<double> elapsed = now - gWindowStart;
+  if (elapsed.count() < 1.0) return;
+
+  std::clock_t cpu = std::clock();
+  gFrameTime = elapsed.count() / gWindowFrames;
+  gCpuUsage = static_cast<double>(cpu - gWindowCpuStart) / CLOCKS_PER_SEC /
+              elapsed.count();
+  gWindowStart = now;
+  gWindowCpuStart = cpu;
+  gWindowFrames = 0;
+}
+}  // namespace
+
+void IdleThrottle::Initialize() {
+  gLastActivity = gWindowStart = Clock::now();
+  gWindowCpuStart = std::clock();
+  gInitialized = true;
+  gNextKeyCallback =
+      glfwSetKeyCallback(wpi::gui::GetSystemWindow(), KeyCallback);
+
+  wpi::gui::AddEarlyExecute([] {
+    // Release the keys that were released during the last wait.
+    for (size_t i = 0; i < gHeldReleaseCount; ++i) {
+      auto& event = gHeldReleases[i];
+      if (gNextKeyCallback) {
+        gNextKeyCallback(wpi::gui::GetSystemWindow(), event.key,
+                         event.scancode, GLFW_RELEASE, event.mods);
+      }
+    }
+    gHeldReleaseCount = 0;
+
+    auto now = Clock::now();
+    UpdateStats(now);
+
+    if (HasInput() || gWoken.exchange(false) || gKeepAwake || !gEnabled)
+      gLastActivity = now;
+    gKeepAwake = false;
+
+    // Wait for the next event before drawing the frame. The frame is started
+    // again after waiting, so the input that woke the GUI up is part of it.
+    gIdle = now - gLastActivity > kIdleDelay;
+    if (gIdle) {
+      WaitForEvents();
+      if (HasInput()) gLastActivity = Clock::now();
+    }
+  });
+}
+
+void IdleThrottle::Wake() {
+  gWoken = true;
+  if (gInitialized) glfwPostEmptyEvent();
+}
+
+void IdleThrottle::KeepAwake() { gKeepAwake = true; }
+
+void IdleThrottle::DisplayMenu() {
+  if (ImGui::BeginMenu("Performance")) {
+    ImGui::MenuItem("Idle Throttling", nullptr, &gEnabled);
+    ImGui::EndMenu();
+  }
+  ImGui::Text("%.1f ms/frame, %.0f%% CPU%s", gFrameTime * 1000,
+              gCpuUsage * 100, gIdle ? " (idle)" : "");
+}
@@ -2,65 +2,46 @@
 
 #include "display/Logger.h"
 
-#include <array>
-#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <future>
-#include <iostream>
-#include <thread>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 #include <glass/Context.h>
 #include <imgui.h>
-#include <networktables/NetworkTableInstance.h>
-#include <wpi/raw_ostream.h>
 #include <wpigui.h>
 
 #include "display/FRCCharacterization.h"
+#include "display/FrameAudit.h"
+#include "display/IdleThrottle.h"
+#include "display/ScaledFont.h"
 
 using namespace frcchar;
 
 void Logger::Initialize() {
-  // Add an NT connection listener used to update the NetworkTables state.
-  auto inst = nt::GetDefaultInstance();
-  auto poller = nt::CreateConnectionListenerPoller(inst);
-  nt::AddPolledConnectionListener(poller, true);
-  wpi::gui::AddEarlyExecute(
-      [poller, &m_ntConnectionStatus = m_ntConnectionStatus] {
-        bool timedOut;
-        for (auto&& event : nt::PollConnectionListener(poller, 0, &timedOut))
-          m_ntConnectionStatus = event.connected;
-      });
-
   m_teamNumber = glass::GetStorage().GetIntRef("LoggerTeam");
+  AddRobot(*m_teamNumber);
 
   // Add a new window to the GUI.
-  glass::Window* window = FRCCharacterization::Manager.AddWindow("Logger", [&] {
+  glass::Window* window = FrameAudit::AddWindow("Logger", [&] {
+    // The sessions capture telemetry on their own threads, so the GUI only
+    // has to keep drawing while this window shows statistics that change with
+    // every frame.
+    for (auto&& robot : m_robots) {
+      if (robot.session->GetActiveTest() ||
+          robot.session->IsMeasuringLatency())
+        IdleThrottle::KeepAwake();
+    }
+
     // Get the current width of the window. This will be used to scale
     // our UI elements.
     float width = ImGui::GetContentRegionAvail().x;
 
     // Display information about the test type.
-    ImGui::Text("%s", ("Project Type: " + m_projectType).c_str());
-
-    ImGui::SetNextItemWidth(width / 5);
-    ImGui::InputInt("Team Number", m_teamNumber, 0);
-
-    if (ImGui::Button("Apply")) {
-      m_ntNeedsReset = true;
-    }
-
-    ImGui::SameLine();
-    ImGui::Text(m_ntConnectionStatus ? "NT Connected" : "NT Disconnected");
-
-    if (m_ntNeedsReset) {
-      m_ntNeedsReset = false;
-      nt::StopClient(nt::GetDefaultInstance());
-      if (*m_teamNumber == 0) {
-        nt::StartClient(nt::GetDefaultInstance(), "localhost", NT_DEFAULT_PORT);
-      } else {
-        nt::StartClientTeam(nt::GetDefaultInstance(), *m_teamNumber,
-                            NT_DEFAULT_PORT);
-      }
-    }
+    ImGui::Text("Project Type: %s", m_projectType.c_str());
 
     // Create new section for voltage parameters.
     ImGui::Separator();
@@ -80,69 +61,20 @@ void Logger::Initialize() {
     if (m_projectType == "Drivetrain")
       createVoltageParameterInputs("Rotation Voltage (V)", &m_rotationVoltage);
 
-    // Create new section for tests.
-    ImGui::Separator();
-    ImGui::Spacing();
-    ImGui::Text("Tests");
-
-    // Add buttons and text for the tests.
-    auto createTestButtons = [&](const char* name, bool run) {
-      // Display buttons if we have an NT connection.
-      if (m_ntConnectionStatus) {
-        // Create button to run test.
-        if (ImGui::Button(name)) {
-          // Open the warning message.
-          ImGui::OpenPopup("Warning");
-
-          // Store the name of the button that caused the warning.
-          m_openedPopup = name;
-        }
-        // Create modal window.
-        if (m_openedPopup == name && ImGui::BeginPopupModal("Warning")) {
-          // Show warning text.
-          ImGui::Text(
-              "Please enable the robot in autonomous mode, and then "
-              "disable it "
-              "before it runs out of space. \n Note: The robot will "
-              "continue "
-              "to move until you disable it - It is your "
-              "responsibility to "
-              "ensure it does not hit anything!");
-          // Add "Close" button
-          if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
-          ImGui::EndPopup();
-        }
-      } else {
-        // Show disabled text because there is no NT connection.
-        ImGui::TextDisabled("%s", name);
-      }
-
-      // Show whether the tests were run or not.
-      ImGui::SameLine(width * 0.7);
-      ImGui::Text(run ? "Run" : "Not Run");
-    };
-
-    createTestButtons("Quasistatic Forward", false);
-    createTestButtons("Quasistatic Reverse", false);
-    createTestButtons("Dynamic Forward", false);
-    createTestButtons("Dynamic Backward", false);
-    if (m_projectType == "Drivetrain") createTestButtons("Track Width", false);
-
     // Create new section for file saving settings.
     ImGui::Separator();
     ImGui::Spacing();
     ImGui::Text("Save Settings");
 
     // Scale the font size down to fit more of the path.
-    ImFont f = *ImGui::GetFont();
-    f.Scale *= 0.85;
-    ImGui::PushFont(&f);
-
-    ImGui::SetNextItemWidth(width / 1.5);
-    ImGui::InputText("##label", const_cast<char*>(m_modifiedLocation.c_str()),
-                     m_modifiedLocation.capacity() + 1,
-                     ImGuiInputTextFlags_ReadOnly);
-    ImGui::PopFont();
+    {
+      ScaledFont font(0.85f);
+      ImGui::SetNextItemWidth(width / 1.5);
+      ImGui::InputText("##label",
+                       const_cast<char*>(m_modifiedLocation.c_str()),
+                       m_modifiedLocation.capacity() + 1,
+                       ImGuiInputTextFlags_ReadOnly);
+    }
     ImGui::SameLine();
 
     if (ImGui::Button("Choose..."))
@@ -150,8 +82,49 @@ void Logger::Initialize() {
 
     SelectDataFolder();
 
+    ImGui::SetNextItemWidth(width / 5);
+    ImGui::InputDouble("Units Per Rotation", &m_unitsPerRotation, 0, 0, "%.4f");
+
+    // Create new section for the robots, with a tab for each of them.
+    ImGui::Separator();
+    ImGui::Spacing();
+    ImGui::Text("Robots");
     ImGui::SameLine();
-    if (ImGui::Button("Save")) CreateDataFile();
+    if (ImGui::Button("Add Robot")) AddRobot(*m_teamNumber);
+
+    if (ImGui::BeginTabBar("Robots")) {
+      size_t closed = m_robots.size();
+      for (size_t i = 0; i < m_robots.size(); ++i) {
+        auto& robot = m_robots[i];
+
+        // The last robot cannot be closed.
+        bool open = true;
+        if (ImGui::BeginTabItem(robot.label.c_str(),
+                                m_robots.size() > 1 ? &open : nullptr)) {
+          m_selectedRobot = i;
+          ImGui::PushID(robot.id);
+          DisplayRobot(&robot);
+          ImGui::PopID();
+          ImGui::EndTabItem();
+        }
+        if (!open) closed = i;
+      }
+      ImGui::EndTabBar();
+
+      // Closing a tab waits for its data to be saved and then stops its
+      // session, which stops its test. Both have to happen before the erase,
+      // which moves the later tabs into its place and would destroy the
+      // session while the save still uses it.
+      if (closed < m_robots.size()) {
+        auto& robot = m_robots[closed];
+        if (robot.saveJob.valid()) robot.saveJob.wait();
+        robot.session.reset();
+        m_robots.erase(m_robots.begin() + closed);
+        m_selectedRobot = std::min(m_selectedRobot, m_robots.size() - 1);
+      }
+    }
+
+    DisplaySimulation();
   });
 
   window->DisableRenamePopup();
@@ -163,6 +136,138 @@ void Logger::UpdateProjectType(const std::string& type) {
   m_projectType = type;
 }
 
+void Logger::AddRobot(int team) {
+  RobotTab robot;
+  robot.session = std::make_unique<CaptureSession>(IdleThrottle::Wake);
+  robot.id = m_nextRobotId++;
+  robot.team = team;
+  m_robots.push_back(std::move(robot));
+  ConnectRobot(&m_robots.back());
+}
+
+void Logger::ConnectRobot(RobotTab* robot) {
+  robot->name = robot->team != 0 ? "team" + std::to_string(robot->team)
+                                 : "localhost-" + std::to_string(robot->port);
+  robot->label = robot->name + "###" + std::to_string(robot->id);
+  robot->session->Connect(robot->team, robot->port);
+  *m_teamNumber = robot->team;
+}
+
+void Logger::DisplayRobot(RobotTab* robot) {
+  float width = ImGui::GetContentRegionAvail().x;
+  auto status = robot->session->GetStatus();
+
+  // A team number of zero connects to a server on localhost, such as the
+  // simulation or the replay tool, which can run on any port.
+  ImGui::SetNextItemWidth(width / 5);
+  ImGui::InputInt("Team Number", &robot->team, 0);
+  if (robot->team == 0) {
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(width / 5);
+    ImGui::InputInt("Port", &robot->port, 0);
+    robot->port = std::clamp(robot->port, 1, 65535);
+  }
+
+  if (ImGui::Button("Apply")) ConnectRobot(robot);
+
+  ImGui::SameLine();
+  ImGui::Text(status.connected ? "NT Connected" : "NT Disconnected");
+
+  // Display the telemetry throughput, along with the number of samples that
+  // were lost on the way.
+  ImGui::Text("Telemetry: %.0f samples/s, %zu received, %zu dropped "
+              "(%.1f%%)",
+              status.rate, status.received, status.dropped,
+              status.received + status.dropped > 0
+                  ? 100.0 * status.dropped / (status.received + status.dropped)
+                  : 0.0);
+  ImGui::SameLine();
+  if (ImGui::Button("Reset")) robot->session->ResetCapture();
+
+  DisplayLatency(robot, status);
+
+  // Create new section for tests.
+  ImGui::Separator();
+  ImGui::Spacing();
+  ImGui::Text("Tests");
+  DisplayTests(robot, status.connected);
+
+  // Save the data of this robot. The file is written in the background so
+  // that saving a long run does not hold up the GUI.
+  ImGui::Separator();
+  ImGui::Spacing();
+  if (robot->saveJob.valid() &&
+      robot->saveJob.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready)
+    robot->saveStatus = robot->saveJob.get();
+
+  if (robot->saveJob.valid())
+    ImGui::TextDisabled("Saving...");
+  else if (ImGui::Button("Save"))
+    SaveData(robot);
+  if (!robot->saveStatus.empty())
+    ImGui::TextWrapped("%s", robot->saveStatus.c_str());
+}
+
+void Logger::DisplayTests(RobotTab* robot, bool connected) {
+  float width = ImGui::GetContentRegionAvail().x;
+  const auto* activeTest = robot->session->GetActiveTest();
+
+  // Add buttons and text for the tests.
+  auto createTestButtons = [&](const CaptureSession::TestInfo& test) {
+    bool active = activeTest == &test;
+    ImGui::PushID(test.name);
+
+    // Display buttons if we have an NT connection.
+    if (active) {
+      // Create button to stop the running test.
+      if (ImGui::Button("Stop")) robot->session->StopTest();
+    } else if (connected) {
+      // Create button to run test.
+      if (ImGui::Button(test.name)) {
+        // Open the warning message.
+        ImGui::OpenPopup("Warning");
+      }
+      // Create modal window.
+      if (ImGui::BeginPopupModal("Warning")) {
+        // Show warning text.
+        ImGui::Text(
+            "Please enable the robot in autonomous mode, and then "
+            "disable it "
+            "before it runs out of space. \n Note: The robot will "
+            "continue "
+            "to move until you disable it - It is your "
+            "responsibility to "
+            "ensure it does not hit anything!");
+        // Add "Start" and "Close" buttons.
+        if (ImGui::Button("Start")) {
+          robot->session->StartTest(
+              test, {m_quasistaticRampVoltage, m_dynamicStepVoltage,
+                     m_rotationVoltage});
+          ImGui::CloseCurrentPopup();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Close")) ImGui::CloseCurrentPopup();
+        ImGui::EndPopup();
+      }
+    } else {
+      // Show disabled text because there is no NT connection.
+      ImGui::TextDisabled("%s", test.name);
+    }
+
+    // Show whether the tests were run or not.
+    ImGui::SameLine(width * 0.7);
+    ImGui::Text(active ? "Running"
+                       : robot->session->HasData(test.key) ? "Run"
+                                                           : "Not Run");
+    ImGui::PopID();
+  };
+
+  for (auto&& test : CaptureSession::kTests) {
+    if (!test.rotate || m_projectType == "Drivetrain") createTestButtons(test);
+  }
+}
+
 void Logger::SelectDataFolder() {
   if (m_folderSelector && m_folderSelector->ready()) {
     m_fileLocation = m_folderSelector->result();
@@ -181,4 +286,107 @@ void Logger::SelectDataFolder() {
   }
 }
 
-void Logger::CreateDataFile() {}
+void Logger::SaveData(RobotTab* robot) {
+  if (m_fileLocation.empty()) {
+    robot->saveStatus = "Please choose a folder to save the data in.";
+    return;
+  }
+
+  robot->saveJob = std::async(
+      std::launch::async,
+      [session = robot->session.get(), folder = m_fileLocation,
+       name = robot->name, type = m_projectType, factor = m_unitsPerRotation] {
+        auto status = session->WriteDataFile(folder, name, type, factor);
+        IdleThrottle::Wake();
+        return status;
+      });
+}
+
+void Logger::DisplayLatency(RobotTab* robot,
+                            const CaptureSession::Status& status) {
+  auto& session = *robot->session;
+
+  // Only the robot can answer pings.
+  if (status.connected) {
+    if (ImGui::Button(session.IsMeasuringLatency() ? "Stop Measuring Latency"
+                                                   : "Measure Latency"))
+      session.SetMeasuringLatency(!session.IsMeasuringLatency());
+    ImGui::SameLine();
+    if (ImGui::Button("Reset##latency")) session.ResetLatency();
+  } else {
+    session.SetMeasuringLatency(false);
+    ImGui::TextDisabled("Measure Latency");
+  }
+
+  if (status.pingsAnswered == 0) {
+    if (status.pingsSent > 0)
+      ImGui::Text("No answers to %zu pings. Does the robot project support "
+                  "latency measurement?",
+                  status.pingsSent);
+    return;
+  }
+
+  const auto& roundTrip = status.roundTrip;
+  const auto& sensor = status.sensorDelay;
+  ImGui::Text("Round Trip: %.2f ms (sd %.2f, min %.2f), %zu / %zu answered",
+              roundTrip.mean * 1E3, roundTrip.StdDev() * 1E3,
+              roundTrip.min * 1E3, status.pingsAnswered, status.pingsSent);
+  ImGui::Text("Sensor Delay: %.2f ms (sd %.2f), Clock Offset: %.4f s",
+              sensor.mean * 1E3, sensor.StdDev() * 1E3, *status.clockOffset);
+
+  // The delivery delay is measured once the samples are on the host clock.
+  const auto& delivery = status.deliveryDelay;
+  if (delivery.count > 0)
+    ImGui::Text("Telemetry Delay: %.2f ms (sd %.2f, max %.2f)",
+                delivery.mean * 1E3, delivery.StdDev() * 1E3,
+                delivery.max * 1E3);
+}
+
+void Logger::DisplaySimulation() {
+  ImGui::Separator();
+  ImGui::Spacing();
+  if (!ImGui::CollapsingHeader("Simulation")) return;
+
+  float width = ImGui::GetContentRegionAvail().x;
+  auto createParameterInput = [&](const char* name, auto* value,
+                                  double min) {
+    using Unit = std::decay_t<decltype(*value)>;
+    double raw = value->template to<double>();
+    ImGui::SetNextItemWidth(width / 5);
+    ImGui::InputDouble(name, &raw, 0, 0, "%.4f");
+    *value = Unit(std::max(raw, min));
+  };
+
+  createParameterInput("Ks (V)", &m_simulationParams.Ks, 0.0);
+  createParameterInput("Kv (V s/m)", &m_simulationParams.Kv, 1E-3);
+  createParameterInput("Ka (V s^2/m)", &m_simulationParams.Ka, 1E-3);
+  createParameterInput("Velocity Noise (m/s)", &m_simulationParams.noise, 0.0);
+  createParameterInput("Latency (s)", &m_simulationParams.latency, 0.0);
+  createParameterInput("Rate (Hz)", &m_simulationParams.rate, 1.0);
+  m_simulationParams.rate =
+      std::min(m_simulationParams.rate, SimulatedMechanism::kMaxRate);
+  if (m_projectType == "Drivetrain")
+    createParameterInput("Track Width (m)", &m_simulationParams.trackWidth,
+                         1E-3);
+
+  // Starting the simulation connects the selected robot to it. The data is
+  // saved with a factor of one because the simulation reports meters.
+  if (!m_simulation) {
+    if (ImGui::Button("Start Simulation")) {
+      m_simulationParams.drivetrain = m_projectType == "Drivetrain";
+      m_simulation = std::make_unique<SimulatedMechanism>(m_simulationParams);
+      m_unitsPerRotation = 1.0;
+      auto& robot = m_robots[m_selectedRobot];
+      robot.team = 0;
+      robot.port = NT_DEFAULT_PORT;
+      ConnectRobot(&robot);
+    }
+  } else {
+    if (ImGui::Button("Stop Simulation")) m_simulation.reset();
+  }
+
+  if (m_simulation) {
+    ImGui::SameLine();
+    ImGui::Text("%zu samples sent", m_simulation->GetSamples());
+  }
+}
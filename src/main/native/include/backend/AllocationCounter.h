@@ -0,0 +1,56 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+
+namespace frcchar {
+/**
+ * A struct that represents a number of heap allocations and the number of
+ * bytes that they requested.
+ */
+struct AllocationCount {
+  size_t allocations = 0;
+  size_t bytes = 0;
+
+  AllocationCount operator-(const AllocationCount& other) const {
+    return {allocations - other.allocations, bytes - other.bytes};
+  }
+};
+
+/**
+ * Returns the number of heap allocations made by the calling thread so far.
+ * The count of a piece of code is the difference between the counts before
+ * and after it.
+ *
+ * Allocations are only counted in programs that link in the replacement of
+ * the global operator new in AllocationHook.cpp, which costs one
+ * thread-local increment per allocation. The analysis core never replaces
+ * the allocator of the programs that use it, so without the hook all counts
+ * stay at zero.
+ */
+AllocationCount GetThreadAllocations();
+
+/**
+ * Returns the number of heap allocations made by all threads so far.
+ */
+AllocationCount GetTotalAllocations();
+
+/**
+ * Returns whether allocations are being counted, i.e. whether the program
+ * links in the allocation hook.
+ */
+bool IsCountingAllocations();
+
+/**
+ * Marks allocations as counted. The allocation hook calls this before main()
+ * runs.
+ */
+void RegisterAllocationHook();
+
+/**
+ * Adds an allocation of the given size to the counts of the calling thread.
+ * This is called by the allocation hook, and must not allocate itself.
+ */
+void CountAllocation(size_t size);
+}  // namespace frcchar
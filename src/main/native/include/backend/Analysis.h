@@ -0,0 +1,183 @@
+// MIT License
+
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <units/acceleration.h>
+#include <units/base.h>
+#include <units/dimensionless.h>
+#include <units/length.h>
+#include <units/time.h>
+#include <units/velocity.h>
+#include <units/voltage.h>
+#include <wpi/SmallVector.h>
+
+#include "backend/OLS.h"
+#include "backend/PreparedData.h"
+
+namespace units {
+using Kv_t = decltype(1_V / 1_mps);
+using Ka_t = decltype(1_V / 1_mps_sq);
+}  // namespace units
+
+namespace frcchar {
+/**
+ * A struct that represents the feedforward gains produced by the analysis.
+ * This includes the standard Ks, Kv, and Ka, along with a coefficient of
+ * determination for the OLS multiple regression fit.
+ */
+struct FFGains {
+  units::volt_t Ks;
+  units::Kv_t Kv;
+  units::Ka_t Ka;
+  double CoD;
+};
+
+/**
+ * A struct that represents the feedback gains produced by the analysis. This
+ * includes Kp and Kd. Kd will always be zero for a velocity loop type.
+ */
+struct FBGains {
+  double Kp, Kd;
+};
+
+/**
+ * A struct that represents the presets for the feedback gains. These include
+ * whether we want to calculate gains for a velocity loop, the nominal period
+ * between controller updates, the latency in the sensor measurements, the
+ * conversion from volts to the proprietary output and whether the controller
+ * Kd is time normalized.
+ */
+struct GainPreset {
+  bool velocity;
+  units::second_t dt, latency;
+  units::unit_t<units::inverse<units::volt>> output;
+  bool normalized;
+};
+
+/**
+ * A struct that represents parameters for the LQR used to calculate feedback
+ * gains.
+ */
+struct LQRParameters {
+  units::meter_t qp;
+  units::meters_per_second_t qv;
+  units::volt_t maxEffort;
+};
+
+/**
+ * A struct that represents the prepared data of one test (and side), along
+ * with its name.
+ */
+struct TestData {
+  std::string name;
+  const PreparedData* data;
+};
+
+/**
+ * The prepared data of a run, split into one segment for each test (and side
+ * of a drivetrain), along with the regression sums of each segment.
+ *
+ * A dataset is never modified once it has been handed out (see
+ * DataProcessor::GetDataset()), so it can be shared between threads and
+ * analyzed concurrently without locks. The segments themselves are shared
+ * between datasets: DataProcessor copies a segment before adding samples to
+ * it if a dataset that was handed out still refers to it, so loading new
+ * samples only copies the segments that changed.
+ */
+class Dataset {
+ public:
+  /**
+   * A struct that represents the prepared data of one side of one test,
+   * along with its regression sums.
+   */
+  struct Segment {
+    std::string test;
+    bool right;
+    bool backward;
+    bool quasistatic;
+    PreparedData data;
+    OLSSums sums;
+  };
+
+  /**
+   * Returns whether the data is from a drivetrain. If it is, data set indices
+   * refer to DataProcessor::kDrivetrainDataSources instead of kDataSources.
+   */
+  bool IsDrivetrain() const { return m_drivetrain; }
+
+  /**
+   * Returns the track width estimated from the track width test. This is NaN
+   * if the data does not contain one.
+   */
+  units::meter_t GetTrackWidth() const { return m_trackWidth; }
+
+  /**
+   * Returns the segments that are part of the given data set.
+   */
+  wpi::SmallVector<const Segment*, 8> GetSegments(int dataset) const;
+
+  /**
+   * Returns the prepared data of each test (and side) that is part of the
+   * given data set.
+   */
+  wpi::SmallVector<TestData, 8> GetData(int dataset) const;
+
+  /**
+   * Returns the regression sums of the given data set.
+   */
+  OLSSums GetSums(int dataset) const;
+
+  /**
+   * Returns the number of bytes used to store the prepared data.
+   */
+  size_t GetMemoryUsage() const;
+
+ private:
+  friend class DataProcessor;
+
+  /**
+   * Returns whether the segment is part of the given data set.
+   */
+  bool IsSelected(const Segment& segment, int dataset) const;
+
+  bool m_drivetrain = false;
+  units::meter_t m_trackWidth{std::nan("")};
+  std::vector<std::shared_ptr<Segment>> m_segments;
+};
+
+/**
+ * A struct that represents everything an analysis needs besides the data: the
+ * data set to fit, and the parameters of the feedback gains.
+ */
+struct AnalysisParameters {
+  int dataset;
+  GainPreset preset;
+  LQRParameters lqr;
+};
+
+/**
+ * A struct that represents the result of an analysis.
+ */
+struct AnalysisResult {
+  FFGains ff;
+  FBGains fb;
+};
+
+/**
+ * Calculates the feedforward gains of a data set and the feedback gains that
+ * follow from them. This only reads its arguments, so any number of analyses
+ * (e.g. of different data sets or parameters) can run at once on the same
+ * dataset. It does not allocate either, so it can be called repeatedly (e.g.
+ * on every change of a parameter) without touching the heap.
+ *
+ * @param data The prepared data.
+ * @param params The data set and feedback parameters.
+ * @return The gains.
+ */
+AnalysisResult Analyze(const Dataset& data, const AnalysisParameters& params);
+}  // namespace frcchar
@@ -0,0 +1,126 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace frcchar {
+/**
+ * A monotonic arena that hands out memory by bumping a pointer through large
+ * blocks, and frees all of it at once when it is reset. This is meant for the
+ * scratch buffers of a single run of a computation: the arena is reset at the
+ * start of each run, and keeps its memory, so once it has grown to the size
+ * that a run needs, later runs do not allocate at all.
+ *
+ * An arena must only be used by one thread at a time.
+ */
+class MonotonicArena {
+ public:
+  /**
+   * Constructs an arena. No memory is allocated until it is first needed.
+   *
+   * @param blockSize The size of the first block. Each new block is at least
+   * twice as large as the previous one.
+   */
+  explicit MonotonicArena(size_t blockSize = 64 * 1024)
+      : m_nextBlockSize(blockSize) {}
+
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+  /**
+   * Returns uninitialized memory with the given size and alignment, which
+   * stays valid until the arena is reset.
+   */
+  void* Allocate(size_t size, size_t alignment);
+
+  /**
+   * Frees everything that was allocated from the arena. If the last run
+   * needed more than one block, the blocks are replaced by a single block
+   * that is large enough for all of them, so that the next run fits in it.
+   */
+  void Reset();
+
+  /**
+   * Returns the total size of the blocks of the arena.
+   */
+  size_t Capacity() const { return m_capacity; }
+
+  /**
+   * Returns the number of bytes allocated since the arena was last reset.
+   */
+  size_t Used() const { return m_used; }
+
+ private:
+  struct Block {
+    std::unique_ptr<unsigned char[]> data;
+    size_t size;
+  };
+
+  /**
+   * Adds a block that has room for at least the given number of bytes.
+   */
+  void AddBlock(size_t size);
+
+  std::vector<Block> m_blocks;
+  size_t m_nextBlockSize;
+  size_t m_capacity = 0;
+  size_t m_used = 0;
+
+  // The free space of the last block.
+  unsigned char* m_pos = nullptr;
+  unsigned char* m_end = nullptr;
+};
+
+/**
+ * A standard allocator that allocates from an arena, so that standard
+ * containers can be used as scratch buffers. Deallocation does nothing,
+ * since the memory is freed when the arena is reset. Without an arena, it
+ * falls back to the heap, so functions that take an optional arena can use
+ * the same containers either way.
+ */
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  ArenaAllocator() = default;
+  explicit ArenaAllocator(MonotonicArena* arena) : m_arena(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)  // NOLINT(runtime/explicit)
+      : m_arena(other.GetArena()) {}
+
+  T* allocate(size_t count) {
+    if (!m_arena) return std::allocator<T>().allocate(count);
+    return static_cast<T*>(m_arena->Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* pointer, size_t count) {
+    if (!m_arena) std::allocator<T>().deallocate(pointer, count);
+  }
+
+  MonotonicArena* GetArena() const { return m_arena; }
+
+ private:
+  MonotonicArena* m_arena = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.GetArena() == b.GetArena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+/**
+ * A vector whose storage comes from an arena (or the heap without one).
+ */
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}  // namespace frcchar
@@ -0,0 +1,57 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <wpi/SmallVector.h>
+
+#include "backend/Analysis.h"
+#include "backend/PreparedData.h"
+
+namespace frcchar {
+/**
+ * A struct that represents a confidence interval for a single gain.
+ */
+struct GainInterval {
+  double lower, upper;
+};
+
+/**
+ * A struct that represents the confidence intervals of the feedforward gains
+ * and of the feedback gains derived from them.
+ */
+struct BootstrapResult {
+  GainInterval Ks, Kv, Ka, Kp, Kd;
+};
+
+/**
+ * Estimates confidence intervals for the gains with a block bootstrap. The
+ * data is split into blocks of consecutive samples whose regression sums are
+ * computed once, without letting a block span two tests. Each replicate then
+ * draws blocks with replacement and only has to add up their sums, so it never
+ * touches the samples themselves.
+ *
+ * Replicates run on all cores. Every replicate has its own random stream
+ * derived from the seed and its index, so the result only depends on the seed
+ * and not on the number of threads.
+ *
+ * @param data  The prepared data of each test in the data set.
+ * @param preset  The gain preset used to calculate feedback gains.
+ * @param params  The LQR parameters used to calculate feedback gains.
+ * @param replicates  The number of bootstrap replicates.
+ * @param seed  The seed of the random streams.
+ * @param confidence  The confidence level of the intervals (e.g. 0.95).
+ * @param blockSize  The number of consecutive samples in each block.
+ *
+ * @return The percentile confidence intervals of the gains.
+ */
+BootstrapResult BootstrapGains(const wpi::SmallVectorImpl<TestData>& data,
+                               const GainPreset& preset,
+                               const LQRParameters& params, int replicates,
+                               uint64_t seed,
+                               double confidence = 0.95,
+                               size_t blockSize = 32);
+}  // namespace frcchar
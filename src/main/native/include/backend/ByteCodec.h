@@ -0,0 +1,96 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace frcchar {
+/**
+ * Appends an unsigned integer as a varint (seven bits per byte, least
+ * significant first, with the high bit set on every byte but the last).
+ */
+inline void WriteVarint(std::vector<uint8_t>* out, uint64_t value) {
+  for (; value >= 0x80; value >>= 7)
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+/**
+ * Appends an unsigned integer as little-endian bytes.
+ */
+template <typename T>
+void WriteFixed(std::vector<uint8_t>* out, T value) {
+  for (size_t byte = 0; byte < sizeof(T); ++byte)
+    out->push_back(static_cast<uint8_t>(value >> (8 * byte)));
+}
+
+/**
+ * Appends a string, preceded by its size.
+ */
+inline void WriteString(std::vector<uint8_t>* out, const std::string& value) {
+  WriteVarint(out, value.size());
+  out->insert(out->end(), value.begin(), value.end());
+}
+
+/**
+ * Reads values written by the functions above. Reading past the end throws,
+ * so corrupt sizes and offsets never lead outside of the bytes.
+ */
+class ByteReader {
+ public:
+  ByteReader(const uint8_t* begin, const uint8_t* end)
+      : m_pos(begin), m_end(end) {}
+
+  uint64_t Varint() {
+    // Most values fit in a single byte.
+    if (m_pos != m_end && *m_pos < 0x80) return *m_pos++;
+
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (m_pos == m_end) Corrupt();
+      uint8_t byte = *m_pos++;
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    Corrupt();
+  }
+
+  template <typename T>
+  T Fixed() {
+    const uint8_t* bytes = Skip(sizeof(T));
+    T value = 0;
+    for (size_t byte = 0; byte < sizeof(T); ++byte)
+      value |= static_cast<T>(bytes[byte]) << (8 * byte);
+    return value;
+  }
+
+  std::string String() {
+    size_t size = Varint();
+    return std::string(reinterpret_cast<const char*>(Skip(size)), size);
+  }
+
+  /**
+   * Skips the given number of bytes and returns a pointer to them.
+   */
+  const uint8_t* Skip(size_t size) {
+    if (size > Remaining()) Corrupt();
+    const uint8_t* pos = m_pos;
+    m_pos += size;
+    return pos;
+  }
+
+  size_t Remaining() const { return m_end - m_pos; }
+
+  [[noreturn]] static void Corrupt() {
+    throw std::runtime_error("The archive is corrupt.");
+  }
+
+ private:
+  const uint8_t* m_pos;
+  const uint8_t* m_end;
+};
+}  // namespace frcchar
@@ -0,0 +1,217 @@
+// MIT License
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ntcore_cpp.h>
+#include <wpi/StringMap.h>
+
+#include "backend/LatencyProbe.h"
+#include "backend/TelemetryCapture.h"
+
+namespace frcchar {
+/**
+ * Runs the characterization tests on a single robot and captures its
+ * telemetry. Each session has its own NetworkTables instance and its own
+ * thread, which waits for telemetry, sends the voltage commands of the
+ * running test, and pings the robot while latency is being measured. This
+ * way, any number of robots can be logged at once without one of them adding
+ * latency to (or causing drops in) the capture of another, and the capture
+ * does not depend on the frame rate of the GUI.
+ *
+ * All public functions can be called from any thread. Tests are started and
+ * stopped by the session thread as soon as it wakes up, which is at most
+ * kCommandPeriod later.
+ */
+class CaptureSession {
+ public:
+  /**
+   * A struct that represents one of the tests, along with the name of its data
+   * in the JSON and the voltage that it applies.
+   */
+  struct TestInfo {
+    const char* name;
+    const char* key;
+    bool quasistatic;
+    bool backward;
+    bool rotate;
+  };
+
+  static constexpr TestInfo kTests[] = {
+      {"Quasistatic Forward", "slow-forward", true, false, false},
+      {"Quasistatic Reverse", "slow-backward", true, true, false},
+      {"Dynamic Forward", "fast-forward", false, false, false},
+      {"Dynamic Backward", "fast-backward", false, true, false},
+      {"Track Width", "track-width", false, false, true}};
+
+  /**
+   * A struct that represents the voltages that the tests apply.
+   */
+  struct Voltages {
+    double quasistaticRamp;
+    double dynamicStep;
+    double rotation;
+  };
+
+  /**
+   * A struct that represents the state of the connection, the capture, and
+   * the latency measurement at one point in time.
+   */
+  struct Status {
+    bool connected = false;
+
+    // See TelemetryCapture.
+    double rate = 0.0;
+    size_t received = 0;
+    size_t dropped = 0;
+    RunningStats deliveryDelay;
+
+    // See LatencyProbe.
+    size_t pingsSent = 0;
+    size_t pingsAnswered = 0;
+    RunningStats roundTrip;
+    RunningStats sensorDelay;
+    std::optional<double> clockOffset;
+  };
+
+  // The battery voltage that the voltage commands are scaled by.
+  static constexpr double kNominalBatteryVoltage = 12.0;
+
+  // The longest time in seconds that the session thread waits for telemetry
+  // before it sends the voltage command again.
+  static constexpr double kCommandPeriod = 0.005;
+
+  /**
+   * Creates a NetworkTables instance for the session and starts its thread.
+   * The session does not connect until Connect() is called.
+   *
+   * @param onChange Called on the session thread when the connection is made
+   * or lost, e.g. to wake up the GUI.
+   */
+  explicit CaptureSession(std::function<void()> onChange = {});
+  ~CaptureSession();
+
+  CaptureSession(const CaptureSession&) = delete;
+  CaptureSession& operator=(const CaptureSession&) = delete;
+
+  /**
+   * Connects to the robot of the given team, or to a server on localhost if
+   * the team number is zero (e.g. a SimulatedMechanism or the replay tool).
+   *
+   * @param team The team number of the robot.
+   * @param port The port of the NetworkTables server.
+   */
+  void Connect(int team, unsigned int port = NT_DEFAULT_PORT);
+
+  /**
+   * Starts running a test, stopping the test that was running before.
+   */
+  void StartTest(const TestInfo& test, const Voltages& voltages);
+
+  /**
+   * Stops the running test and stores the telemetry captured during it.
+   */
+  void StopTest();
+
+  /**
+   * Returns the running test, or nullptr if no test is running.
+   */
+  const TestInfo* GetActiveTest() const;
+
+  /**
+   * Returns whether the telemetry of the given test has been stored.
+   */
+  bool HasData(const char* key) const;
+
+  /**
+   * Starts or stops pinging the robot to measure its latency.
+   */
+  void SetMeasuringLatency(bool measuring) { m_measuringLatency = measuring; }
+  bool IsMeasuringLatency() const { return m_measuringLatency; }
+
+  /**
+   * Discards the statistics of the telemetry or of the latency measurement.
+   */
+  void ResetCapture() { m_resetCapture = true; }
+  void ResetLatency() { m_resetLatency = true; }
+
+  Status GetStatus() const;
+
+  /**
+   * Writes the stored telemetry to a new data JSON in the given folder, which
+   * never replaces an existing file. This only holds the lock of the session
+   * while the telemetry is copied, so it can run on a background thread while
+   * the capture continues.
+   *
+   * @param folder The folder to save the JSON in.
+   * @param name The name of the robot, which the name of the file includes.
+   * @param projectType The type of mechanism.
+   * @param unitsPerRotation The units per rotation of the positions.
+   * @return A message that says where the data was saved, or why it was not.
+   */
+  std::string WriteDataFile(const std::string& folder, const std::string& name,
+                            const std::string& projectType,
+                            double unitsPerRotation) const;
+
+ private:
+  /**
+   * Runs the session loop until the session is destroyed.
+   */
+  void Run();
+
+  /**
+   * Handles changes of the connection, and calls onChange for them.
+   */
+  void PollConnection();
+
+  /**
+   * Sends the voltage command of the running test.
+   */
+  void SendCommand();
+
+  /**
+   * Stores the telemetry of the running test and stops the robot.
+   */
+  void FinishTest();
+
+  NT_Inst m_inst;
+  NT_ConnectionListenerPoller m_connectionPoller;
+  std::function<void()> m_onChange;
+
+  // These are only used by the session thread.
+  TelemetryCapture m_capture;
+  LatencyProbe m_probe;
+  NT_Entry m_autospeedEntry;
+  NT_Entry m_rotateEntry;
+  bool m_connected = false;
+
+  std::atomic<bool> m_measuringLatency{false};
+  std::atomic<bool> m_resetCapture{false};
+  std::atomic<bool> m_resetLatency{false};
+
+  // The test state, the stored telemetry, and the status are shared with
+  // other threads. A test that was requested to start (or nullptr to stop)
+  // is applied by the session thread. The value that was subtracted from
+  // the timestamps of each test (see TelemetryCapture::GetTimestampShift())
+  // is stored along with them.
+  mutable std::mutex m_mutex;
+  std::optional<const TestInfo*> m_request;
+  const TestInfo* m_activeTest = nullptr;
+  Voltages m_voltages{};
+  std::chrono::steady_clock::time_point m_testStart;
+  wpi::StringMap<std::vector<TelemetryCapture::Sample>> m_data;
+  wpi::StringMap<double> m_clockOffsets;
+  Status m_status;
+
+  std::atomic<bool> m_running{true};
+  std::thread m_thread;
+};
+}  // namespace frcchar
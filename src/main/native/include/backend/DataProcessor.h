@@ -3,24 +3,27 @@
 #pragma once
 
 #include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <utility>
 #include <vector>
 
-#include <units/acceleration.h>
-#include <units/base.h>
-#include <units/dimensionless.h>
-#include <units/time.h>
-#include <units/velocity.h>
-#include <units/voltage.h>
+#include <wpi/SmallVector.h>
 #include <wpi/StringMap.h>
 #include <wpi/StringRef.h>
+#include <wpi/json.h>
 
-namespace units {
-using Kv_t = decltype(1_V / 1_mps);
-using Ka_t = decltype(1_V / 1_mps_sq);
-}  // namespace units
+#include "backend/AllocationCounter.h"
+#include "backend/Analysis.h"
+#include "backend/Arena.h"
+#include "backend/RunArchive.h"
+#include "backend/Sampling.h"
+#include "backend/SessionArchive.h"
+#include "backend/TrimOptimizer.h"
 
 namespace frcchar {
 /**
@@ -30,49 +33,12 @@ namespace frcchar {
  */
 class DataProcessor {
  public:
-  /**
-   * A struct that represents the feedforward gains produced by the analysis.
-   * This includes the standard Ks, Kv, and Ka, along with a coefficient of
-   * determination for the OLS multiple regression fit.
-   */
-  struct FFGains {
-    units::volt_t Ks;
-    units::Kv_t Kv;
-    units::Ka_t Ka;
-    double CoD;
-  };
-
-  /**
-   * A struct that represents the feedback gains produced by the analysis. This
-   * includes Kp and Kd. Kd will always be zero for a velocity loop type.
-   */
-  struct FBGains {
-    double Kp, Kd;
-  };
-
-  /**
-   * A struct that represents the presets for the feedback gains. These include
-   * whether we want to calculate gains for a velocity loop, the nominal period
-   * between controller updates, the latency in the sensor measurements, the
-   * conversion from volts to the proprietary output and whether the controller
-   * Kd is time normalized.
-   */
-  struct GainPreset {
-    bool velocity;
-    units::second_t dt, latency;
-    units::unit_t<units::inverse<units::volt>> output;
-    bool normalized;
-  };
-
-  /**
-   * A struct that represents parameters for the LQR used to calculate feedback
-   * gains.
-   */
-  struct LQRParameters {
-    units::meter_t qp;
-    units::meters_per_second_t qv;
-    units::volt_t maxEffort;
-  };
+  // The gains and parameters of the analysis (see Analysis.h).
+  using FFGains = frcchar::FFGains;
+  using FBGains = frcchar::FBGains;
+  using GainPreset = frcchar::GainPreset;
+  using LQRParameters = frcchar::LQRParameters;
+  using TestData = frcchar::TestData;
 
   /**
    * An enum that contains all of the supported tests.
@@ -89,57 +55,346 @@ class DataProcessor {
    * Constructs a new DataProcessor instance with the given gain preset.
    *
    * @param preset The preset to construct this processor instance with.
+   * @param compact Whether to store the prepared data as float instead of
+   * double to reduce memory usage (see PreparedData).
+   * @param run The index of the run to load if the path is a run archive.
+   * @param smoothing The bandwidth in Hz of the smoother that estimates the
+   * velocity and acceleration (see SmoothKinematics()), or zero to use the
+   * measured velocity and the three-point secant acceleration.
+   * @param resample Whether to resample each test onto a uniform grid at its
+   * nominal period before it is prepared (see ResampleUniform()).
+   * @param optimizeTrim Whether to choose the motion threshold and the start
+   * of the step voltage tests that fit best (see OptimizeTrim()) instead of
+   * using the fixed threshold and the first acceleration peak.
+   *
+   * If the path is empty, nothing is loaded until samples are given to
+   * LoadSamples() or AppendSamples().
    */
   DataProcessor(std::string* path, FFGains* ffGains, FBGains* fbGains,
-                GainPreset* preset, LQRParameters* params, int* dataType);
+                GainPreset* preset, LQRParameters* params, int* dataType,
+                bool compact = false, size_t run = 0, double smoothing = 0,
+                bool resample = false, bool optimizeTrim = false);
+
+  /**
+   * Returns the prepared data of each test (and side) that is part of the
+   * selected data set.
+   */
+  wpi::SmallVector<TestData, 8> GetData() const {
+    return m_data.GetData(m_dataset);
+  }
+
+  /**
+   * Returns the number of bytes used to store the prepared data, along with
+   * the raw samples that were given to AppendSamples().
+   */
+  size_t GetMemoryUsage() const;
+
+  /**
+   * Returns a snapshot of the prepared data that can be analyzed (see
+   * Analyze()) on any thread. Loading new samples later does not change the
+   * snapshot. The tests of a run archive that no data set has needed yet are
+   * empty in it.
+   */
+  std::shared_ptr<const Dataset> GetDataset() const {
+    return std::make_shared<const Dataset>(m_data);
+  }
+
+  /**
+   * Returns the compression ratio and decode time of the data if it was
+   * loaded from a session or run archive.
+   */
+  const std::optional<ArchiveStats>& GetArchiveStats() const {
+    return m_archiveStats;
+  }
 
-  std::vector<double>& GetData() { return m_data[kDataSources[m_dataset]]; }
+  /**
+   * Returns the number of heap allocations made by the last load of the data
+   * (including refreshes) and by the last analysis of Update(). Scratch
+   * buffers come from an arena that is reset with each load, and analyses
+   * do not allocate at all. These are zero in programs that do not count
+   * allocations (see IsCountingAllocations()).
+   */
+  AllocationCount GetLoadAllocations() const { return m_loadAllocations; }
+  AllocationCount GetUpdateAllocations() const { return m_updateAllocations; }
+
+  /**
+   * Returns the number of bytes that the scratch buffers of the last load
+   * used, and the capacity of the arena that they came from.
+   */
+  size_t GetArenaUsage() const { return m_arena.Used(); }
+  size_t GetArenaCapacity() const { return m_arena.Capacity(); }
+
+  /**
+   * Returns how regularly the tests that have been loaded were sampled, as
+   * logged (i.e. before any resampling).
+   */
+  SamplingStats GetSamplingStats() const;
+
+  /**
+   * Returns the cut points chosen by the trim optimizer, or nothing if it is
+   * disabled.
+   */
+  const std::optional<TrimResult>& GetTrim() const { return m_trim; }
+
+  /**
+   * Returns the sensor latency that the Logger measured while the data was
+   * logged (see LatencyProbe), or nothing if it was not measured.
+   */
+  const std::optional<units::second_t>& GetMeasuredLatency() const {
+    return m_measuredLatency;
+  }
+
+  /**
+   * Returns whether the data is from a drivetrain. If it is, the data set
+   * index refers to kDrivetrainDataSources instead of kDataSources.
+   */
+  bool IsDrivetrain() const { return m_data.IsDrivetrain(); }
+
+  /**
+   * Returns the track width estimated from the gyro and wheel positions of
+   * the track width test. This is NaN if the data does not contain one.
+   */
+  units::meter_t GetTrackWidth() const { return m_data.GetTrackWidth(); }
 
   /**
    * Calculates the feedback and feedforward gains given the current state of
    * this instance. This should be called whenever a value inside the gain
-   * preset or LQR parameters has changed.
+   * preset or LQR parameters has changed, or when the data set changes. The
+   * tests of a run archive are only loaded once a data set needs them, so
+   * this loads any that the selected data set is missing. The gains are
+   * calculated with Analyze().
    */
   void Update();
 
+  /**
+   * Re-reads the JSON (or session archive) and adds any samples that were
+   * appended to it since the last load. Only the new samples are cleaned,
+   * prepared, and added to the regression sums. If the data no longer
+   * contains the samples that were already seen (i.e. a different file was
+   * written to the same path), all of the data is reloaded.
+   *
+   * @return Whether the data changed. Update() should be called if it did.
+   */
+  bool Refresh();
+
+  /**
+   * Processes the samples of a characterization JSON that is already in
+   * memory instead of the file at the path. As with Refresh(), only the
+   * samples that have not been processed yet are prepared, so a JSON that
+   * grows as batches of samples arrive can be given again each time.
+   *
+   * @param json The contents of a characterization JSON.
+   * @return Whether the data changed. Update() should be called if it did.
+   */
+  bool LoadSamples(wpi::json json);
+
+  /**
+   * Adds a batch of samples to the ones that were given to this function
+   * before, instead of loading the file at the path. Unlike LoadSamples(),
+   * the caller does not have to keep the earlier samples: the arrays of each
+   * test only hold the new samples, and any other values (e.g. "test")
+   * replace the earlier ones. The raw samples are kept as rows so that a
+   * test can still be processed again from the start when it has to be (see
+   * Refresh()).
+   *
+   * @param batch A characterization JSON with the new samples of each test.
+   * @return Whether the data changed. Update() should be called if it did.
+   */
+  bool AppendSamples(const wpi::json& batch);
+
  private:
-  using RawData = std::vector<std::array<double, 10>>;
+  using Row = std::array<double, 10>;
+
+  // The raw samples of a test while it is being loaded. These are scratch
+  // buffers, so they come from the arena.
+  using RawData = ArenaVector<Row>;
 
   /**
-   * Trims quasistatic test data to eliminate data points where the velocity was
-   * below the motion threshold or when the applied voltage was zero.
+   * Keeps track of how much of a single test has already been processed so
+   * that appended samples can be prepared without revisiting old ones.
    */
-  void TrimQuasistaticData(RawData* data);
+  struct TestState {
+    // The number of raw samples from the JSON that have been processed.
+    size_t consumed = 0;
+
+    // The last two cleaned (and trimmed) samples. These are needed because
+    // the acceleration of a sample depends on its neighbors. They outlive the
+    // load, so they are not stored in the arena.
+    std::vector<Row> tail;
+
+    // Whether the step voltage trim has been applied to this test, and
+    // whether it was applied before the peak of the acceleration was
+    // confirmed. A test whose trim is pending is processed again from the
+    // start when it grows, so that it is cut where a full load would cut it.
+    bool trimmed = false;
+    bool trimPending = false;
+
+    // How regularly the raw samples were taken, and the latest time among
+    // them. Samples at or before that time are dropped.
+    SamplingStats sampling;
+    double latestTime = -std::numeric_limits<double>::infinity();
+  };
 
   /**
-   * Calculates acceleration by taking the slope of the secant line between
-   * three data points. This data is then bundled with the other voltage and
-   * velocity data.
+   * Resets the arena and loads the data with the loader for its format.
+   *
+   * @param json The JSON to load instead of the file at the path, if any.
+   * @return Whether any new samples were added to the data sets.
    */
-  std::vector<double> PrepareDataForAnalysis(RawData* data);
+  bool Load(wpi::json* json = nullptr);
 
   /**
-   * Trims acceleration data to remove all data points before the maximum
-   * acceleration point.
+   * Processes all raw samples of the JSON that have not been processed yet.
+   *
+   * @return Whether any new samples were added to the data sets.
    */
-  void TrimStepVoltageData(std::vector<double>* data);
+  bool LoadJson(wpi::json json);
 
   /**
-   * Calculates feedforward gains for the given data set.
+   * Processes all raw samples that were given to AppendSamples() and that
+   * have not been processed yet.
+   *
+   * @return Whether any new samples were added to the data sets.
+   */
+  bool LoadAppended();
+
+  /**
+   * Reads a session archive and processes all raw samples that have not been
+   * processed yet.
+   *
+   * @return Whether any new samples were added to the data sets.
+   */
+  bool LoadArchive();
+
+  /**
+   * Reads the index of a run archive and loads the segments of the tests
+   * that the selected data set needs and that have not been loaded yet.
+   *
+   * @return Whether any new samples were added to the data sets.
+   */
+  bool LoadRunArchive();
+
+  /**
+   * Returns whether the samples of a test that were already processed have
+   * to be processed again, given the number of samples that the data now
+   * has for it.
+   */
+  bool IsOutdated(wpi::StringRef test, size_t samples);
+
+  /**
+   * Returns whether a test has a segment that is part of the selected data
+   * set.
+   */
+  bool IsNeeded(wpi::StringRef test) const;
+
+  /**
+   * Returns whether a test of a run archive that the selected data set needs
+   * has not been loaded yet.
+   */
+  bool IsMissingTests() const;
+
+  /**
+   * Starts over from the beginning of the data if it is from a different run
+   * than the data that was already processed.
+   *
+   * @param projectType The type of mechanism of the data.
+   * @param factor The units per rotation of the data.
+   * @param missing Whether the data is missing samples that were already
+   * processed.
+   * @return Whether all of the data was cleared.
+   */
+  bool CheckRun(std::string projectType, units::meter_t factor, bool missing);
+
+  /**
+   * Reads the latency that was measured while the data was logged from its
+   * settings.
+   */
+  void ReadLatency(const wpi::json& settings);
+
+  using Segment = Dataset::Segment;
+
+  /**
+   * Measures how regularly new samples of a test were taken, drops the ones
+   * whose time did not increase, and resamples them if that is enabled.
+   */
+  void RegularizeSampling(RawData* data, TestState* state);
+
+  /**
+   * Cleans, trims, and prepares new samples of a test, and appends them to
+   * the segments of the test.
+   *
+   * @return Whether any new samples were added to the segments.
+   */
+  bool ProcessTest(RawData* data, TestState* state, bool quasistatic,
+                   const char* test);
+
+  /**
+   * Converts the samples of an archived test, starting at the given one, to
+   * rows.
    */
-  void CalculateFeedforwardGains();
+  RawData GetRows(const SessionTest& test, size_t begin);
 
   /**
-   * Calculates position feedback gains for the given data set using the
-   * feedforward parameters.
+   * Returns an empty buffer for raw samples in the arena.
    */
-  void CalculatePositionFeedbackGains();
+  RawData MakeRawData() { return RawData(ArenaAllocator<Row>(&m_arena)); }
 
   /**
-   * Calculates velocity feedback gains for the given data set using the
-   * feedforward parameters.
+   * Returns the segment of the given test and side so that samples can be
+   * added to it. The segment is copied first if a snapshot of the data still
+   * refers to it.
    */
-  void CalculateVelocityFeedbackGains();
+  Segment* GetSegment(wpi::StringRef test, bool right);
+
+  /**
+   * Estimates the track width of a drivetrain from the wheel positions and
+   * gyro angle (in radians) of a test where it turns in place. This is NaN
+   * if the robot turned less than kMinTrackWidthAngle.
+   */
+  units::meter_t CalculateTrackWidth(const RawData& data);
+
+  /**
+   * Clears all segments and test states so that the next load starts from
+   * the beginning of the JSON.
+   */
+  void Reset();
+
+  /**
+   * Ensures that voltages have the correct signs and applies the units per
+   * rotation conversion factor to the velocities.
+   */
+  void CleanData(RawData* data);
+
+  /**
+   * Trims quasistatic test data to eliminate data points where the velocity was
+   * at or below the motion threshold or when the applied voltage was zero.
+   */
+  void TrimQuasistaticData(RawData* data, double threshold);
+
+  /**
+   * Chooses the cut points of all segments with OptimizeTrim(), and cuts the
+   * segments at them.
+   */
+  void ApplyTrimOptimization();
+
+  /**
+   * Calculates acceleration by taking the slope of the secant line between
+   * three data points, or estimates the velocity and acceleration with the
+   * smoother if it is enabled. This data is then bundled with the other
+   * voltage and velocity data. The right side of a drivetrain is extracted in
+   * the same pass if a vector is given for it.
+   */
+  void PrepareDataForAnalysis(RawData* data, PreparedData* left,
+                              PreparedData* right);
+
+  /**
+   * Trims acceleration data to remove all data points before the maximum
+   * acceleration point.
+   *
+   * @return Whether the maximum was confirmed by the acceleration decreasing
+   * after it, rather than being the last sample of the data.
+   */
+  bool TrimStepVoltageData(PreparedData* data);
 
   // Location of the JSON file.
   std::string& m_path;
@@ -149,20 +404,60 @@ class DataProcessor {
   FBGains& m_fbGains;
 
   // Other values from the JSON.
-  units::meter_t m_factor;
+  units::meter_t m_factor = 0_m;
   std::string m_projectType;
+  std::optional<units::second_t> m_measuredLatency;
 
   // Preset and LQR parameters.
   GainPreset& m_preset;
   LQRParameters& m_lqrParams;
 
-  // Used to store the various data sets.
-  wpi::StringMap<std::vector<double>> m_data;
+  // The compression of the data if it was loaded from a session archive.
+  std::optional<ArchiveStats> m_archiveStats;
+
+  // The run to load from a run archive, and the number of samples of each of
+  // its tests according to the index.
+  size_t m_run;
+  wpi::StringMap<size_t> m_runSamples;
+
+  // The raw samples of each test that were given to AppendSamples(), and the
+  // latest values of the other keys of their batches.
+  wpi::StringMap<std::vector<Row>> m_appendedRows;
+  wpi::json m_appendedSettings;
+
+  // Used to store the prepared data of each test and side, along with
+  // whether the data is from a drivetrain and its track width. Each sample is
+  // only stored once, and the data sets are made up of the segments that they
+  // include.
+  Dataset m_data;
+  bool m_compact;
+
+  // The bandwidth of the smoother, or zero if it is disabled.
+  double m_smoothing;
+
+  // Whether the tests are resampled onto a uniform grid.
+  bool m_resample;
+
+  // Whether the trim is optimized, and the cut points that it chose.
+  bool m_optimizeTrim;
+  std::optional<TrimResult> m_trim;
+
+  // Processing state for each of the tests in the JSON.
+  wpi::StringMap<TestState> m_tests;
+
+  // The scratch memory of each load, and the allocations of the last load
+  // and analysis.
+  MonotonicArena m_arena;
+  AllocationCount m_loadAllocations;
+  AllocationCount m_updateAllocations;
 
   // Which dataset to use
   int& m_dataset;
 
   // Motion threshold.
   static constexpr auto kQuasistaticVelocityThreshold = 0.1_mps;
+
+  // The smallest turn in radians that the track width is estimated from.
+  static constexpr double kMinTrackWidthAngle = 0.1;
 };
 }  // namespace frcchar
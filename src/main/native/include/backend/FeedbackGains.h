@@ -0,0 +1,88 @@
+// MIT License
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "backend/Analysis.h"
+
+namespace frcchar {
+/**
+ * Calculates feedback gains from feedforward gains the same way that wpimath's
+ * LinearQuadraticRegulator does, but with fixed-size matrices, a closed-form
+ * discretization of the plant, and a structure-preserving doubling solve of
+ * the discrete algebraic Riccati equation. This does not allocate, so it is
+ * cheap enough to be evaluated thousands of times (e.g. for parameter sweeps)
+ * and is used by Analyze().
+ *
+ * The gains are converted to the output units of the preset, and Kd to the
+ * period of the controller if the preset is not time normalized (see
+ * ScaleFeedbackGains()).
+ *
+ * @param ff  The feedforward gains of the mechanism.
+ * @param preset  The gain preset.
+ * @param params  The LQR parameters.
+ *
+ * @return The feedback gains.
+ */
+FBGains CalculateFeedbackGains(const FFGains& ff, const GainPreset& preset,
+                               const LQRParameters& params);
+
+/**
+ * Converts feedback gains in volts to the output units of a preset. If the
+ * preset is not time normalized, Kd is also converted from per second to per
+ * controller period.
+ *
+ * @param gains  The feedback gains in volts.
+ * @param preset  The gain preset to convert the gains to.
+ *
+ * @return The converted feedback gains.
+ */
+FBGains ScaleFeedbackGains(const FBGains& gains, const GainPreset& preset);
+
+/**
+ * A struct that represents the feedback controller that runs with one of the
+ * motor controllers that the Generator supports: its period, the conversion
+ * from volts to its output, and whether its Kd is time normalized.
+ */
+struct ControllerPreset {
+  const char* name;
+  units::second_t dt;
+  units::unit_t<units::inverse<units::volt>> output;
+  bool normalized;
+};
+
+// The number of controller presets.
+constexpr size_t kNumControllerPresets = 8;
+
+/**
+ * The presets of the motor controllers, which are also the list of motor
+ * controllers that the Generator chooses from. PWM controllers are run by
+ * WPILib's PIDController on the roboRIO, and CAN controllers by their own
+ * onboard loops. The gains are per unit of the analyzed data, so controllers
+ * that measure in native units also need the encoder conversion applied.
+ */
+extern const ControllerPreset kControllerPresets[kNumControllerPresets];
+
+/**
+ * The feedback gains for each of the controller presets.
+ */
+using PresetGains = std::array<FBGains, kNumControllerPresets>;
+
+/**
+ * Calculates the feedback gains for every controller preset at once. The LQR
+ * is solved once for each distinct controller period, and the solutions are
+ * then scaled to the output of each preset, so this costs about as much as
+ * two calls to CalculateFeedbackGains().
+ *
+ * @param ff  The feedforward gains of the mechanism.
+ * @param preset  The gain preset that the loop type and latency are taken
+ * from.
+ * @param params  The LQR parameters.
+ *
+ * @return The feedback gains of each controller preset.
+ */
+PresetGains CalculatePresetGains(const FFGains& ff, const GainPreset& preset,
+                                 const LQRParameters& params);
+}  // namespace frcchar
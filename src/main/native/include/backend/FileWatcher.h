@@ -0,0 +1,49 @@
+// MIT License
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace frcchar {
+/**
+ * Watches a single file for changes. On Linux, this uses inotify so that
+ * checking for changes is a single non-blocking read. On other platforms, the
+ * last write time of the file is compared instead.
+ */
+class FileWatcher {
+ public:
+  /**
+   * Starts watching the file at the given path.
+   *
+   * @param path The path of the file to watch.
+   */
+  explicit FileWatcher(const std::string& path);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  /**
+   * Returns whether the file has been written to since the last call. This
+   * never blocks, so it is safe to call once per frame.
+   */
+  bool Poll();
+
+ private:
+  /**
+   * Starts (or restarts) watching the path. This is needed when the file is
+   * replaced instead of written in place.
+   */
+  void AddWatch();
+
+  std::string m_path;
+
+#ifdef __linux__
+  int m_fd = -1;
+  int m_wd = -1;
+#else
+  int64_t m_lastWriteTime = 0;
+#endif
+};
+}  // namespace frcchar
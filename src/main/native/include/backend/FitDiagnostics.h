@@ -0,0 +1,60 @@
+// MIT License
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <wpi/SmallVector.h>
+
+#include "backend/Analysis.h"
+#include "backend/MinMaxPyramid.h"
+#include "backend/PreparedData.h"
+
+namespace frcchar {
+/**
+ * A struct that represents the diagnostics of a feedforward fit. The residual
+ * of a sample is its measured voltage minus the voltage predicted by the
+ * gains (Ks * sgn(v) + Kv * v + Ka * a).
+ */
+struct FitDiagnostics {
+  // The root-mean-square residual.
+  double rms = 0.0;
+
+  // A histogram of the residuals, with bins of equal width starting at
+  // histogramMin. Residuals outside of the histogram are counted in the first
+  // or last bin.
+  std::vector<double> histogram;
+  double histogramMin = 0.0;
+  double binWidth = 0.0;
+
+  // The velocity, acceleration, and residual of evenly spaced samples, used
+  // to plot the residuals against velocity and acceleration.
+  std::vector<double> velocity, acceleration, residual;
+
+  // The measured and predicted voltage of each test over time.
+  struct Test {
+    std::string name;
+    MinMaxPyramid measured, predicted;
+  };
+  std::vector<Test> tests;
+};
+
+/**
+ * Calculates the diagnostics of a feedforward fit. This makes a full pass over
+ * the data, so it should not be called on the UI thread.
+ *
+ * @param tests The name and prepared data of each test in the data set.
+ * @param gains The feedforward gains to calculate the residuals of.
+ * @param cancel A flag that stops the calculation early when it is set. The
+ * result is incomplete in that case and should be discarded.
+ * @param bins The number of bins of the histogram.
+ * @param maxScatter The largest number of samples in the scatter data.
+ */
+FitDiagnostics CalculateFitDiagnostics(
+    const wpi::SmallVectorImpl<TestData>& tests,
+    const FFGains& gains, const std::atomic<bool>& cancel,
+    size_t bins = 50, size_t maxScatter = 20000);
+}  // namespace frcchar
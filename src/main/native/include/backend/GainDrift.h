@@ -0,0 +1,56 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "backend/Analysis.h"
+
+namespace frcchar {
+/**
+ * A struct that represents the feedforward gains fit to a sliding time window
+ * of each test, which show how the gains drift over a long capture (e.g. as
+ * the battery sags or the motors heat up).
+ *
+ * A window of a single test does not determine all three gains: the
+ * acceleration of a quasistatic test is nearly zero, and the acceleration of a
+ * step voltage test is nearly a linear function of its velocity. The windows
+ * of quasistatic tests are therefore fit for Ks and Kv with Ka held at the
+ * gain of the whole data set, and the windows of step voltage tests are fit
+ * for Ka with Ks and Kv held.
+ */
+struct GainDrift {
+  struct Test {
+    std::string name;
+
+    // The center time of each window.
+    std::vector<double> time;
+
+    // The gains of each window. The gains that are held for a test are empty,
+    // and the gains of a window with too few samples to fit are NaN.
+    std::vector<double> Ks, Kv, Ka;
+  };
+  std::vector<Test> tests;
+};
+
+/**
+ * Fits the feedforward gains to a sliding time window of each test in a data
+ * set. The data is summed in a single pass, which records the cumulative
+ * regression sums at the boundaries of the windows, so each window costs
+ * O(1) no matter how long it is, and the memory used only depends on the
+ * number of windows.
+ *
+ * @param data The prepared data.
+ * @param dataset The data set to fit.
+ * @param gains The gains of the whole data set, which the gains that a window
+ * does not determine are held at.
+ * @param window The length of the windows in seconds.
+ * @param windows The number of windows of each test, which are spaced evenly
+ * from its start to its end.
+ */
+GainDrift CalculateGainDrift(const Dataset& data, int dataset,
+                             const FFGains& gains, double window,
+                             size_t windows = 500);
+}  // namespace frcchar
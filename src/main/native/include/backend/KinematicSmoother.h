@@ -0,0 +1,47 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+
+#include "backend/Arena.h"
+
+namespace frcchar {
+/**
+ * Estimates the velocity and acceleration of a mechanism from its measured
+ * velocity with a Rauch-Tung-Striebel (forward-backward Kalman) smoother.
+ *
+ * The model is a constant-acceleration model whose state is the velocity and
+ * acceleration, driven by white jerk. Unlike the three-point secant, which
+ * amplifies the encoder quantization noise by dividing a difference of noisy
+ * velocities by a short time, the smoother uses every sample of the test to
+ * estimate each acceleration.
+ *
+ * Only the ratio of the jerk to the measurement noise affects the estimates,
+ * so the smoother is tuned by its bandwidth instead. The ratio of their
+ * spectral densities is set to bandwidth^4, which makes the steady-state
+ * filter of the velocity a second-order Butterworth filter (damping ratio
+ * 1/sqrt(2)) with the bandwidth as its natural frequency. The measurement
+ * noise density is the variance of a sample times the sample period, so the
+ * ratio uses the median period of the samples, and the bandwidth does not
+ * depend on the sample rate. The bandwidth should be above that of the
+ * mechanism (about Kv / (2 pi Ka)), or the acceleration at the start of the
+ * step voltage tests is smeared out.
+ *
+ * The forward pass keeps the filtered state and covariance of each sample,
+ * which the backward pass uses to smooth them, so both passes are O(n) and
+ * all of the storage is allocated up front, from the arena if one is given.
+ *
+ * @param time The times of the samples, which must be non-decreasing.
+ * @param velocity The measured velocities of the samples.
+ * @param size The number of samples.
+ * @param bandwidth The bandwidth of the smoother in Hz.
+ * @param smoothedVelocity The smoothed velocities of the samples.
+ * @param acceleration The smoothed accelerations of the samples.
+ * @param arena The arena to allocate the states from, or nullptr to use the
+ * heap.
+ */
+void SmoothKinematics(const double* time, const double* velocity, size_t size,
+                      double bandwidth, double* smoothedVelocity,
+                      double* acceleration, MonotonicArena* arena = nullptr);
+}  // namespace frcchar
@@ -0,0 +1,75 @@
+// MIT License
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "backend/Analysis.h"
+
+namespace frcchar {
+/**
+ * A struct that represents one axis of an LQR parameter sweep. The values are
+ * spaced linearly from the minimum to the maximum (inclusive) and are in SI
+ * units (meters, meters per second, volts, or seconds).
+ */
+struct SweepAxis {
+  /**
+   * An enum that contains all of the parameters that can be swept.
+   */
+  enum Parameter { kQp, kQv, kMaxEffort, kDt, kLatency };
+
+  static constexpr const char* kParameters[] = {
+      "qp (m)", "qv (m/s)", "Max Effort (V)", "Period (s)", "Latency (s)"};
+
+  int parameter;
+  double min, max;
+  int steps;
+
+  /**
+   * Returns the parameter value at the given step.
+   */
+  double Value(int step) const {
+    return steps > 1 ? min + (max - min) * step / (steps - 1) : min;
+  }
+};
+
+/**
+ * A struct that represents the result of an LQR parameter sweep. The gains are
+ * stored in row-major order, where each row corresponds to a step of the y
+ * axis and each column corresponds to a step of the x axis.
+ */
+struct SweepResult {
+  SweepAxis x, y;
+  std::vector<double> Kp, Kd;
+};
+
+/**
+ * Calculates the feedback gains over a grid of LQR parameters. The grid is
+ * split into rows that are solved on all available cores.
+ *
+ * @param ff  The feedforward gains of the mechanism.
+ * @param preset  The gain preset whose values are used for unswept
+ * parameters.
+ * @param params  The LQR parameters whose values are used for unswept
+ * parameters.
+ * @param x  The parameter to sweep along the columns of the grid.
+ * @param y  The parameter to sweep along the rows of the grid.
+ *
+ * @return The feedback gains at each point of the grid.
+ */
+SweepResult SweepFeedbackGains(const FFGains& ff, const GainPreset& preset,
+                               const LQRParameters& params, const SweepAxis& x,
+                               const SweepAxis& y);
+
+/**
+ * Writes the result of a parameter sweep to a CSV file with one line per grid
+ * point.
+ *
+ * @param result  The result of the sweep.
+ * @param path  The location of the CSV file.
+ *
+ * @throws std::runtime_error if the file could not be written.
+ */
+void ExportSweep(const SweepResult& result, const std::string& path);
+}  // namespace frcchar
@@ -0,0 +1,150 @@
+// MIT License
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include <ntcore_cpp.h>
+
+namespace frcchar {
+/**
+ * Running statistics of a measurement, which are updated one value at a time
+ * with Welford's algorithm.
+ */
+struct RunningStats {
+  size_t count = 0;
+  double mean = 0.0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+
+  // The sum of the squared deviations from the mean.
+  double m2 = 0.0;
+
+  /**
+   * Adds a single value to the statistics.
+   */
+  void Add(double value);
+
+  /**
+   * Returns the sample standard deviation of the values.
+   */
+  double StdDev() const;
+};
+
+/**
+ * Measures the latency between the robot and the host, along with the offset
+ * between their clocks, by exchanging pings with the robot over NetworkTables.
+ *
+ * The host publishes [sequence, host send time] to the ping entry. The robot
+ * answers each new ping by publishing [sequence, host send time, robot receive
+ * time, robot send time, sensor delay] to the pong entry. The robot times are
+ * on the clock of its telemetry, and the sensor delay is how long before it
+ * publishes a sample the robot reads its sensors.
+ *
+ * As in NTP, the round trip excludes the time that the robot held the ping,
+ * and the offset assumes that the ping and pong took equally long. Queueing
+ * only ever adds delay to one of them, so the offset is taken from the
+ * fastest of the recent round trips.
+ */
+class LatencyProbe {
+ public:
+  // The names of the entries that pings and their answers are published to.
+  static constexpr const char* kPingEntry = "/robot/ping";
+  static constexpr const char* kPongEntry = "/robot/pong";
+
+  // The time between pings, in seconds.
+  static constexpr double kPingPeriod = 0.05;
+
+  /**
+   * Starts listening for answers on the given NetworkTables instance. No
+   * pings are sent until Poll() is called.
+   *
+   * @param inst The instance to send pings on.
+   */
+  explicit LatencyProbe(NT_Inst inst);
+  ~LatencyProbe();
+
+  LatencyProbe(const LatencyProbe&) = delete;
+  LatencyProbe& operator=(const LatencyProbe&) = delete;
+
+  /**
+   * Processes the answers that have arrived since the last call, and sends a
+   * ping if the last one was sent at least kPingPeriod ago. This never
+   * blocks, so it is safe to call once per frame.
+   */
+  void Poll();
+
+  /**
+   * Discards all measurements.
+   */
+  void Reset();
+
+  /**
+   * Returns the number of pings that were sent and answered.
+   */
+  size_t GetSent() const { return m_sent; }
+  size_t GetAnswered() const { return m_roundTrip.count; }
+
+  /**
+   * Returns the statistics of the round trip time in seconds.
+   */
+  const RunningStats& GetRoundTrip() const { return m_roundTrip; }
+
+  /**
+   * Returns the statistics of the delay in seconds between the robot reading
+   * its sensors and publishing them.
+   */
+  const RunningStats& GetSensorDelay() const { return m_sensorDelay; }
+
+  /**
+   * Returns the time of the robot clock minus the time of the host clock
+   * (see GetHostTime()) in seconds, or nothing if no ping has been answered.
+   */
+  std::optional<double> GetClockOffset() const;
+
+  /**
+   * Returns the time of the host clock in seconds. This is the clock that
+   * NetworkTables stamps the values that it receives with.
+   */
+  static double GetHostTime() { return ToSeconds(nt::Now()); }
+
+  /**
+   * Converts a NetworkTables timestamp to seconds.
+   */
+  static double ToSeconds(uint64_t time) { return time * 1E-6; }
+
+ private:
+  /**
+   * A single answered ping.
+   */
+  struct Exchange {
+    double roundTrip;
+    double offset;
+  };
+
+  NT_Inst m_inst;
+  NT_Entry m_pingEntry;
+  NT_EntryListenerPoller m_poller;
+
+  // The sequence number of the last ping, and the number of pings sent since
+  // the last reset.
+  size_t m_sequence = 0;
+  size_t m_sent = 0;
+  double m_lastPing = -std::numeric_limits<double>::infinity();
+
+  // The highest sequence number that was answered, so that answers that are
+  // repeated or arrive out of order are ignored.
+  double m_lastAnswered = 0.0;
+
+  RunningStats m_roundTrip;
+  RunningStats m_sensorDelay;
+
+  // The most recent exchanges, which the offset is estimated from.
+  static constexpr size_t kOffsetWindow = 16;
+  std::array<Exchange, kOffsetWindow> m_exchanges;
+};
+}  // namespace frcchar
@@ -0,0 +1,14 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+
+namespace frcchar {
+/**
+ * Returns the peak amount of physical memory (resident set size) that this
+ * process has used so far, in bytes. This is zero on platforms where it cannot
+ * be determined.
+ */
+size_t GetPeakMemoryUsage();
+}  // namespace frcchar
@@ -0,0 +1,59 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace frcchar {
+/**
+ * A level-of-detail pyramid for plotting a long series of (x, y) samples,
+ * where x is increasing. Each level splits the samples into bins that are
+ * twice as large as the bins of the level below it, and keeps only the
+ * minimum and maximum sample of each bin, in the order in which they occur.
+ *
+ * Plotting the level whose bins are about one pixel wide looks the same as
+ * plotting every sample, because the line still reaches the extremes of each
+ * pixel column. The pyramid is built once in linear time and uses about twice
+ * the memory of the samples, after which each query only copies about as many
+ * points as there are pixels.
+ */
+class MinMaxPyramid {
+ public:
+  MinMaxPyramid() = default;
+
+  /**
+   * Builds the pyramid of the given samples.
+   *
+   * @param x The x values of the samples, which must be increasing.
+   * @param y The y values of the samples.
+   */
+  MinMaxPyramid(std::vector<double> x, std::vector<double> y);
+
+  /**
+   * Returns the points to plot for the visible range of x values. The points
+   * just outside of the range are included so that the lines reach the edges
+   * of the plot.
+   *
+   * @param xMin The smallest visible x value.
+   * @param xMax The largest visible x value.
+   * @param maxPoints The largest number of points to return, which should be
+   * about twice the width of the plot in pixels.
+   * @param xs The x values of the points.
+   * @param ys The y values of the points.
+   */
+  void Query(double xMin, double xMax, size_t maxPoints,
+             std::vector<double>* xs, std::vector<double>* ys) const;
+
+ private:
+  /**
+   * The points of a single level. The first level holds all samples, and the
+   * others hold two points (the minimum and maximum) per bin.
+   */
+  struct Level {
+    std::vector<double> x, y;
+  };
+
+  std::vector<Level> m_levels;
+};
+}  // namespace frcchar
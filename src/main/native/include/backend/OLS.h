@@ -2,9 +2,83 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <vector>
 
+#include <Eigen/Core>
+
 namespace frcchar {
+/**
+ * Running sums of the normal-equation terms (X'X, X'y, y'y, and the sum of y)
+ * for a regression with three independent variables. Samples can be added as
+ * they arrive and sums from separate data sets can be merged, so a regression
+ * never needs to rescan samples that it has already seen.
+ */
+struct OLSSums {
+  Eigen::Matrix3d XtX = Eigen::Matrix3d::Zero();
+  Eigen::Vector3d Xty = Eigen::Vector3d::Zero();
+  double yty = 0.0;
+  double ySum = 0.0;
+  size_t n = 0;
+
+  /**
+   * Adds a single sample to the sums.
+   *
+   * @param sample  Pointer to the dependent variable followed by the three
+   * independent variables.
+   */
+  void Add(const double* sample);
+
+  /**
+   * Adds every sample in an interleaved data set to the sums.
+   *
+   * @param data  The data, stored as consecutive (y, x0, x1, x2) samples.
+   */
+  void Add(const std::vector<double>& data);
+
+  /**
+   * Adds every sample in an interleaved data set to the sums. The samples are
+   * split into fixed-size chunks that are summed on all cores with
+   * compensated summation, and the sums of the chunks are then combined
+   * pairwise. The chunks do not depend on the number of threads, so neither
+   * does the result.
+   *
+   * @param data  The data, stored as consecutive (y, x0, x1, x2) samples.
+   * @param samples  The number of samples.
+   * @param threads  The number of threads to use, or zero to use one thread
+   * per core.
+   */
+  void Add(const double* data, size_t samples, size_t threads = 0);
+
+  /**
+   * Adds samples that are stored column by column, in the same way as the
+   * interleaved overload. The first independent variable is the sign of the
+   * second one (the intercept term of the feedforward model), so it is
+   * derived instead of stored. The columns may be float or double, but the
+   * sums are always accumulated in double.
+   *
+   * @param y  The dependent variable.
+   * @param x1  The second independent variable.
+   * @param x2  The third independent variable.
+   * @param samples  The number of samples.
+   * @param threads  The number of threads to use, or zero to use one thread
+   * per core.
+   */
+  template <typename T>
+  void Add(const T* y, const T* x1, const T* x2, size_t samples,
+           size_t threads = 0);
+
+  OLSSums& operator+=(const OLSSums& other);
+
+  /**
+   * Removes the samples of other sums, which must have been added to these
+   * ones. The sums of a range of samples are the difference of two
+   * cumulative sums.
+   */
+  OLSSums& operator-=(const OLSSums& other);
+};
+
 /**
  * Calculates multiple regression on the data set and returns the coefficients
  * of the regression, as well as the adjusted coefficient of determination.
@@ -16,4 +90,15 @@ namespace frcchar {
  * appended to the vector.
  */
 std::vector<double> OLS(const std::vector<double>& data, size_t variables);
+
+/**
+ * Calculates multiple regression from precomputed normal-equation sums. This
+ * does not allocate.
+ *
+ * @param sums  The sums of the data to perform the regression on.
+ *
+ * @return The coefficients of the regression followed by the adjusted
+ * r-squared.
+ */
+std::array<double, 4> OLS(const OLSSums& sums);
 }  // namespace frcchar
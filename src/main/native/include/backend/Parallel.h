@@ -0,0 +1,59 @@
+// MIT License
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+
+namespace frcchar {
+namespace detail {
+/**
+ * Calls run(context, batch) for each batch in [0, batches) on the worker pool
+ * and the calling thread, and returns once every batch is done. The pool is
+ * started on first use with one thread per core besides the calling one, and
+ * its threads are reused by every call. The calling thread runs batches too,
+ * so calls from inside a batch (and calls while the pool is busy) always make
+ * progress. If a batch throws, the first exception is rethrown here once all
+ * batches are done.
+ */
+void RunBatches(size_t batches, void (*run)(void* context, size_t batch),
+                void* context);
+}  // namespace detail
+
+/**
+ * Splits the range [0, count) into contiguous batches and calls
+ * func(begin, end) for each batch, with the batches running concurrently on
+ * the shared worker pool. The calling thread processes batches too, and this
+ * returns once every batch is done. Neither the pool nor this function
+ * allocates once the pool is running.
+ *
+ * @param count  The number of items to process.
+ * @param func  The function that processes a batch of items.
+ * @param threads  The number of batches (and so the most threads that run
+ * them at once), or zero to use one per core.
+ */
+template <typename F>
+void ParallelFor(size_t count, F&& func, size_t threads = 0) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::max<size_t>(1, std::min(threads, count));
+  if (threads == 1) {
+    func(0, count);
+    return;
+  }
+
+  struct Context {
+    std::remove_reference_t<F>* func;
+    size_t count;
+    size_t batch;
+  } context{&func, count, (count + threads - 1) / threads};
+  auto run = [](void* pointer, size_t i) {
+    auto& context = *static_cast<Context*>(pointer);
+    size_t begin = i * context.batch;
+    (*context.func)(begin, std::min(begin + context.batch, context.count));
+  };
+  detail::RunBatches((count + context.batch - 1) / context.batch, run,
+                     &context);
+}
+}  // namespace frcchar
@@ -0,0 +1,131 @@
+// MIT License
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "backend/OLS.h"
+
+namespace frcchar {
+/**
+ * Stores the prepared (time, voltage, velocity, acceleration) samples of a
+ * single test, column by column. The intercept term is the sign of the
+ * velocity, so it is derived instead of stored.
+ *
+ * In compact mode, the voltage, velocity, and acceleration columns are stored
+ * as float instead of double, which saves three eighths of the memory used.
+ * Time stays double in both modes, since a float timestamp of a long test
+ * would be off by milliseconds. Regression sums are still accumulated in
+ * double, so the only difference is the rounding of each sample to float (a
+ * relative error of about 6e-8). This is far below the noise of the
+ * measurements: the feedforward gains from both modes agree to within 1e-5
+ * (relative), which the prepared data test checks.
+ */
+class PreparedData {
+ public:
+  /**
+   * Constructs an empty set of prepared data.
+   *
+   * @param compact Whether to store the samples as float.
+   */
+  explicit PreparedData(bool compact = false) : m_compact(compact) {}
+
+  size_t Size() const {
+    return m_compact ? m_float.voltage.size() : m_double.voltage.size();
+  }
+
+  bool IsCompact() const { return m_compact; }
+
+  double Time(size_t i) const { return m_time[i]; }
+
+  double Voltage(size_t i) const {
+    return m_compact ? m_float.voltage[i] : m_double.voltage[i];
+  }
+
+  double Intercept(size_t i) const { return std::copysign(1.0, Velocity(i)); }
+
+  double Velocity(size_t i) const {
+    return m_compact ? m_float.velocity[i] : m_double.velocity[i];
+  }
+
+  double Acceleration(size_t i) const {
+    return m_compact ? m_float.acceleration[i] : m_double.acceleration[i];
+  }
+
+  /**
+   * Reserves space for the given total number of samples.
+   */
+  void Reserve(size_t size);
+
+  /**
+   * Appends a sample to the end of the columns.
+   */
+  void Append(double time, double voltage, double velocity,
+              double acceleration);
+
+  /**
+   * Removes the given number of samples from the start of the columns.
+   */
+  void EraseFront(size_t count);
+
+  /**
+   * Removes the samples for which the given predicate returns true. The
+   * predicate is called with the index of each sample, in order, before any
+   * sample after it has moved.
+   */
+  template <typename Predicate>
+  void RemoveIf(Predicate&& remove);
+
+  /**
+   * Calculates the regression sums of a range of samples.
+   *
+   * @param begin  The index of the first sample.
+   * @param end  One past the index of the last sample.
+   * @param threads  The number of threads to use, or zero to use one thread
+   * per core.
+   */
+  OLSSums Sums(size_t begin, size_t end, size_t threads = 0) const;
+
+  /**
+   * Returns the number of bytes used to store the samples.
+   */
+  size_t MemoryUsage() const;
+
+ private:
+  template <typename T>
+  struct Columns {
+    std::vector<T> voltage, velocity, acceleration;
+  };
+
+  bool m_compact;
+  std::vector<double> m_time;
+  Columns<double> m_double;
+  Columns<float> m_float;
+};
+
+template <typename Predicate>
+void PreparedData::RemoveIf(Predicate&& remove) {
+  auto filter = [&](auto& columns) {
+    size_t kept = 0;
+    for (size_t i = 0; i < columns.voltage.size(); ++i) {
+      if (remove(i)) continue;
+      m_time[kept] = m_time[i];
+      columns.voltage[kept] = columns.voltage[i];
+      columns.velocity[kept] = columns.velocity[i];
+      columns.acceleration[kept] = columns.acceleration[i];
+      ++kept;
+    }
+    m_time.resize(kept);
+    for (auto column :
+         {&columns.voltage, &columns.velocity, &columns.acceleration})
+      column->resize(kept);
+  };
+
+  if (m_compact)
+    filter(m_float);
+  else
+    filter(m_double);
+}
+}  // namespace frcchar
@@ -14,6 +14,7 @@ namespace fs = std::filesystem;
 #include <wpi/Error.h>
 
 #include <exception>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -24,7 +25,8 @@ class ProjectCreator {
                  const int& team);
 
   void CreateProject();
-  void DeployProject(std::string* result);
+  void DeployProject(std::string* result,
+                     const std::function<void()>& onOutput = {});
 
  private:
   const std::string& m_dir;
@@ -0,0 +1,143 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <wpi/StringRef.h>
+#include <wpi/json.h>
+
+#include "backend/SessionArchive.h"
+
+namespace frcchar {
+/**
+ * An archive that holds many characterization runs in a single file, with an
+ * index of the runs and of the tests (segments) of each run. Opening the
+ * archive only reads the indexes, and each segment can be loaded on its own by
+ * seeking to it, so loading one test of one run takes about as long no matter
+ * how large the archive is.
+ *
+ * The file starts with a magic number, followed by the segments, each encoded
+ * as in a session archive (see EncodeSessionTest()). Adding a run appends its
+ * segments after the old footer, followed by an index and a footer that
+ * locates it, so nothing that was already written is ever touched. If adding
+ * a run is interrupted, the archive is read from the last valid footer, and
+ * the next run that is added overwrites what is left of the interrupted one.
+ *
+ * Each index only holds the runs since an earlier index, and its footer
+ * points back to the footer of that index. The runs of each index are chosen
+ * so that opening the archive reads about log2(runs) indexes at most, and
+ * the indexes take O(runs log runs) bytes in total, instead of one full
+ * index per run.
+ */
+class RunArchive {
+ public:
+  /**
+   * The location of one test of a run within the archive.
+   */
+  struct Segment {
+    std::string test;
+    uint64_t offset;
+    uint64_t size;
+    size_t samples;
+  };
+
+  /**
+   * The keys of a run (robot, date, and mechanism), its settings, and its
+   * segments.
+   */
+  struct Run {
+    std::string robot;
+    std::string date;
+    std::string mechanism;
+
+    // Everything in the data JSON of the run other than the samples, as JSON
+    // text. This is only parsed for the runs that are loaded.
+    std::string settings;
+
+    std::vector<Segment> segments;
+
+    /**
+     * Returns the segment of the given test, or nullptr if there is none.
+     */
+    const Segment* Find(wpi::StringRef test) const;
+  };
+
+  /**
+   * Opens the archive at the given path and reads its index. The archive is
+   * created when runs are added if it does not exist yet.
+   *
+   * @throws std::runtime_error if the file exists but is not a valid run
+   * archive.
+   */
+  explicit RunArchive(std::string path);
+
+  /**
+   * Returns the runs in the archive, in the order in which they were added.
+   */
+  const std::vector<Run>& GetRuns() const { return m_runs; }
+
+  /**
+   * Adds a run to the archive.
+   *
+   * @param json The data JSON of the run.
+   * @param robot The name of the robot.
+   * @param date The date of the run. If this is empty, the "date" of the JSON
+   * is used, or the current date if it doesn't have one.
+   * @return The size of the new segments compared to their samples.
+   * @throws std::runtime_error if the run could not be written.
+   */
+  ArchiveStats AddRun(const wpi::json& json, const std::string& robot,
+                      std::string date = "");
+
+  /**
+   * Loads the samples of one test of a run.
+   *
+   * @param run The index of the run.
+   * @param test The name of the test.
+   * @param stats The size of the segment and the time taken to load it.
+   * @throws std::runtime_error if the run or test doesn't exist or the
+   * segment is corrupt.
+   */
+  SessionTest LoadSegment(size_t run, wpi::StringRef test,
+                          ArchiveStats* stats = nullptr) const;
+
+ private:
+  /**
+   * Reads the footer and index at the end of the file.
+   */
+  void ReadIndex();
+
+  /**
+   * The location of an index in the chain that the last footer starts.
+   */
+  struct IndexLocation {
+    // The number of runs up to the end of the index.
+    size_t runs;
+
+    // The end of the footer of the index.
+    uint64_t footerEnd;
+  };
+
+  std::string m_path;
+  std::vector<Run> m_runs;
+  std::vector<IndexLocation> m_indexes;
+
+  // The end of the last segment, where the index starts.
+  uint64_t m_dataEnd = 0;
+
+  // The end of the footer, after which the segments of new runs are written.
+  uint64_t m_end = 0;
+};
+
+// The file extension of run archives.
+constexpr const char* kRunArchiveExtension = ".frcruns";
+
+/**
+ * Returns whether the path refers to a run archive.
+ */
+bool IsRunArchive(wpi::StringRef path);
+}  // namespace frcchar
@@ -0,0 +1,107 @@
+// MIT License
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "backend/Arena.h"
+
+namespace frcchar {
+/**
+ * A struct that describes how regularly a test was sampled. The intervals
+ * between samples are classified as duplicates (the time did not increase),
+ * gaps (more than kGapPeriods times the nominal period), or regular.
+ */
+struct SamplingStats {
+  // The number of samples.
+  size_t samples = 0;
+
+  // The nominal (median) period between samples, in seconds.
+  double period = 0.0;
+
+  // The RMS deviation of the regular intervals from the nominal period.
+  double jitter = 0.0;
+
+  // The number of duplicate samples and gaps, and the longest gap.
+  size_t duplicates = 0;
+  size_t gaps = 0;
+  double maxGap = 0.0;
+
+  // Intervals longer than this many nominal periods are gaps.
+  static constexpr double kGapPeriods = 2.0;
+
+  /**
+   * Combines the statistics of another test or batch of samples with these.
+   * The period and jitter are averaged, weighted by the number of samples.
+   */
+  void Merge(const SamplingStats& other);
+};
+
+/**
+ * Calculates the sampling statistics of the given timestamps.
+ *
+ * @param time The timestamps of the samples, in the order they were logged.
+ * @param size The number of samples.
+ * @param arena The arena to allocate scratch memory from, or nullptr to use
+ * the heap.
+ */
+SamplingStats AnalyzeSampling(const double* time, size_t size,
+                              MonotonicArena* arena = nullptr);
+
+/**
+ * Resamples rows of samples onto a uniform grid by linear interpolation.
+ * Column 0 holds the timestamps, which must be strictly increasing, and the
+ * grid starts at the first one. No samples are made inside of gaps, so the
+ * grid only resumes once the samples do.
+ *
+ * The interpolation is done in two passes: the first finds the interval and
+ * weight of each grid point, and the second interpolates all of the columns
+ * of each row at once, which the compiler can vectorize because the columns
+ * are contiguous.
+ *
+ * @param rows The samples to resample, as a vector of arrays. The result uses
+ * the same allocator.
+ * @param period The period of the grid.
+ * @param maxGap The longest interval to interpolate across.
+ * @param arena The arena to allocate scratch memory from, or nullptr to use
+ * the heap.
+ */
+template <typename Rows>
+Rows ResampleUniform(const Rows& rows, double period, double maxGap,
+                     MonotonicArena* arena = nullptr) {
+  if (rows.size() < 2 || !(period > 0)) return rows;
+
+  // Find the interval that each grid point falls in.
+  double start = rows.front()[0];
+  double end = rows.back()[0];
+  ArenaVector<size_t> index{ArenaAllocator<size_t>(arena)};
+  ArenaVector<double> weight{ArenaAllocator<double>(arena)};
+  index.reserve(static_cast<size_t>((end - start) / period) + 1);
+  weight.reserve(index.capacity());
+
+  size_t i = 0;
+  for (size_t k = 0;; ++k) {
+    double t = start + k * period;
+    if (t > end) break;
+    while (i + 2 < rows.size() && rows[i + 1][0] < t) ++i;
+
+    double dt = rows[i + 1][0] - rows[i][0];
+    if (dt > maxGap) continue;
+    index.push_back(i);
+    weight.push_back(std::clamp((t - rows[i][0]) / dt, 0.0, 1.0));
+  }
+
+  // Interpolate each row between the samples around it.
+  Rows result(index.size(), rows.get_allocator());
+  for (size_t k = 0; k < index.size(); ++k) {
+    const auto& a = rows[index[k]];
+    const auto& b = rows[index[k] + 1];
+    double w = weight[k];
+    for (size_t col = 0; col < a.size(); ++col)
+      result[k][col] = a[col] + w * (b[col] - a[col]);
+  }
+  return result;
+}
+}  // namespace frcchar
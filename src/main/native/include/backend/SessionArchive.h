@@ -0,0 +1,137 @@
+// MIT License
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <wpi/StringRef.h>
+#include <wpi/json.h>
+
+namespace frcchar {
+/**
+ * The raw samples of one test of a characterization run, stored by column.
+ */
+struct SessionTest {
+  std::string name;
+  std::vector<std::vector<double>> columns;
+
+  /**
+   * Returns the number of samples in the test.
+   */
+  size_t Size() const { return columns.empty() ? 0 : columns[0].size(); }
+};
+
+/**
+ * A characterization run, as read from a session archive.
+ */
+struct Session {
+  // Everything in the data JSON other than the samples of the tests (e.g.
+  // the project type and units per rotation).
+  wpi::json settings;
+
+  std::vector<SessionTest> tests;
+
+  /**
+   * Returns the test with the given name, or nullptr if there is none.
+   */
+  const SessionTest* Find(wpi::StringRef name) const;
+};
+
+/**
+ * The size of a session archive compared to the raw samples in it, along with
+ * how long it took to decode.
+ */
+struct ArchiveStats {
+  // The size of the samples as doubles, and the size of the archive file.
+  size_t rawBytes = 0;
+  size_t archiveBytes = 0;
+
+  // The time spent decoding the samples, in seconds.
+  double decodeTime = 0.0;
+
+  /**
+   * Returns how many times smaller the archive is than the samples.
+   */
+  double CompressionRatio() const {
+    return archiveBytes > 0 ? static_cast<double>(rawBytes) / archiveBytes
+                            : 0.0;
+  }
+
+  /**
+   * Returns how fast the samples were decoded, in bytes of samples per second.
+   */
+  double DecodeThroughput() const {
+    return decodeTime > 0 ? rawBytes / decodeTime : 0.0;
+  }
+};
+
+// The file extension of session archives.
+constexpr const char* kArchiveExtension = ".frcchar";
+
+/**
+ * Returns whether the path refers to a session archive rather than a JSON.
+ */
+bool IsSessionArchive(wpi::StringRef path);
+
+/**
+ * Writes the data JSON of a characterization run to a compressed session
+ * archive. Every member of the JSON whose value is an array is stored as a
+ * test, with one column per element of its samples.
+ *
+ * Each column is quantized to a resolution of 1e-6 (a microsecond for the
+ * timestamps), which is well below the resolution of the sensors, and split
+ * into blocks of samples. Within each block, the column is stored as its
+ * values, first differences, or second differences, whichever is the
+ * smallest, as zigzag varints. Near-uniform timestamps and smooth positions
+ * have second differences close to zero, so they take only one or two bytes
+ * per sample. Each block has a CRC-32 so that corruption is detected
+ * when the archive is read.
+ *
+ * @param json The data JSON.
+ * @param path The path of the archive to write.
+ * @return The size of the archive compared to the samples in it.
+ * @throws std::runtime_error if the archive could not be written.
+ */
+ArchiveStats WriteSessionArchive(const wpi::json& json,
+                                 const std::string& path);
+
+/**
+ * Encodes the samples of one test in the format used by session archives.
+ * This is the building block of both session archives and run archives (see
+ * RunArchive).
+ *
+ * @param name The name of the test.
+ * @param samples The samples of the test, as an array of arrays.
+ * @param out The bytes to append the encoded test to.
+ * @return The size of the samples as doubles.
+ * @throws std::runtime_error if the samples can't be encoded.
+ */
+size_t EncodeSessionTest(const std::string& name, const wpi::json& samples,
+                         std::vector<uint8_t>* out);
+
+/**
+ * Decodes tests that were encoded back to back by EncodeSessionTest(). The
+ * blocks of all of the tests are decoded in parallel.
+ *
+ * @param data The encoded tests.
+ * @param size The size of the encoded tests in bytes.
+ * @param count The number of tests.
+ * @throws std::runtime_error if the tests are corrupt.
+ */
+std::vector<SessionTest> DecodeSessionTests(const uint8_t* data, size_t size,
+                                            size_t count);
+
+/**
+ * Reads a session archive. The blocks are independent, so they are decoded
+ * in parallel directly into the columns of the tests.
+ *
+ * @param path The path of the archive to read.
+ * @param stats The size of the archive and the time taken to decode it.
+ * @throws std::runtime_error if the archive could not be read or is corrupt.
+ */
+Session ReadSessionArchive(const std::string& path,
+                           ArchiveStats* stats = nullptr);
+}  // namespace frcchar
@@ -0,0 +1,97 @@
+// MIT License
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+#include <ntcore_cpp.h>
+#include <units/frequency.h>
+#include <units/length.h>
+#include <units/time.h>
+#include <units/velocity.h>
+#include <units/voltage.h>
+
+#include "backend/DataProcessor.h"
+
+namespace frcchar {
+/**
+ * A simulated mechanism that stands in for a robot running the
+ * characterization project. It runs a NetworkTables server on localhost, so
+ * the Logger connects to it with a team number of zero. It applies the
+ * voltage commands that the Logger sends and publishes telemetry in the same
+ * format as the robot.
+ *
+ * Each side of the mechanism is a position system identified from Kv and Ka,
+ * discretized at the simulation rate, with Ks acting as Coulomb friction.
+ * Gaussian noise is added to the measured velocities, and the measured
+ * positions and velocities can be delayed to model sensor latency. It
+ * answers the pings of LatencyProbe like the robot does.
+ *
+ * Unlike the robot, which publishes one sample per update of the telemetry
+ * entry, the samples are published in batches of kPublishPeriod, since
+ * NetworkTables would otherwise merge the updates of faster simulations.
+ */
+class SimulatedMechanism {
+ public:
+  /**
+   * A struct that represents the parameters of the simulation.
+   */
+  struct Parameters {
+    units::volt_t Ks = 0.5_V;
+    units::Kv_t Kv = 2_V / 1_mps;
+    units::Ka_t Ka = 0.3_V / 1_mps_sq;
+
+    // The standard deviation of the velocity measurement noise.
+    units::meters_per_second_t noise = 0.001_mps;
+
+    // The delay of the position and velocity measurements.
+    units::second_t latency = 0_s;
+
+    // The rate at which the mechanism is simulated and telemetry is sent.
+    units::hertz_t rate = 200_Hz;
+
+    // Whether to simulate both sides of a drivetrain, along with a gyro.
+    bool drivetrain = false;
+    units::meter_t trackWidth = 0.6_m;
+  };
+
+  // The fastest rate at which the mechanism can be simulated.
+  static constexpr auto kMaxRate = 1000_Hz;
+
+  // The period at which batches of samples are published, which is longer
+  // than the update period of NetworkTables so that every batch is sent.
+  static constexpr auto kPublishPeriod = 20_ms;
+
+  /**
+   * Starts simulating the mechanism on a background thread.
+   *
+   * @param params The parameters of the simulation.
+   * @param port The port of the NetworkTables server.
+   */
+  explicit SimulatedMechanism(const Parameters& params,
+                              unsigned int port = NT_DEFAULT_PORT);
+  ~SimulatedMechanism();
+
+  SimulatedMechanism(const SimulatedMechanism&) = delete;
+  SimulatedMechanism& operator=(const SimulatedMechanism&) = delete;
+
+  /**
+   * Returns the number of telemetry samples that have been published.
+   */
+  size_t GetSamples() const { return m_samples; }
+
+ private:
+  /**
+   * Runs the simulation loop until the simulation is stopped.
+   */
+  void Run();
+
+  Parameters m_params;
+  NT_Inst m_inst;
+  std::atomic<bool> m_running{true};
+  std::atomic<size_t> m_samples{0};
+  std::thread m_thread;
+};
+}  // namespace frcchar
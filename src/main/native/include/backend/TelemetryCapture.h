@@ -0,0 +1,145 @@
+// MIT License
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <ntcore_cpp.h>
+
+#include "backend/LatencyProbe.h"
+
+namespace frcchar {
+/**
+ * Captures the telemetry that the robot publishes over NetworkTables. Every
+ * update of the telemetry entry is kept, along with statistics that show how
+ * fast samples arrive and how many of them were lost on the way. An update
+ * may hold several samples one after another (see SimulatedMechanism).
+ *
+ * Lost samples are detected from the robot timestamps: the nominal period is
+ * estimated from the first samples, and any larger gap between consecutive
+ * samples counts as the number of periods that are missing from it.
+ *
+ * Once the offset between the robot and host clocks is known (see
+ * LatencyProbe), the samples are moved onto the host clock, and the time each
+ * one took to arrive is measured. The host clock counts from the Unix epoch,
+ * so the moved timestamps count from the host time at which the offset was
+ * set instead, which keeps them small.
+ */
+class TelemetryCapture {
+ public:
+  // A single telemetry sample, in the same format as the data JSON.
+  static constexpr size_t kSampleSize = 10;
+  using Sample = std::array<double, kSampleSize>;
+
+  // The name of the entry that the robot publishes telemetry to.
+  static constexpr const char* kTelemetryEntry = "/robot/telemetry";
+
+  // The names of the entries that the robot reads its commands from. The
+  // autospeed is the fraction of the battery voltage to apply, and rotate
+  // makes a drivetrain turn in place instead of driving straight.
+  static constexpr const char* kAutospeedEntry = "/robot/autospeed";
+  static constexpr const char* kRotateEntry = "/robot/rotate";
+
+  /**
+   * Starts listening for telemetry on the given NetworkTables instance.
+   *
+   * @param inst The instance to listen on.
+   */
+  explicit TelemetryCapture(NT_Inst inst);
+  ~TelemetryCapture();
+
+  TelemetryCapture(const TelemetryCapture&) = delete;
+  TelemetryCapture& operator=(const TelemetryCapture&) = delete;
+
+  /**
+   * Adds all of the samples that have arrived since the last call. If none
+   * have, this waits up to the given number of seconds for one to arrive. With
+   * no timeout, this never blocks, so it is safe to call once per frame.
+   * Samples that arrive between calls are queued by NetworkTables.
+   *
+   * @param timeout The longest time to wait for a sample, in seconds.
+   */
+  void Poll(double timeout = 0);
+
+  /**
+   * Discards all captured samples and statistics.
+   */
+  void Reset();
+
+  /**
+   * Sets the time of the robot clock minus the time of the host clock, which
+   * moves the samples that arrive from now on onto the host clock. Their
+   * timestamps count from the current host time. Without an offset, the
+   * samples keep the timestamps of the robot.
+   */
+  void SetClockOffset(std::optional<double> offset);
+
+  /**
+   * Returns the value that is subtracted from the robot timestamps, i.e. the
+   * clock offset plus the host time that the timestamps count from, or
+   * nothing if no clock offset is set.
+   */
+  std::optional<double> GetTimestampShift() const;
+
+  const std::vector<Sample>& GetSamples() const { return m_samples; }
+
+  /**
+   * Returns the number of samples that were received per second, measured
+   * over the last second.
+   */
+  double GetRate() const { return m_rate; }
+
+  /**
+   * Returns the number of samples that are missing from the capture.
+   */
+  size_t GetDropped() const { return m_dropped; }
+
+  /**
+   * Returns the statistics of the time in seconds between the robot taking
+   * a sample and the host receiving it. This is only measured while a clock
+   * offset is set.
+   */
+  const RunningStats& GetDeliveryDelay() const { return m_deliveryDelay; }
+
+ private:
+  /**
+   * Adds a single sample and checks the gap to the previous one.
+   */
+  void AddSample(const Sample& sample);
+
+  /**
+   * Counts the samples that are missing from a gap between two samples.
+   */
+  void CountDropped(double dt);
+
+  NT_EntryListenerPoller m_poller;
+  std::vector<Sample> m_samples;
+
+  // The clock offset, the host time that the moved timestamps count from,
+  // and the delays of the samples that were moved.
+  std::optional<double> m_clockOffset;
+  double m_hostOrigin = 0.0;
+  RunningStats m_deliveryDelay;
+
+  // Drop detection. The gaps are buffered until the period is known.
+  double m_period = 0.0;
+  std::vector<double> m_gaps;
+  size_t m_dropped = 0;
+
+  // Rate measurement.
+  std::chrono::steady_clock::time_point m_windowStart =
+      std::chrono::steady_clock::now();
+  size_t m_windowSamples = 0;
+  double m_rate = 0.0;
+
+  // The number of gaps used to estimate the nominal period.
+  static constexpr size_t kPeriodSamples = 32;
+
+  // Gaps longer than this are the pause between two tests.
+  static constexpr double kMaxGap = 1.0;
+};
+}  // namespace frcchar
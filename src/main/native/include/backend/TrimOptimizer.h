@@ -0,0 +1,89 @@
+// MIT License
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "backend/Arena.h"
+#include "backend/PreparedData.h"
+
+namespace frcchar {
+/**
+ * A segment of prepared data that the trim optimizer may cut. The samples of
+ * a quasistatic segment are cut where the velocity is at or below the motion
+ * threshold, and a dynamic segment is cut at its start, while the step
+ * voltage is still accelerating the mechanism.
+ */
+struct TrimSegment {
+  std::string name;
+  const PreparedData* data;
+  bool quasistatic;
+};
+
+/**
+ * The fit quality (adjusted r-squared) of each candidate value of one cut
+ * point, with the other cut points at their chosen values, along with the
+ * index of the chosen value.
+ */
+struct TrimCurve {
+  std::string name;
+  std::vector<double> values;
+  std::vector<double> rSquared;
+  size_t chosen = 0;
+};
+
+/**
+ * A struct that represents the cut points chosen by OptimizeTrim().
+ */
+struct TrimResult {
+  // The motion threshold of the quasistatic segments.
+  double threshold = 0.0;
+
+  // The index of the first sample that is kept of each segment. This is zero
+  // for quasistatic segments.
+  std::vector<size_t> starts;
+
+  // The fit quality of all segments with the chosen cuts.
+  double rSquared = std::nan("");
+
+  // The fit quality of each candidate threshold, and of each candidate start
+  // of each dynamic segment. The values of a start are the time from the
+  // start of the segment in seconds.
+  TrimCurve thresholdCurve;
+  std::vector<TrimCurve> startCurves;
+};
+
+// The largest fraction of a segment that a cut may remove.
+constexpr double kMaxTrimFraction = 0.25;
+
+// The number of candidate motion thresholds.
+constexpr size_t kThresholdCandidates = 64;
+
+/**
+ * Chooses the motion threshold of the quasistatic segments and the start of
+ * each dynamic segment so that the regression of all segments together fits
+ * as well as possible (i.e. has the highest adjusted r-squared).
+ *
+ * The regression sums of every candidate cut are built once, as suffix sums:
+ * in order of speed for quasistatic segments, and in order of time for
+ * dynamic ones. The sums of any combination of cuts are then the sum of one
+ * suffix per segment, so each candidate costs O(1) instead of a pass over the
+ * samples. The cut points are optimized one at a time with the others held
+ * fixed until none of them changes.
+ *
+ * Neither cut may remove more than kMaxTrimFraction of a segment, and a
+ * dynamic segment is never cut after the peak of its acceleration, since a
+ * fit to a small or uninformative part of the data can be better without
+ * telling more about the mechanism.
+ *
+ * @param segments The segments to cut.
+ * @param arena The arena that the suffix sums are stored in, or nullptr to
+ * use the heap.
+ * @return The cut points.
+ */
+TrimResult OptimizeTrim(const std::vector<TrimSegment>& segments,
+                        MonotonicArena* arena = nullptr);
+}  // namespace frcchar
@@ -2,12 +2,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
 
+#include <imgui.h>
+#include <implot.h>
 #include <portable-file-dialogs.h>
 
+#include "backend/Bootstrap.h"
 #include "backend/DataProcessor.h"
+#include "backend/FeedbackGains.h"
+#include "backend/FileWatcher.h"
+#include "backend/FitDiagnostics.h"
+#include "backend/GainDrift.h"
+#include "backend/LQRSweep.h"
+#include "backend/MinMaxPyramid.h"
 
 namespace frcchar {
 /**
@@ -28,6 +43,102 @@ class Analyzer {
    */
   void OpenData();
 
+  /**
+   * Creates a new data processor for the opened JSON and calculates the
+   * gains. If the file cannot be loaded, the error is shown instead.
+   */
+  void LoadData();
+
+  /**
+   * Checks whether the opened JSON has changed and, if it has, adds the new
+   * data and recalculates the gains.
+   */
+  void WatchData();
+
+  /**
+   * Displays how regularly the opened data was sampled.
+   */
+  void DisplaySampling();
+
+  /**
+   * Displays the cut points chosen by the trim optimizer, if it is enabled,
+   * along with a popup that plots the fit of every candidate cut point.
+   */
+  void DisplayTrim();
+
+  /**
+   * Displays the buttons that save the opened JSON as a compressed session
+   * archive next to it, or add it to the run archive in the same folder,
+   * along with the result of the last save.
+   */
+  void DisplayArchive();
+
+  /**
+   * Displays the runs of the opened run archive, so that one of them can be
+   * chosen for analysis.
+   */
+  void DisplayRuns();
+
+  /**
+   * Rebuilds the time-domain plot data of the selected data set in the
+   * background. This should be called whenever the data changes.
+   */
+  void UpdateTimeSeries();
+
+  /**
+   * Runs the analysis of the loaded data, if there is any, and recalculates
+   * the gains of the controller presets from its gains. This should be
+   * called whenever the data or the gain settings change.
+   */
+  void UpdateGains();
+
+  /**
+   * Displays the time-domain plots of voltage, velocity, and acceleration for
+   * each test in the selected data set.
+   */
+  void DisplayTimeDomainPlots();
+
+  /**
+   * Displays the residual diagnostics of the feedforward fit. These are
+   * calculated in the background while the popup is open.
+   */
+  void DisplayDiagnostics();
+
+  /**
+   * Cancels the calculation of the diagnostics, if there is one.
+   */
+  void CancelDiagnostics();
+
+  /**
+   * Displays the gains of a sliding time window of each test against time,
+   * which are calculated in the background while the popup is open.
+   */
+  void DisplayDrift();
+
+  /**
+   * Displays the feedback gains of every motor controller preset together.
+   * They are calculated when the popup is opened.
+   */
+  void DisplayPresets();
+
+  /**
+   * Displays the LQR parameter sweep popup, which runs the sweep in the
+   * background and shows the resulting gains as a heatmap.
+   */
+  void DisplaySweep();
+
+  /**
+   * Marks the bootstrap confidence intervals as out of date, including those
+   * of a bootstrap that is still running.
+   */
+  void InvalidateBootstrap();
+
+  /**
+   * Displays the bootstrap confidence intervals of the gains, along with the
+   * settings and button used to calculate them in the background.
+   */
+  void DisplayBootstrap();
+
   std::unique_ptr<pfd::open_file> m_fileOpener;
   std::string m_fileLocation;
   std::string m_modifiedLocation;
@@ -36,9 +147,109 @@ class Analyzer {
 
   std::unique_ptr<DataProcessor> m_processor;
 
+  // Why the opened file could not be loaded, if it could not.
+  std::string m_loadError;
+
+  bool m_watchFile = false;
+  std::unique_ptr<FileWatcher> m_watcher;
+
+  bool m_compactStorage = false;
+
+  // Whether to estimate velocity and acceleration with the smoother, and its
+  // bandwidth in Hz.
+  bool m_smoothing = false;
+  double m_smoothingBandwidth = 10.0;
+
+  // Whether to resample the tests onto a uniform grid.
+  bool m_resample = false;
+
+  // Whether to choose the trim of the tests by how well they fit.
+  bool m_optimizeTrim = false;
+
+  // The archive that is being written in the background, and the result of
+  // the last one.
+  std::future<std::string> m_archiveJob;
+  std::string m_archiveStatus;
+
+  // The name of the robot that runs are added to run archives under.
+  std::string m_robotName;
+
+  // The runs of the opened run archive, and the one being analyzed.
+  std::vector<std::string> m_runNames;
+  int m_run = 0;
+  ImGuiTextFilter m_runFilter;
+
   DataProcessor::FFGains m_ffGains{0_V, 0_V / 1_mps, 0_V / 1_mps_sq, 0.0};
   DataProcessor::FBGains m_fbGains{0.0, 0.0};
   DataProcessor::GainPreset m_preset{true, 20_ms, 0_s, 1 / 1_V, true};
   DataProcessor::LQRParameters m_params{1_m, 1.5_mps, 7_V};
+
+  // Time-domain plot data for each test in the selected data set. The x axes
+  // of the plots are linked through the time range.
+  struct TimeSeries {
+    std::string name;
+    MinMaxPyramid voltage, velocity, acceleration;
+  };
+  std::vector<TimeSeries> m_timeSeries;
+  std::future<std::vector<TimeSeries>> m_timeSeriesStatus;
+  bool m_timeSeriesDirty = false;
+  bool m_timeFit = false;
+  double m_timeRange[2] = {0.0, 1.0};
+  std::vector<double> m_plotX, m_plotY;
+
+  // The points of the voltage-domain plot, which are rebuilt when they are no
+  // longer valid and the popup is open.
+  std::vector<ImPlotPoint> m_voltagePoints;
+  bool m_voltagePointsValid = false;
+
+  // Fit diagnostics, cached for each data set and set of gains.
+  struct DiagnosticsKey {
+    int dataset;
+    double Ks, Kv, Ka;
+
+    bool operator<(const DiagnosticsKey& other) const {
+      return std::tie(dataset, Ks, Kv, Ka) <
+             std::tie(other.dataset, other.Ks, other.Kv, other.Ka);
+    }
+  };
+  static constexpr size_t kMaxCachedDiagnostics = 8;
+  std::map<DiagnosticsKey, std::shared_ptr<const FitDiagnostics>>
+      m_diagnostics;
+  DiagnosticsKey m_diagnosticsJob{};
+  std::shared_ptr<std::atomic<bool>> m_diagnosticsCancel;
+  std::future<std::shared_ptr<const FitDiagnostics>> m_diagnosticsStatus;
+
+  // Gain drift settings and results. The results are recalculated when they
+  // are no longer valid and the popup is open.
+  double m_driftWindow = 5.0;
+  bool m_driftValid = false;
+  GainDrift m_drift;
+  std::future<GainDrift> m_driftStatus;
+
+  // The feedback gains of each controller preset.
+  PresetGains m_presetGains;
+
+  // LQR parameter sweep settings and results. The heatmaps store the Kp and Kd
+  // grids with the rows flipped, since ImPlot draws the first row at the top.
+  SweepAxis m_sweepX{SweepAxis::kQp, 0.05, 2.0, 100};
+  SweepAxis m_sweepY{SweepAxis::kQv, 0.1, 4.0, 100};
+  int m_sweepGain = 0;
+  std::future<std::pair<SweepResult, double>> m_sweepStatus;
+  SweepResult m_sweep;
+  double m_sweepDuration = 0.0;
+  std::vector<double> m_sweepHeatmaps[2];
+  std::unique_ptr<pfd::save_file> m_sweepSaver;
+  std::string m_sweepExportStatus;
+
+  // Bootstrap settings and results. The generation counts the changes of the
+  // data and parameters, so that the result of a job that was started before
+  // one of them can be discarded.
+  int m_bootstrapReplicates = 2000;
+  int m_bootstrapSeed = 0;
+  bool m_bootstrapValid = false;
+  int m_bootstrapGeneration = 0;
+  int m_bootstrapJobGeneration = 0;
+  BootstrapResult m_bootstrap;
+  std::future<BootstrapResult> m_bootstrapStatus;
 };
 }  // namespace frcchar
@@ -0,0 +1,57 @@
+// MIT License
+
+#pragma once
+
+#include <functional>
+
+#include "backend/AllocationCounter.h"
+
+namespace glass {
+class Window;
+}  // namespace glass
+
+namespace frcchar {
+/**
+ * Measures the heap allocations and the CPU time of the display function of
+ * each GUI window on every frame, and shows them in the "Frame Audit" window.
+ * The allocations are counted by the global operator new (see
+ * GetThreadAllocations()), so allocations that Dear ImGui makes through its
+ * own allocator are not included. The CPU time is that of the GUI thread
+ * where the platform has a per-thread CPU clock, and the wall-clock time
+ * otherwise.
+ *
+ * In steady state (i.e. when nothing is being loaded, saved, or clicked), the
+ * windows should not allocate at all, so any window that allocates on most
+ * frames is highlighted.
+ */
+class FrameAudit {
+ public:
+  /**
+   * Adds the audit window to the GUI. It is hidden until it is shown from the
+   * Widgets menu.
+   */
+  static void Initialize();
+
+  /**
+   * Adds a window to the window manager of the GUI, and measures its display
+   * function on every frame.
+   *
+   * @param name The ID of the window, which it is also shown under in the
+   * audit.
+   * @param display The display function of the window.
+   * @return The window.
+   */
+  static glass::Window* AddWindow(const char* name,
+                                  std::function<void()> display);
+
+  /**
+   * Calls the function with the name of each window, the number of frames
+   * that it has been displayed in, and the allocations of its display
+   * function on the last of them. This lets the frame allocation test check
+   * the windows without the audit window.
+   */
+  static void ForEachWindow(
+      const std::function<void(const char* name, size_t frames,
+                               const AllocationCount& allocations)>& func);
+};
+}  // namespace frcchar
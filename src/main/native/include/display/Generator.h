@@ -51,7 +51,6 @@ class Generator {
 
   static const char* kProjectTypes[];
   static const char* kGyros[];
-  static const char* kMotorControllers[];
 
   int* m_teamNumber = nullptr;
   int m_projectType = 0;
@@ -0,0 +1,41 @@
+// MIT License
+
+#pragma once
+
+namespace frcchar {
+/**
+ * Lowers the frame rate of the GUI when nothing is happening. After a second
+ * without any activity, each frame waits for an event (or a short timeout)
+ * before it is drawn, so an idle window uses almost no CPU.
+ *
+ * Activity is user input, as well as anything that calls Wake() or
+ * KeepAwake(): NetworkTables updates, background jobs that finish or produce
+ * output, and tests that are running.
+ */
+class IdleThrottle {
+ public:
+  /**
+   * Adds the throttle to the main loop of the GUI. This must be called after
+   * the GUI has been initialized.
+   */
+  static void Initialize();
+
+  /**
+   * Wakes the GUI up and draws frames at the full rate for at least another
+   * second. This can be called from any thread.
+   */
+  static void Wake();
+
+  /**
+   * Keeps the GUI from becoming idle during the next frame. This should be
+   * called every frame by anything that needs to be updated continuously.
+   */
+  static void KeepAwake();
+
+  /**
+   * Displays the frame time and CPU usage, along with a menu to turn the
+   * throttle on or off. This is meant to be shown in the main menu bar.
+   */
+  static void DisplayMenu();
+};
+}  // namespace frcchar
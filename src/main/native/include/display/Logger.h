@@ -5,14 +5,20 @@
 #include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
+#include <ntcore_cpp.h>
 #include <portable-file-dialogs.h>
 
+#include "backend/CaptureSession.h"
+#include "backend/SimulatedMechanism.h"
+
 namespace frcchar {
 /**
  * The logger GUI takes care of running the characterization tests over
  * NetworkTables and logging the data. This data is then stored in a JSON file
- * which can be used for analysis.
+ * which can be used for analysis. Several robots can be logged at once, each
+ * in its own tab with its own CaptureSession.
  */
 class Logger {
  public:
@@ -28,22 +34,82 @@ class Logger {
   void UpdateProjectType(const std::string& type);
 
  private:
+  /**
+   * A struct that represents the tab of one robot: its capture session, the
+   * server that it connects to, and the save of its data.
+   */
+  struct RobotTab {
+    std::unique_ptr<CaptureSession> session;
+
+    // The ID of the tab, which stays the same when the robot is renamed, and
+    // the label of the tab, which is the name followed by the ID.
+    int id;
+    std::string name;
+    std::string label;
+    int team;
+    int port = NT_DEFAULT_PORT;
+
+    // The data file that is being written in the background, and the result
+    // of the last one.
+    std::future<std::string> saveJob;
+    std::string saveStatus;
+  };
+
+  /**
+   * Adds a tab for another robot, which connects to the given team.
+   */
+  void AddRobot(int team);
+
+  /**
+   * Connects the robot of a tab to the server that is set in it.
+   */
+  void ConnectRobot(RobotTab* robot);
+
+  /**
+   * Displays the connection, capture, and tests of the robot of a tab.
+   */
+  void DisplayRobot(RobotTab* robot);
+
+  /**
+   * Displays the tests, along with the buttons used to start and stop them.
+   */
+  void DisplayTests(RobotTab* robot, bool connected);
+
+  /**
+   * Displays the latency and clock offset measured by pinging the robot,
+   * along with the button used to start measuring them.
+   */
+  void DisplayLatency(RobotTab* robot,
+                      const CaptureSession::Status& status);
+
+  /**
+   * Displays the settings of the simulated mechanism, along with the button
+   * used to start it.
+   */
+  void DisplaySimulation();
+
   /**
    * Selects the folder where the JSON file will be saved.
    */
   void SelectDataFolder();
 
   /**
-   * Creates the data file from the logged data.
+   * Starts writing the data file of a robot in the background.
    */
-  void CreateDataFile();
+  void SaveData(RobotTab* robot);
 
- private:
-  // NT Connection State
-  bool m_ntNeedsReset = true;
-  bool m_ntConnectionStatus = false;
+  // Robots. Each one has a tab, and the selected one is the one that the
+  // simulation connects to.
+  std::vector<RobotTab> m_robots;
+  size_t m_selectedRobot = 0;
+  int m_nextRobotId = 0;
+
+  // Simulation
+  SimulatedMechanism::Parameters m_simulationParams;
+  std::unique_ptr<SimulatedMechanism> m_simulation;
 
-  // Project Settings
+  // Project Settings. The stored team number is the one that was last
+  // connected to, which new tabs start with.
   std::string m_projectType = "Drivetrain";
   int* m_teamNumber = nullptr;
   std::unique_ptr<pfd::select_folder> m_folderSelector;
@@ -51,13 +117,11 @@ class Logger {
   // Folder locations for the JSON files.
   std::string m_fileLocation;
   std::string m_modifiedLocation;
+  double m_unitsPerRotation = 1.0;
 
   // Voltage Settings
   float m_quasistaticRampVoltage = 0.25f;
   float m_dynamicStepVoltage = 6.0f;
   float m_rotationVoltage = 2.0f;
-
-  // Modal Popup Storage
-  const char* m_openedPopup = "";
 };
 }  // namespace frcchar
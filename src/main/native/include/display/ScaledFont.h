@@ -0,0 +1,35 @@
+// MIT License
+
+#pragma once
+
+#include <imgui.h>
+
+namespace frcchar {
+/**
+ * Scales the current font for the widgets that are drawn during the lifetime
+ * of this object. Unlike pushing a scaled copy of the font, this does not copy
+ * the glyph tables of the font on every frame.
+ */
+class ScaledFont {
+ public:
+  explicit ScaledFont(float scale)
+      : m_font(ImGui::GetFont()), m_scale(m_font->Scale) {
+    m_font->Scale *= scale;
+    ImGui::PushFont(m_font);
+  }
+
+  ~ScaledFont() {
+    // Popping the font recalculates the size of the font below it, which is
+    // the same font, so the scale has to be restored first.
+    m_font->Scale = m_scale;
+    ImGui::PopFont();
+  }
+
+  ScaledFont(const ScaledFont&) = delete;
+  ScaledFont& operator=(const ScaledFont&) = delete;
+
+ private:
+  ImFont* m_font;
+  float m_scale;
+};
+}  // namespace frcchar
@@ -0,0 +1,338 @@
+// MIT License
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ntcore_cpp.h>
+#include <wpi/StringRef.h>
+#include <wpi/json.h>
+#include <wpi/raw_istream.h>
+#include <wpi/raw_ostream.h>
+
+// The replay tool reads a characterization JSON and publishes its samples
+// over a local NetworkTables server, in the same format as the robot. This
+// allows the capture in the Logger to be tested without a robot.
+
+namespace {
+constexpr size_t kSampleSize = 10;
+using Sample = std::array<double, kSampleSize>;
+using Clock = std::chrono::steady_clock;
+
+// The tests in the JSON, in the order in which they are run on the robot.
+constexpr const char* kTests[] = {"slow-forward", "fast-forward",
+                                  "slow-backward", "fast-backward",
+                                  "track-width"};
+
+// The entry that the robot publishes telemetry to.
+constexpr const char* kTelemetryEntry = "/robot/telemetry";
+
+// The samples are published in batches, as the robot does. NetworkTables 3
+// only sends the last value of an entry in each update period (10 ms), so
+// there are at least kPublishPeriod between batches. Arrays hold at most 255
+// elements, which limits the number of samples in each batch.
+constexpr auto kPublishPeriod = std::chrono::milliseconds(20);
+constexpr size_t kMaxBatchSamples = 255 / kSampleSize;
+
+// The network identity of the client that counts the delivered samples.
+constexpr const char* kMonitorIdentity = "frc-char-replay monitor";
+
+// How long to wait for the last batches of a replay to be delivered.
+constexpr auto kDeliveryTimeout = std::chrono::seconds(1);
+
+/**
+ * The settings of a replay, which are given on the command line.
+ */
+struct Options {
+  std::string path;
+  unsigned int port = NT_DEFAULT_PORT;
+
+  // The playback rate relative to real time. Zero plays the samples back as
+  // fast as possible.
+  double rate = 1.0;
+
+  // The maximum random delay added to each sample, in seconds.
+  double jitter = 0.0;
+
+  // Every burstPeriod samples, the next burstSize samples are held back and
+  // sent all at once.
+  size_t burstSize = 0;
+  size_t burstPeriod = 100;
+
+  unsigned int seed = 0;
+  bool loop = false;
+};
+
+void PrintUsage() {
+  wpi::errs()
+      << "Usage: frc-char-replay <data.json> [options]\n"
+         "  --rate <factor|max>  Playback rate relative to real time "
+         "(default 1)\n"
+         "  --jitter <ms>        Maximum random delay added to each sample "
+         "(default 0)\n"
+         "  --burst <samples>    Number of samples sent together in each "
+         "burst (default 0)\n"
+         "  --burst-period <n>   Number of samples between bursts "
+         "(default 100)\n"
+         "  --seed <n>           Seed of the jitter (default 0)\n"
+         "  --port <n>           Port of the NetworkTables server "
+         "(default 1735)\n"
+         "  --loop               Replay the data until stopped\n";
+}
+
+/**
+ * Parses the command line. Returns false if it is invalid.
+ */
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    wpi::StringRef arg = argv[i];
+    auto next = [&]() -> const char* {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+
+    if (arg == "--loop") {
+      options->loop = true;
+    } else if (arg.startswith("--")) {
+      const char* value = next();
+      if (!value) return false;
+
+      if (arg == "--rate")
+        options->rate =
+            wpi::StringRef(value) == "max" ? 0.0 : std::atof(value);
+      else if (arg == "--jitter")
+        options->jitter = std::atof(value) / 1000.0;
+      else if (arg == "--burst")
+        options->burstSize = std::strtoul(value, nullptr, 10);
+      else if (arg == "--burst-period")
+        options->burstPeriod = std::strtoul(value, nullptr, 10);
+      else if (arg == "--seed")
+        options->seed = std::strtoul(value, nullptr, 10);
+      else if (arg == "--port")
+        options->port = std::strtoul(value, nullptr, 10);
+      else
+        return false;
+    } else if (options->path.empty()) {
+      options->path = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options->path.empty() && options->rate >= 0 &&
+         options->jitter >= 0 && options->burstPeriod > 0;
+}
+
+/**
+ * Reads the samples of all tests from the JSON. The timestamps of each test
+ * are shifted so that it starts one period after the previous test ends.
+ */
+std::vector<Sample> ReadSamples(const std::string& path) {
+  std::error_code ec;
+  wpi::raw_fd_istream input(path, ec);
+  if (ec) throw std::runtime_error("Could not open " + path);
+
+  wpi::json json;
+  input >> json;
+
+  std::vector<Sample> samples;
+  for (auto&& test : kTests) {
+    auto it = json.find(test);
+    if (it == json.end()) continue;
+
+    auto data = it->get<std::vector<Sample>>();
+    if (data.empty()) continue;
+
+    double offset = 0.0;
+    if (!samples.empty() && data.size() > 1)
+      offset = samples.back()[0] + (data[1][0] - data[0][0]) - data[0][0];
+    for (auto&& sample : data) {
+      sample[0] += offset;
+      samples.push_back(sample);
+    }
+  }
+  return samples;
+}
+
+/**
+ * Counts the samples that arrive at a client of the server, which shows how
+ * many of the published samples are delivered.
+ */
+class DeliveryMonitor {
+ public:
+  explicit DeliveryMonitor(unsigned int port)
+      : m_inst(nt::CreateInstance()),
+        m_poller(nt::CreateEntryListenerPoller(m_inst)) {
+    nt::AddPolledEntryListener(m_poller, kTelemetryEntry,
+                               NT_NOTIFY_NEW | NT_NOTIFY_UPDATE);
+    nt::SetNetworkIdentity(m_inst, kMonitorIdentity);
+    nt::StartClient(m_inst, "127.0.0.1", port);
+  }
+
+  ~DeliveryMonitor() {
+    nt::DestroyEntryListenerPoller(m_poller);
+    nt::DestroyInstance(m_inst);
+  }
+
+  DeliveryMonitor(const DeliveryMonitor&) = delete;
+  DeliveryMonitor& operator=(const DeliveryMonitor&) = delete;
+
+  /**
+   * Waits until the given number of samples have arrived since the last
+   * call, or until no sample has arrived for kDeliveryTimeout, and returns
+   * the number that arrived.
+   */
+  size_t Wait(size_t samples) {
+    size_t delivered = 0;
+    bool timedOut = false;
+    while (delivered < samples && !timedOut) {
+      for (auto&& event : nt::PollEntryListener(
+               m_poller,
+               std::chrono::duration<double>(kDeliveryTimeout).count(),
+               &timedOut)) {
+        if (event.value && event.value->IsDoubleArray())
+          delivered += event.value->GetDoubleArray().size() / kSampleSize;
+      }
+    }
+    return delivered;
+  }
+
+ private:
+  NT_Inst m_inst;
+  NT_EntryListenerPoller m_poller;
+};
+
+/**
+ * The number of samples and batches that a replay sent, and how long it
+ * took.
+ */
+struct ReplayStats {
+  size_t samples = 0;
+  size_t batches = 0;
+  double seconds = 0.0;
+};
+
+/**
+ * Publishes all samples once. The samples that are due at the same time (all
+ * samples of a burst, or all of them without a rate) are sent together in as
+ * few batches as possible.
+ */
+ReplayStats Replay(NT_Inst inst, const std::vector<Sample>& samples,
+                   const Options& options, std::mt19937* rng) {
+  NT_Entry entry = nt::GetEntry(inst, kTelemetryEntry);
+  std::uniform_real_distribution<double> jitter(0.0, options.jitter);
+
+  ReplayStats stats;
+  std::vector<double> batch;
+  auto start = Clock::now();
+  auto sendTime = start;
+  auto lastPublish = start - kPublishPeriod;
+  auto publish = [&] {
+    std::this_thread::sleep_until(lastPublish + kPublishPeriod);
+    nt::SetEntryValue(entry, nt::Value::MakeDoubleArray(batch));
+    nt::Flush(inst);
+    lastPublish = Clock::now();
+    stats.samples += batch.size() / kSampleSize;
+    ++stats.batches;
+    batch.clear();
+  };
+
+  // Returns the index of the last sample that is sent along with the given
+  // one. The samples of a burst are held back until the last one of them is
+  // due, and are then sent all at once.
+  auto dueIndex = [&](size_t i) {
+    if (i % options.burstPeriod >= options.burstSize) return i;
+    return std::min(i - i % options.burstPeriod + options.burstSize - 1,
+                    samples.size() - 1);
+  };
+
+  for (size_t i = 0; i < samples.size(); ++i) {
+    // Wait until the sample is due.
+    size_t due = dueIndex(i);
+    if (options.rate > 0) {
+      double t = (samples[due][0] - samples[0][0]) / options.rate;
+      if (options.jitter > 0) t += jitter(*rng);
+
+      // Never send a sample before the one ahead of it.
+      sendTime = std::max(
+          sendTime, start + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double>(t)));
+      std::this_thread::sleep_until(sendTime);
+    }
+    batch.insert(batch.end(), samples[i].begin(), samples[i].end());
+
+    // Send the batch once it is full, or once the publish period has passed
+    // and no sample that is due along with this one is left.
+    bool last = i + 1 == samples.size();
+    bool held = !last && (options.rate == 0 || dueIndex(i + 1) == due);
+    if (batch.size() == kMaxBatchSamples * kSampleSize || last ||
+        (!held && Clock::now() >= lastPublish + kPublishPeriod))
+      publish();
+  }
+
+  stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return stats;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::vector<Sample> samples;
+  try {
+    samples = ReadSamples(options.path);
+  } catch (const std::exception& e) {
+    wpi::errs() << "[ERROR] " << e.what() << "\n";
+    return 1;
+  }
+  if (samples.empty()) {
+    wpi::errs() << "[ERROR] " << options.path << " contains no samples\n";
+    return 1;
+  }
+
+  // Start a server that only listens on localhost, and send updates as often
+  // as NetworkTables allows.
+  NT_Inst inst = nt::GetDefaultInstance();
+  nt::SetUpdateRate(inst, 0.01);
+  nt::StartServer(inst, "", "127.0.0.1", options.port);
+  DeliveryMonitor monitor(options.port);
+
+  // Returns whether a client other than the monitor is connected.
+  auto hasClient = [&] {
+    for (auto&& connection : nt::GetConnections(inst)) {
+      if (connection.remote_id != kMonitorIdentity) return true;
+    }
+    return false;
+  };
+
+  wpi::outs() << "[INFO] Waiting for a client on port " << options.port
+              << "...\n";
+  wpi::outs().flush();
+  while (!hasClient())
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  std::mt19937 rng(options.seed);
+  do {
+    auto stats = Replay(inst, samples, options, &rng);
+    size_t delivered = monitor.Wait(stats.samples);
+    wpi::outs() << "[INFO] Sent " << stats.samples << " samples in "
+                << stats.batches << " batches in " << stats.seconds << " s ("
+                << stats.samples / stats.seconds << " samples/s), "
+                << delivered << " delivered to a local client ("
+                << stats.samples - std::min(delivered, stats.samples)
+                << " lost)\n";
+    wpi::outs().flush();
+  } while (options.loop && hasClient());
+
+  // Give the last updates time to reach the client.
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  nt::StopServer(inst);
+}
@@ -0,0 +1,341 @@
+// MIT License
+
+#include "AnalysisService.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+#include "backend/DataProcessor.h"
+#include "backend/FeedbackGains.h"
+#include "backend/FileWatcher.h"
+
+using namespace frcchar;
+
+namespace {
+/**
+ * Reads the gain preset of a request. The latency defaults to the measured
+ * one if there is one.
+ */
+DataProcessor::GainPreset ReadPreset(
+    const wpi::json& json, const std::optional<units::second_t>& measured) {
+  DataProcessor::GainPreset preset{true, 20_ms, 0_s, 1 / 1_V, true};
+  if (measured) preset.latency = *measured;
+  if (!json.is_object()) return preset;
+
+  preset.velocity = json.value("velocity", preset.velocity);
+  preset.dt = units::second_t(json.value("dt", preset.dt.to<double>()));
+  preset.latency =
+      units::second_t(json.value("latency", preset.latency.to<double>()));
+  preset.output = decltype(preset.output)(
+      json.value("output", preset.output.to<double>()));
+  preset.normalized = json.value("normalized", preset.normalized);
+  return preset;
+}
+
+/**
+ * Reads the LQR parameters of a request.
+ */
+DataProcessor::LQRParameters ReadParameters(const wpi::json& json) {
+  DataProcessor::LQRParameters params{1_m, 1.5_mps, 7_V};
+  if (!json.is_object()) return params;
+
+  params.qp = units::meter_t(json.value("qp", params.qp.to<double>()));
+  params.qv =
+      units::meters_per_second_t(json.value("qv", params.qv.to<double>()));
+  params.maxEffort =
+      units::volt_t(json.value("maxEffort", params.maxEffort.to<double>()));
+  return params;
+}
+}  // namespace
+
+struct AnalysisService::Entry {
+  std::mutex mutex;
+
+  // The state that the processor refers to.
+  std::string path;
+  DataProcessor::FFGains ff{0_V, 0_V / 1_mps, 0_V / 1_mps_sq, 0.0};
+  DataProcessor::FBGains fb{0.0, 0.0};
+  DataProcessor::GainPreset preset{true, 20_ms, 0_s, 1 / 1_V, true};
+  DataProcessor::LQRParameters params{1_m, 1.5_mps, 7_V};
+  int dataset = 2;
+
+  std::unique_ptr<DataProcessor> processor;
+
+  // The watcher of a file. The samples of a session are kept by its
+  // processor.
+  std::unique_ptr<FileWatcher> watcher;
+
+  // The memory used by the data, and the last time that the entry was used,
+  // both as a counter for the order of the files and as a time for the
+  // timeout of sessions. These are only used while the cache mutex is held.
+  bool session = false;
+  size_t bytes = 0;
+  uint64_t lastUse = 0;
+  Clock::time_point lastTime;
+};
+
+AnalysisService::AnalysisService(size_t threads, size_t cacheBytes)
+    : m_cacheBytes(cacheBytes) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  m_latencies.reserve(kLatencyHistory);
+  for (size_t i = 0; i < threads; ++i)
+    m_workers.emplace_back([this] { Work(); });
+}
+
+AnalysisService::~AnalysisService() {
+  {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_stopping = true;
+  }
+  m_queueCondition.notify_all();
+  for (auto&& worker : m_workers) worker.join();
+}
+
+void AnalysisService::Submit(std::string request, Respond respond) {
+  {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_queue.push({std::move(request), std::move(respond), Clock::now()});
+  }
+  m_queueCondition.notify_one();
+}
+
+wpi::json AnalysisService::GetStats() {
+  wpi::json stats;
+  {
+    std::lock_guard<std::mutex> lock(m_latencyMutex);
+    std::vector<double> latencies = m_latencies;
+    auto percentile = [&](double p) {
+      if (latencies.empty()) return std::nan("");
+      auto it = latencies.begin() +
+                static_cast<size_t>(p * (latencies.size() - 1) + 0.5);
+      std::nth_element(latencies.begin(), it, latencies.end());
+      return *it * 1E3;
+    };
+    stats["requests"] = m_requests;
+    stats["errors"] = m_errors;
+    stats["latencyMs"] = {{"p50", percentile(0.5)},
+                          {"p90", percentile(0.9)},
+                          {"p99", percentile(0.99)},
+                          {"max", percentile(1.0)}};
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    size_t sessions = 0;
+    size_t bytes = 0;
+    for (auto&& entry : m_cache) {
+      if (entry.second->session) ++sessions;
+      bytes += entry.second->bytes;
+    }
+    stats["cache"] = {{"entries", m_cache.size()}, {"sessions", sessions},
+                      {"bytes", bytes},           {"hits", m_hits},
+                      {"misses", m_misses}};
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    stats["queued"] = m_queue.size();
+  }
+  return stats;
+}
+
+wpi::json AnalysisService::Handle(const wpi::json& request) {
+  if (!request.is_object())
+    throw std::runtime_error("A request must be a JSON object.");
+
+  std::string type = request.value("type", "analyze");
+  if (type == "analyze") return Analyze(request);
+  if (type == "stats") return GetStats();
+  if (type == "drop") {
+    std::string key = "session:" + request.at("session").get<std::string>();
+    std::lock_guard<std::mutex> lock(m_cacheMutex);
+    return {{"dropped", m_cache.erase(key) > 0}};
+  }
+  throw std::runtime_error("Unknown request type " + type);
+}
+
+wpi::json AnalysisService::Analyze(const wpi::json& request) {
+  auto path = request.find("path");
+  auto session = request.find("session");
+  bool file = path != request.end();
+  if (file == (session != request.end()))
+    throw std::runtime_error("A request needs either a path or a session.");
+
+  // Files with different options are prepared differently, so they are
+  // cached separately.
+  wpi::json options = request.value("options", wpi::json::object());
+  size_t run = request.value("run", 0u);
+  std::string key =
+      file ? "file:" + path->get<std::string>() + "|" + std::to_string(run) +
+                 "|" + options.dump()
+           : "session:" + session->get<std::string>();
+
+  bool created;
+  auto entry = GetEntry(key, &created);
+  std::unique_lock<std::mutex> lock(entry->mutex);
+
+  try {
+    if (!entry->processor) {
+      // The file is watched before it is read so that no change is missed.
+      if (file) {
+        entry->path = path->get<std::string>();
+        entry->watcher = std::make_unique<FileWatcher>(entry->path);
+      }
+      entry->processor = std::make_unique<DataProcessor>(
+          &entry->path, &entry->ff, &entry->fb, &entry->preset, &entry->params,
+          &entry->dataset, options.value("compact", false), run,
+          options.value("smoothing", 0.0), options.value("resample", false),
+          options.value("optimizeTrim", false));
+    } else if (file && entry->watcher->Poll()) {
+      entry->processor->Refresh();
+    }
+
+    // Only the new batch is given to the processor, which keeps the
+    // samples of the earlier ones.
+    auto samples = request.find("samples");
+    if (!file && samples != request.end())
+      entry->processor->AppendSamples(*samples);
+  } catch (...) {
+    // A file that failed to load is loaded from scratch by the next request.
+    if (created && file) {
+      entry->processor.reset();
+      std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+      auto it = m_cache.find(key);
+      if (it != m_cache.end() && it->second == entry) m_cache.erase(it);
+    }
+    throw;
+  }
+
+  auto& processor = *entry->processor;
+  entry->dataset = std::max(request.value("dataset", 2), 0);
+  entry->preset =
+      ReadPreset(request.value("preset", wpi::json()),
+                 processor.GetMeasuredLatency());
+  entry->params = ReadParameters(request.value("lqr", wpi::json()));
+  processor.Update();
+
+  wpi::json response = {
+      {"ff",
+       {{"Ks", entry->ff.Ks.to<double>()},
+        {"Kv", entry->ff.Kv.to<double>()},
+        {"Ka", entry->ff.Ka.to<double>()},
+        {"rSquared", entry->ff.CoD}}},
+      {"fb", {{"Kp", entry->fb.Kp}, {"Kd", entry->fb.Kd}}},
+      {"latency", entry->preset.latency.to<double>()},
+      {"cached", !created}};
+  if (processor.IsDrivetrain())
+    response["trackWidth"] = processor.GetTrackWidth().to<double>();
+
+  if (request.value("controllers", false)) {
+    auto gains =
+        CalculatePresetGains(entry->ff, entry->preset, entry->params);
+    wpi::json controllers = wpi::json::array();
+    for (size_t i = 0; i < kNumControllerPresets; ++i) {
+      controllers.push_back({{"name", kControllerPresets[i].name},
+                             {"Kp", gains[i].Kp},
+                             {"Kd", gains[i].Kd}});
+    }
+    response["controllers"] = std::move(controllers);
+  }
+
+  size_t bytes = processor.GetMemoryUsage();
+  lock.unlock();
+  {
+    std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+    entry->bytes = bytes;
+  }
+  Evict();
+  return response;
+}
+
+std::shared_ptr<AnalysisService::Entry> AnalysisService::GetEntry(
+    const std::string& key, bool* created) {
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+  auto& entry = m_cache[key];
+  *created = !entry;
+  if (*created) {
+    entry = std::make_shared<Entry>();
+    entry->session = key.compare(0, 8, "session:") == 0;
+    ++m_misses;
+  } else {
+    ++m_hits;
+  }
+  entry->lastUse = ++m_useCounter;
+  entry->lastTime = Clock::now();
+  return entry;
+}
+
+void AnalysisService::Evict() {
+  std::lock_guard<std::mutex> lock(m_cacheMutex);
+
+  // Sessions whose client went away without dropping them time out.
+  auto now = Clock::now();
+  for (auto it = m_cache.begin(); it != m_cache.end();) {
+    if (it->second->session && now - it->second->lastTime > kSessionTimeout)
+      it = m_cache.erase(it);
+    else
+      ++it;
+  }
+
+  for (;;) {
+    size_t bytes = 0;
+    auto oldest = m_cache.end();
+    for (auto it = m_cache.begin(); it != m_cache.end(); ++it) {
+      if (it->second->session) continue;
+      bytes += it->second->bytes;
+      if (oldest == m_cache.end() ||
+          it->second->lastUse < oldest->second->lastUse)
+        oldest = it;
+    }
+    if (bytes <= m_cacheBytes || oldest == m_cache.end()) return;
+
+    // Requests that are using the entry keep it alive until they finish.
+    m_cache.erase(oldest);
+  }
+}
+
+void AnalysisService::RecordLatency(double seconds, bool error) {
+  std::lock_guard<std::mutex> lock(m_latencyMutex);
+  ++m_requests;
+  if (error) ++m_errors;
+  if (m_latencies.size() < kLatencyHistory) {
+    m_latencies.push_back(seconds);
+  } else {
+    m_latencies[m_latencyIndex] = seconds;
+    m_latencyIndex = (m_latencyIndex + 1) % kLatencyHistory;
+  }
+}
+
+void AnalysisService::Work() {
+  for (;;) {
+    Request request;
+    {
+      std::unique_lock<std::mutex> lock(m_queueMutex);
+      m_queueCondition.wait(lock,
+                            [this] { return m_stopping || !m_queue.empty(); });
+      if (m_queue.empty()) return;
+      request = std::move(m_queue.front());
+      m_queue.pop();
+    }
+
+    wpi::json json;
+    wpi::json response;
+    bool error = false;
+    try {
+      json = wpi::json::parse(request.request);
+      response = Handle(json);
+    } catch (const std::exception& e) {
+      response = {{"error", e.what()}};
+      error = true;
+    }
+    if (json.is_object()) {
+      auto id = json.find("id");
+      if (id != json.end()) response["id"] = *id;
+    }
+
+    request.respond(response.dump());
+    std::chrono::duration<double> latency = Clock::now() - request.submitted;
+    RecordLatency(latency.count(), error);
+  }
+}
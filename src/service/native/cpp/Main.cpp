@@ -0,0 +1,378 @@
+// MIT License
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <wpi/StringRef.h>
+#include <wpi/raw_ostream.h>
+
+#include "AnalysisService.h"
+
+// The analysis service answers requests from other tools over a Unix domain
+// socket (see AnalysisService for the protocol). Each request and response is
+// a single line of JSON. Responses may arrive out of order, since requests
+// are processed in parallel, so requests should have an "id".
+
+namespace {
+// The longest request that is accepted, which bounds the memory that a
+// client can use with a request that never ends.
+constexpr size_t kMaxRequestSize = 256 << 20;
+
+// The most output that is queued for a client before its requests are no
+// longer read, which bounds the memory of a client that does not read its
+// responses.
+constexpr size_t kMaxQueuedSize = 16 << 20;
+
+std::atomic<bool> gStop{false};
+
+/**
+ * The settings of the service, which are given on the command line.
+ */
+struct Options {
+  std::string socket = "/tmp/frc-char.sock";
+  size_t threads = 0;
+  size_t cacheMegabytes = 256;
+};
+
+void PrintUsage() {
+  wpi::errs()
+      << "Usage: frc-char-service [options]\n"
+         "  --socket <path>   Path of the Unix domain socket "
+         "(default /tmp/frc-char.sock)\n"
+         "  --threads <n>     Number of worker threads (default one per "
+         "core)\n"
+         "  --cache <MB>      Memory that cached files may use "
+         "(default 256)\n";
+}
+
+/**
+ * Parses the command line. Returns false if it is invalid.
+ */
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    wpi::StringRef arg = argv[i];
+    const char* value = i + 1 < argc ? argv[++i] : nullptr;
+    if (!value) return false;
+
+    if (arg == "--socket")
+      options->socket = value;
+    else if (arg == "--threads")
+      options->threads = std::strtoul(value, nullptr, 10);
+    else if (arg == "--cache")
+      options->cacheMegabytes = std::strtoul(value, nullptr, 10);
+    else
+      return false;
+  }
+  return !options->socket.empty();
+}
+
+/**
+ * Writes a byte to the wake pipe of the poll loop, so that it stops waiting.
+ * If the pipe is full, the loop is already going to wake up.
+ */
+void Wake(int fd) {
+  char byte = 0;
+  while (write(fd, &byte, 1) < 0 && errno == EINTR) {
+  }
+}
+
+/**
+ * Makes the given descriptor non-blocking. Returns false if it fails.
+ */
+bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) >= 0;
+}
+
+/**
+ * A client connection. The workers queue the responses, and the poll loop
+ * writes them once the socket can take them, so a client that reads slowly
+ * never blocks a worker (nor the other clients). The connection stays open
+ * until the responses to all of its requests have been written.
+ */
+class Connection {
+ public:
+  Connection(int fd, int wakeFd) : m_fd(fd), m_wakeFd(wakeFd) {}
+  ~Connection() { close(m_fd); }
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  int GetFd() const { return m_fd; }
+
+  /**
+   * Counts a request that was submitted for the client, whose response is
+   * still to be sent.
+   */
+  void AddRequest() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_pending;
+  }
+
+  /**
+   * Queues the response to a request, and wakes the poll loop up to write it
+   * if nothing was queued before. Responses to clients that have gone away
+   * are dropped.
+   */
+  void Send(const std::string& line) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      --m_pending;
+      if (m_closed) return;
+      bool queued = m_written < m_output.size();
+      m_output += line;
+      m_output += '\n';
+      if (queued) return;
+    }
+    Wake(m_wakeFd);
+  }
+
+  /**
+   * Writes as much of the queued output as the socket takes without
+   * blocking. If the client has gone away, the output is dropped and the
+   * connection is closed.
+   */
+  void Flush() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    while (!m_closed && m_written < m_output.size()) {
+      ssize_t n = write(m_fd, m_output.data() + m_written,
+                        m_output.size() - m_written);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Drop the written part once it is most of the buffer, so the buffer
+        // does not grow while a client keeps up only partially.
+        if (m_written > m_output.size() / 2) {
+          m_output.erase(0, m_written);
+          m_written = 0;
+        }
+        return;
+      }
+      if (n <= 0) {
+        m_closed = true;
+        break;
+      }
+      m_written += n;
+    }
+    m_output.clear();
+    m_written = 0;
+  }
+
+  /**
+   * Closes the connection to a client that has gone away, and drops the
+   * output that is still queued for it.
+   */
+  void Close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+    m_output.clear();
+    m_written = 0;
+  }
+
+  /**
+   * Returns the size of the output that is queued but not written yet.
+   */
+  size_t GetQueuedSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_output.size() - m_written;
+  }
+
+  /**
+   * Returns whether every response has been written, or the client has gone
+   * away.
+   */
+  bool IsDone() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_closed || (m_pending == 0 && m_written == m_output.size());
+  }
+
+  // The data read from the client that does not form a whole line yet, and
+  // whether the client may still send requests. These are only used by the
+  // poll loop.
+  std::string buffer;
+  bool reading = true;
+
+ private:
+  int m_fd;
+  int m_wakeFd;
+  mutable std::mutex m_mutex;
+  std::string m_output;
+  size_t m_written = 0;
+  size_t m_pending = 0;
+  bool m_closed = false;
+};
+
+/**
+ * Creates the listening socket. Only the current user can connect to it,
+ * since requests read files with the permissions of the service. A socket
+ * that was left at the path by a service that did not exit cleanly is
+ * replaced, but not one that a running service listens on, nor a file that
+ * is not a socket.
+ */
+int Listen(const std::string& path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    wpi::errs() << "The socket path is too long.\n";
+    return -1;
+  }
+  std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  auto* addr = reinterpret_cast<sockaddr*>(&address);
+
+  // A socket that nothing listens on refuses connections.
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  if (connect(fd, addr, sizeof(address)) == 0) {
+    wpi::errs() << "A service is already listening on " << path << "\n";
+    close(fd);
+    return -1;
+  }
+  struct stat status;
+  if (errno == ECONNREFUSED && lstat(path.c_str(), &status) == 0 &&
+      S_ISSOCK(status.st_mode))
+    unlink(path.c_str());
+  close(fd);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  mode_t mask = umask(0177);
+  int bound = bind(fd, addr, sizeof(address));
+  umask(mask);
+  if (bound < 0 || listen(fd, 16) < 0 || !SetNonBlocking(fd)) {
+    wpi::errs() << "Could not listen on " << path << ": "
+                << std::strerror(errno) << "\n";
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * Reads what the client has sent and submits each whole line as a request.
+ * Returns false once the client sends no more requests.
+ */
+bool Receive(frcchar::AnalysisService* service,
+             const std::shared_ptr<Connection>& connection) {
+  char data[65536];
+  ssize_t n = read(connection->GetFd(), data, sizeof(data));
+  if (n < 0)
+    return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+  if (n == 0) return false;
+
+  auto& buffer = connection->buffer;
+  size_t start = buffer.size();
+  buffer.append(data, n);
+  size_t begin = 0;
+  for (size_t end = buffer.find('\n', start); end != std::string::npos;
+       end = buffer.find('\n', begin)) {
+    if (end > begin) {
+      connection->AddRequest();
+      service->Submit(buffer.substr(begin, end - begin),
+                      [connection](const std::string& response) {
+                        connection->Send(response);
+                      });
+    }
+    begin = end + 1;
+  }
+  buffer.erase(0, begin);
+  return buffer.size() <= kMaxRequestSize;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 1;
+  }
+
+  std::signal(SIGPIPE, SIG_IGN);
+  std::signal(SIGINT, [](int) { gStop = true; });
+  std::signal(SIGTERM, [](int) { gStop = true; });
+
+  int listener = Listen(options.socket);
+  if (listener < 0) return 1;
+  wpi::outs() << "Listening on " << options.socket << "\n";
+  wpi::outs().flush();
+
+  // The workers wake the poll loop up through this pipe when they queue a
+  // response.
+  int wake[2];
+  if (pipe(wake) < 0 || !SetNonBlocking(wake[0]) || !SetNonBlocking(wake[1])) {
+    wpi::errs() << "Could not create a pipe: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  std::vector<std::shared_ptr<Connection>> connections;
+  {
+    frcchar::AnalysisService service(options.threads,
+                                     options.cacheMegabytes << 20);
+    std::vector<pollfd> fds;
+    while (!gStop) {
+      fds.assign({{listener, POLLIN, 0}, {wake[0], POLLIN, 0}});
+      for (auto&& connection : connections) {
+        // Stop reading the requests of a client that does not read its
+        // responses, until it has caught up.
+        size_t queued = connection->GetQueuedSize();
+        short events = queued > 0 ? POLLOUT : 0;
+        if (connection->reading && queued <= kMaxQueuedSize) events |= POLLIN;
+        fds.push_back({connection->GetFd(), events, 0});
+      }
+
+      // Wake up regularly to check whether the service should stop.
+      if (poll(fds.data(), fds.size(), 200) <= 0) continue;
+
+      if (fds[1].revents & POLLIN) {
+        char data[256];
+        while (read(wake[0], data, sizeof(data)) > 0) {
+        }
+      }
+
+      // A client that closes its end for writing still gets the responses to
+      // its requests, so it is only removed once they have been written, or
+      // once it has gone away entirely.
+      for (size_t i = fds.size() - 1; i > 1; --i) {
+        auto& connection = connections[i - 2];
+        short revents = fds[i].revents;
+        if ((revents & POLLIN) && !Receive(&service, connection))
+          connection->reading = false;
+        if (revents & POLLOUT) connection->Flush();
+        if ((revents & (POLLHUP | POLLERR)) && !connection->reading)
+          connection->Close();
+        if (!connection->reading && connection->IsDone())
+          connections.erase(connections.begin() + (i - 2));
+      }
+
+      if (fds[0].revents & POLLIN) {
+        for (int fd; (fd = accept(listener, nullptr, nullptr)) >= 0;) {
+          if (SetNonBlocking(fd))
+            connections.push_back(std::make_shared<Connection>(fd, wake[1]));
+          else
+            close(fd);
+        }
+      }
+    }
+
+    wpi::outs() << "Statistics:\n" << service.GetStats().dump(2) << "\n";
+  }
+
+  close(wake[0]);
+  close(wake[1]);
+  close(listener);
+  unlink(options.socket.c_str());
+  return 0;
+}
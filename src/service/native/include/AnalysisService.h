@@ -0,0 +1,171 @@
+// MIT License
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <wpi/json.h>
+
+namespace frcchar {
+/**
+ * Answers analysis requests from other tools, so that they can get the gains
+ * of logged data without their own parser and regression. Requests are
+ * processed by a pool of worker threads, and the data that they load is kept
+ * in an in-memory cache so that repeated requests for the same file only
+ * re-read it if it changed.
+ *
+ * Each request is a JSON object, and each response is a JSON object with the
+ * same "id" as its request. An analysis request has either:
+ *   "path": a characterization JSON, session archive, or run archive, along
+ *           with the optional "run" index of a run archive, or
+ *   "session" and "samples": the name of an in-memory data set and a batch of
+ *           samples to add to it, in the format of a characterization JSON.
+ *           The arrays of each test are appended to the ones of the earlier
+ *           batches, and any other values (e.g. "test") replace theirs (see
+ *           DataProcessor::AppendSamples()). A session that gets no request
+ *           for ten minutes is dropped.
+ * The optional "dataset" index (as in DataProcessor), "preset" (velocity,
+ * dt, latency, output, normalized), "lqr" (qp, qv, maxEffort), and
+ * "options" (compact, smoothing, resample, optimizeTrim) default to the ones
+ * of the Analyzer, except that the latency defaults to the measured one if
+ * the data has it. The options of a data set are fixed when it is first
+ * loaded. With "controllers": true, the feedback gains of every controller
+ * preset are returned too.
+ *
+ * The response has "ff", "fb", the "latency" that the feedback gains were
+ * calculated for, "trackWidth" for drivetrains (null if the robot did not
+ * turn enough to estimate it), and whether the data set was "cached", or
+ * "error" if the request failed. A request with "type": "stats" returns the
+ * request latency percentiles and the state of the cache instead, and one
+ * with "type": "drop" removes the given "session".
+ */
+class AnalysisService {
+ public:
+  /**
+   * The function that a response is given to, on the worker thread that
+   * processed the request.
+   */
+  using Respond = std::function<void(const std::string&)>;
+
+  /**
+   * Starts the worker threads of the service.
+   *
+   * @param threads The number of worker threads, or zero to use one per core.
+   * @param cacheBytes The memory that the prepared data of cached files may
+   * use before the least recently used ones are evicted. Sessions are not
+   * evicted for their memory, since their samples cannot be loaded again,
+   * but they time out.
+   */
+  AnalysisService(size_t threads, size_t cacheBytes);
+
+  /**
+   * Processes the requests that are still queued and stops the workers.
+   */
+  ~AnalysisService();
+
+  AnalysisService(const AnalysisService&) = delete;
+  AnalysisService& operator=(const AnalysisService&) = delete;
+
+  /**
+   * Queues a request. The latency of the request is measured from here until
+   * the response has been given to the respond function.
+   *
+   * @param request The request as a serialized JSON object.
+   * @param respond The function that the serialized response is given to.
+   */
+  void Submit(std::string request, Respond respond);
+
+  /**
+   * Returns the request latency percentiles and the state of the cache.
+   */
+  wpi::json GetStats();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // The number of latest requests that the latency percentiles are of.
+  static constexpr size_t kLatencyHistory = 4096;
+
+  // How long a session is kept without requests.
+  static constexpr std::chrono::minutes kSessionTimeout{10};
+
+  /**
+   * A loaded data set, along with the state that its DataProcessor refers to.
+   * This is only used while its mutex is held.
+   */
+  struct Entry;
+
+  /**
+   * Processes a request and returns its response.
+   */
+  wpi::json Handle(const wpi::json& request);
+
+  /**
+   * Analyzes a data set as requested.
+   */
+  wpi::json Analyze(const wpi::json& request);
+
+  /**
+   * Returns the cache entry of the data set of a request, creating it if it
+   * does not exist yet.
+   *
+   * @param key The cache key of the data set.
+   * @param created Set to whether the entry was created.
+   */
+  std::shared_ptr<Entry> GetEntry(const std::string& key, bool* created);
+
+  /**
+   * Drops the sessions that timed out, and evicts the least recently used
+   * files until the cache fits in its memory limit.
+   */
+  void Evict();
+
+  /**
+   * Records the latency of a request.
+   */
+  void RecordLatency(double seconds, bool error);
+
+  /**
+   * Takes requests off the queue and processes them until the service stops.
+   */
+  void Work();
+
+  // The queued requests, along with the time that they were submitted.
+  struct Request {
+    std::string request;
+    Respond respond;
+    Clock::time_point submitted;
+  };
+  std::mutex m_queueMutex;
+  std::condition_variable m_queueCondition;
+  std::queue<Request> m_queue;
+  bool m_stopping = false;
+  std::vector<std::thread> m_workers;
+
+  // The cached data sets by key, and the memory that files may use.
+  std::mutex m_cacheMutex;
+  std::map<std::string, std::shared_ptr<Entry>> m_cache;
+  size_t m_cacheBytes;
+  uint64_t m_useCounter = 0;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+
+  // The latency of the latest requests in seconds, as a ring buffer.
+  std::mutex m_latencyMutex;
+  std::vector<double> m_latencies;
+  size_t m_latencyIndex = 0;
+  uint64_t m_requests = 0;
+  uint64_t m_errors = 0;
+};
+}  // namespace frcchar
@@ -0,0 +1,165 @@
+// MIT License
+
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+#include <random>
+#include <string>
+
+#include <wpi/json.h>
+#include <wpi/raw_ostream.h>
+
+#include "backend/DataProcessor.h"
+#include "backend/PreparedData.h"
+
+// Checks the promise of compact storage: the gains of every data set have to
+// agree with the ones from double storage to within kTolerance (relative),
+// and the timestamps have to be stored exactly. The tests start at a large
+// timestamp, as they do on a robot that has been on for a while.
+
+namespace {
+constexpr double kKs = 0.5;
+constexpr double kKv = 2.0;
+constexpr double kKa = 0.3;
+constexpr double kDt = 0.005;
+constexpr double kStartTime = 3600.0;
+constexpr double kTolerance = 1E-5;
+
+/**
+ * Simulates a test of a mechanism with the given voltage function and
+ * returns its samples in the format of a characterization JSON.
+ */
+template <typename Voltage>
+wpi::json Simulate(Voltage voltage, size_t samples, double sign,
+                   unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 1E-3);
+  wpi::json test = wpi::json::array();
+  double position = 0.0;
+  double velocity = 0.0;
+  for (size_t i = 0; i < samples; ++i) {
+    double t = i * kDt;
+    double u = sign * voltage(t);
+    if (velocity != 0 || std::abs(u) > kKs) {
+      double friction = std::copysign(kKs, velocity != 0 ? velocity : u);
+      velocity += (u - friction - kKv * velocity) / kKa * kDt;
+    }
+    position += velocity * kDt;
+
+    // Both sides of a drivetrain see the same motion, and the gyro stays at
+    // zero.
+    double measured = velocity + noise(rng);
+    test.push_back({kStartTime + t, 12.0, u / 12.0, u, u, position, position,
+                    measured, measured, 0.0});
+  }
+  return test;
+}
+
+wpi::json MakeData(const std::string& type) {
+  auto ramp = [](double t) { return 0.25 * t; };
+  auto step = [](double) { return 6.0; };
+
+  wpi::json json;
+  json["test"] = type;
+  json["unitsPerRotation"] = 1.0;
+  json["slow-forward"] = Simulate(ramp, 4000, 1, 1);
+  json["slow-backward"] = Simulate(ramp, 4000, -1, 2);
+  json["fast-forward"] = Simulate(step, 600, 1, 3);
+  json["fast-backward"] = Simulate(step, 600, -1, 4);
+  return json;
+}
+
+/**
+ * Returns the number of gains that differ by more than the tolerance.
+ */
+int Compare(const std::string& stage, const char* name, double compact,
+            double full) {
+  double error = std::abs(compact - full) / std::max(std::abs(full), 1E-9);
+  if (std::isfinite(full) && error <= kTolerance) return 0;
+  wpi::errs() << stage << ": " << name << " is " << compact << " compact and "
+              << full << " double (relative error " << error << ")\n";
+  return 1;
+}
+
+/**
+ * Compares the analyses of every data set of the given mechanism with both
+ * storage modes. Returns the number of gains that differ.
+ */
+int CheckType(const char* type) {
+  using frcchar::DataProcessor;
+  struct Analysis {
+    DataProcessor::FFGains ff{0_V, 0_V / 1_mps, 0_V / 1_mps_sq, 0.0};
+    DataProcessor::FBGains fb{0.0, 0.0};
+    DataProcessor::GainPreset preset{true, 20_ms, 0_s, 1 / 1_V, true};
+    DataProcessor::LQRParameters params{1_m, 1.5_mps, 7_V};
+    int dataset = 2;
+    std::string path;
+  };
+
+  auto data = MakeData(type);
+  Analysis full, compact;
+  DataProcessor fullProcessor(&full.path, &full.ff, &full.fb, &full.preset,
+                              &full.params, &full.dataset, false);
+  DataProcessor compactProcessor(&compact.path, &compact.ff, &compact.fb,
+                                 &compact.preset, &compact.params,
+                                 &compact.dataset, true);
+  fullProcessor.LoadSamples(data);
+  compactProcessor.LoadSamples(data);
+
+  int failures = 0;
+  int datasets = fullProcessor.IsDrivetrain() ? 5 : 3;
+  for (int dataset = 0; dataset < datasets; ++dataset) {
+    for (bool velocity : {true, false}) {
+      for (auto analysis : {&full, &compact}) {
+        analysis->dataset = dataset;
+        analysis->preset.velocity = velocity;
+      }
+      fullProcessor.Update();
+      compactProcessor.Update();
+
+      std::string stage = std::string(type) + " data set " +
+                          std::to_string(dataset) +
+                          (velocity ? " (velocity)" : " (position)");
+      failures += Compare(stage, "Ks", compact.ff.Ks.to<double>(),
+                          full.ff.Ks.to<double>());
+      failures += Compare(stage, "Kv", compact.ff.Kv.to<double>(),
+                          full.ff.Kv.to<double>());
+      failures += Compare(stage, "Ka", compact.ff.Ka.to<double>(),
+                          full.ff.Ka.to<double>());
+      failures += Compare(stage, "Kp", compact.fb.Kp, full.fb.Kp);
+      failures += Compare(stage, "Kd", compact.fb.Kd, full.fb.Kd);
+    }
+  }
+  return failures;
+}
+
+/**
+ * Returns the number of timestamps that compact storage does not keep
+ * exactly.
+ */
+int CheckTimes() {
+  frcchar::PreparedData data(true);
+  for (int i = 0; i < 1000; ++i) data.Append(kStartTime + i * kDt, 0, 0, 0);
+
+  int failures = 0;
+  for (int i = 0; i < 1000; ++i) {
+    if (data.Time(i) != kStartTime + i * kDt) ++failures;
+  }
+  if (failures > 0)
+    wpi::errs() << failures << " compact timestamps were rounded\n";
+  return failures;
+}
+}  // namespace
+
+int main() {
+  int failures = CheckTimes();
+  for (const char* type : {"Simple", "Drivetrain"}) failures += CheckType(type);
+
+  if (failures > 0) {
+    wpi::errs() << failures << " values differ between storage modes\n";
+    return 1;
+  }
+  wpi::outs() << "Compact and double storage agree to within " << kTolerance
+              << "\n";
+  return 0;
+}
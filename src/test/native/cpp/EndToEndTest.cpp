@@ -0,0 +1,135 @@
+// MIT License
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <wpi/json.h>
+#include <wpi/raw_istream.h>
+#include <wpi/raw_ostream.h>
+
+#include "backend/CaptureSession.h"
+#include "backend/DataProcessor.h"
+#include "backend/SimulatedMechanism.h"
+
+// Runs the whole characterization of a simulated mechanism: the Logger's
+// capture session runs the tests on it over NetworkTables at the fastest
+// simulation rate, saves the data JSON, and the data is analyzed. The test
+// fails if samples were lost on the way or if the gains do not match the
+// ones that were simulated.
+
+namespace {
+using namespace std::chrono_literals;
+
+// A port that does not conflict with a NetworkTables server that is already
+// running on this machine.
+constexpr unsigned int kPort = 5811;
+
+/**
+ * Waits until the condition holds, or until the timeout passes. Returns
+ * whether the condition holds.
+ */
+template <typename Condition>
+bool WaitFor(Condition condition, std::chrono::milliseconds timeout) {
+  auto end = std::chrono::steady_clock::now() + timeout;
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > end) return false;
+    std::this_thread::sleep_for(10ms);
+  }
+  return true;
+}
+
+/**
+ * Checks that a gain is within the relative tolerance of its expected value.
+ */
+bool Check(const char* name, double actual, double expected,
+           double tolerance) {
+  bool ok = std::abs(actual - expected) <= tolerance * expected;
+  wpi::outs() << name << " = " << actual << " (expected " << expected << ")"
+              << (ok ? "" : " FAILED") << "\n";
+  return ok;
+}
+}  // namespace
+
+int main() {
+  frcchar::SimulatedMechanism::Parameters params;
+  params.rate = frcchar::SimulatedMechanism::kMaxRate;
+  frcchar::SimulatedMechanism simulation(params, kPort);
+
+  frcchar::CaptureSession session;
+  session.Connect(0, kPort);
+  if (!WaitFor([&] { return session.GetStatus().connected; }, 10s)) {
+    wpi::errs() << "Could not connect to the simulation\n";
+    return 1;
+  }
+
+  // Run each test for long enough to reach a few volts, letting the
+  // mechanism come to rest before each one.
+  frcchar::CaptureSession::Voltages voltages{2.0, 6.0, 2.0};
+  for (auto&& test : frcchar::CaptureSession::kTests) {
+    if (test.rotate) continue;
+    std::this_thread::sleep_for(500ms);
+    session.StartTest(test, voltages);
+    std::this_thread::sleep_for(test.quasistatic ? 1500ms : 1000ms);
+    session.StopTest();
+    if (!WaitFor([&] { return session.HasData(test.key); }, 1s)) {
+      wpi::errs() << test.name << " did not finish\n";
+      return 1;
+    }
+  }
+
+  auto message = session.WriteDataFile(".", "end-to-end", "Simple", 1.0);
+  wpi::outs() << message << "\n";
+  std::string prefix = "Saved ";
+  if (message.compare(0, prefix.size(), prefix) != 0) return 1;
+  std::string path = message.substr(prefix.size());
+
+  // The simulation steps at a fixed rate, so the timestamps of a test that
+  // lost no samples are one period apart. A loaded machine may still delay a
+  // flush, so a few lost samples are tolerated.
+  bool ok = true;
+  {
+    std::error_code ec;
+    wpi::raw_fd_istream input(path, ec);
+    if (ec) return 1;
+    wpi::json json;
+    input >> json;
+
+    double period = 1.0 / params.rate.to<double>();
+    for (auto&& test : frcchar::CaptureSession::kTests) {
+      if (test.rotate) continue;
+      auto& data = json.at(test.key);
+      size_t received = data.size();
+      size_t expected =
+          received > 0 ? std::lround((data.back().at(0).get<double>() -
+                                      data.front().at(0).get<double>()) /
+                                     period) +
+                             1
+                       : 0;
+      bool complete = received > 0 && received * 100 >= expected * 99;
+      wpi::outs() << test.name << ": " << received << " of " << expected
+                  << " samples" << (complete ? "" : " FAILED") << "\n";
+      ok = ok && complete;
+    }
+  }
+
+  frcchar::DataProcessor::FFGains ff{0_V, 0_V / 1_mps, 0_V / 1_mps_sq, 0.0};
+  frcchar::DataProcessor::FBGains fb{0.0, 0.0};
+  frcchar::DataProcessor::GainPreset preset{true, 20_ms, 0_s, 1 / 1_V, true};
+  frcchar::DataProcessor::LQRParameters lqr{1_m, 1.5_mps, 7_V};
+  int dataset = 2;
+  {
+    frcchar::DataProcessor processor(&path, &ff, &fb, &preset, &lqr,
+                                     &dataset);
+    processor.Update();
+  }
+  std::remove(path.c_str());
+
+  ok = Check("Ks", ff.Ks.to<double>(), params.Ks.to<double>(), 0.1) && ok;
+  ok = Check("Kv", ff.Kv.to<double>(), params.Kv.to<double>(), 0.05) && ok;
+  ok = Check("Ka", ff.Ka.to<double>(), params.Ka.to<double>(), 0.2) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+// MIT License
+
+#include <cstddef>
+#include <vector>
+
+#include <glass/Context.h>
+#include <imgui.h>
+#include <implot.h>
+#include <wpi/raw_ostream.h>
+#include <wpigui.h>
+
+#include "backend/AllocationCounter.h"
+#include "display/Analyzer.h"
+#include "display/FRCCharacterization.h"
+#include "display/FrameAudit.h"
+#include "display/Generator.h"
+#include "display/Logger.h"
+
+// Checks that the GUI windows do not allocate in steady state: the windows
+// are drawn headlessly (without a platform window or renderer) for a number
+// of frames, and after the first few, which build their caches, the display
+// function of each window has to make zero heap allocations on every frame.
+//
+// wpigui is never initialized, so none of its initializers or executors run.
+// Everything that the windows do per frame has to happen in their display
+// functions, which is what the audit measures in the GUI as well.
+
+namespace {
+// The frames that the windows may allocate in, and the ones that are checked
+// after them.
+constexpr int kWarmupFrames = 30;
+constexpr int kCheckedFrames = 120;
+
+/**
+ * Draws one frame of all windows. Without a platform backend, the display
+ * size and the time step are set here instead.
+ */
+void DrawFrame() {
+  auto& io = ImGui::GetIO();
+  io.DisplaySize = ImVec2(1280, 720);
+  io.DeltaTime = 1.0f / 60;
+  ImGui::NewFrame();
+  frcchar::FRCCharacterization::Manager.DisplayWindows();
+  ImGui::Render();
+}
+}  // namespace
+
+int main() {
+  if (!frcchar::IsCountingAllocations()) {
+    wpi::errs() << "The allocation hook is not linked in\n";
+    return 1;
+  }
+
+  // Create the contexts as the GUI does. The Dear ImGui and ImPlot contexts
+  // are normally created along with the platform window, so they are created
+  // here if they do not exist yet.
+  wpi::gui::CreateContext();
+  glass::CreateContext();
+  if (!ImGui::GetCurrentContext()) ImGui::CreateContext();
+  if (!ImPlot::GetCurrentContext()) ImPlot::CreateContext();
+
+  // Without a renderer, the font atlas has to be built by hand. Keyboard
+  // navigation needs the key map of a platform backend, so it is turned off.
+  auto& io = ImGui::GetIO();
+  io.IniFilename = nullptr;
+  io.ConfigFlags &= ~ImGuiConfigFlags_NavEnableKeyboard;
+  unsigned char* pixels;
+  int width, height;
+  io.Fonts->GetTexDataAsAlpha8(&pixels, &width, &height);
+
+  frcchar::FRCCharacterization::LoggerGUI->Initialize();
+  frcchar::FRCCharacterization::AnalyzerGUI->Initialize();
+  frcchar::FRCCharacterization::GeneratorGUI->Initialize();
+
+  for (int i = 0; i < kWarmupFrames; ++i) DrawFrame();
+
+  // The frames that each window was displayed in so far. A window that is
+  // still appearing may skip its contents in the first frames, so the checked
+  // frames count from here.
+  std::vector<size_t> warmupFrames;
+  frcchar::FrameAudit::ForEachWindow(
+      [&](const char*, size_t frames, const frcchar::AllocationCount&) {
+        warmupFrames.emplace_back(frames);
+      });
+
+  int failures = 0;
+  for (int i = 0; i < kCheckedFrames; ++i) {
+    DrawFrame();
+    size_t window = 0;
+    frcchar::FrameAudit::ForEachWindow(
+        [&](const char* name, size_t frames,
+            const frcchar::AllocationCount& allocations) {
+          if (frames != warmupFrames[window++] + i + 1) {
+            wpi::errs() << name << " was not displayed in frame " << i
+                        << "\n";
+            ++failures;
+          } else if (allocations.allocations != 0) {
+            wpi::errs() << name << " made " << allocations.allocations
+                        << " allocations (" << allocations.bytes
+                        << " bytes) in frame " << i << "\n";
+            ++failures;
+          }
+        });
+  }
+
+  // Stop the capture session of the Logger before exiting.
+  frcchar::FRCCharacterization::LoggerGUI.reset();
+
+  if (warmupFrames.empty()) {
+    wpi::errs() << "No window was measured\n";
+    return 1;
+  }
+  if (failures > 0) {
+    wpi::errs() << failures << " window frames allocated\n";
+    return 1;
+  }
+  wpi::outs() << "No window allocated in " << kCheckedFrames << " frames\n";
+  return 0;
+}
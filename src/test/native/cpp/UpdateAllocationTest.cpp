@@ -0,0 +1,150 @@
+// MIT License
+
+#include <cmath>
+#include <initializer_list>
+#include <random>
+#include <string>
+
+#include <wpi/json.h>
+#include <wpi/raw_ostream.h>
+
+#include "backend/AllocationCounter.h"
+#include "backend/DataProcessor.h"
+
+// Checks that analyses never allocate: DataProcessor::Update() is called
+// repeatedly on simulated data, for every data set, with both loop types and
+// changing LQR parameters, and each call has to make zero heap allocations.
+// The data is loaded in several batches too, since each load changes the
+// prepared data that the analyses read.
+
+namespace {
+constexpr double kKs = 0.5;
+constexpr double kKv = 2.0;
+constexpr double kKa = 0.3;
+constexpr double kDt = 0.005;
+
+/**
+ * Simulates a test of a mechanism with the given voltage function and
+ * returns its samples in the format of a characterization JSON. The noise
+ * only depends on the seed, so a longer run of the same test starts with the
+ * same samples.
+ */
+template <typename Voltage>
+wpi::json Simulate(Voltage voltage, size_t samples, double sign,
+                   unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 1E-3);
+  wpi::json test = wpi::json::array();
+  double position = 0.0;
+  double velocity = 0.0;
+  for (size_t i = 0; i < samples; ++i) {
+    double t = i * kDt;
+    double u = sign * voltage(t);
+    if (velocity != 0 || std::abs(u) > kKs) {
+      double friction = std::copysign(kKs, velocity != 0 ? velocity : u);
+      velocity += (u - friction - kKv * velocity) / kKa * kDt;
+    }
+    position += velocity * kDt;
+
+    // Both sides of a drivetrain see the same motion, and the gyro stays at
+    // zero.
+    double measured = velocity + noise(rng);
+    test.push_back({t, 12.0, u / 12.0, u, u, position, position, measured,
+                    measured, 0.0});
+  }
+  return test;
+}
+
+/**
+ * Returns the data JSON of a mechanism, with only the first part of each
+ * test if the fraction is less than one.
+ */
+wpi::json MakeData(const std::string& type, double fraction) {
+  auto ramp = [](double t) { return 0.25 * t; };
+  auto step = [](double) { return 6.0; };
+  size_t slow = std::lround(4000 * fraction);
+  size_t fast = std::lround(600 * fraction);
+
+  wpi::json json;
+  json["test"] = type;
+  json["unitsPerRotation"] = 1.0;
+  json["slow-forward"] = Simulate(ramp, slow, 1, 1);
+  json["slow-backward"] = Simulate(ramp, slow, -1, 2);
+  json["fast-forward"] = Simulate(step, fast, 1, 3);
+  json["fast-backward"] = Simulate(step, fast, -1, 4);
+  return json;
+}
+
+/**
+ * Runs the analyses of the data that has been loaded so far. Returns the
+ * number of analyses that allocated.
+ */
+int CheckUpdates(frcchar::DataProcessor* processor, int* dataset,
+                 frcchar::DataProcessor::GainPreset* preset,
+                 frcchar::DataProcessor::LQRParameters* params,
+                 const char* stage) {
+  int failures = 0;
+  int datasets = processor->IsDrivetrain() ? 5 : 3;
+  for (int repeat = 0; repeat < 3; ++repeat) {
+    for (*dataset = 0; *dataset < datasets; ++*dataset) {
+      for (bool velocity : {true, false}) {
+        preset->velocity = velocity;
+        params->qv = units::meters_per_second_t(1.0 + repeat);
+        processor->Update();
+
+        auto count = processor->GetUpdateAllocations();
+        if (count.allocations != 0) {
+          wpi::errs() << stage << ": data set " << *dataset
+                      << (velocity ? " (velocity)" : " (position)") << " made "
+                      << count.allocations << " allocations ("
+                      << count.bytes << " bytes)\n";
+          ++failures;
+        }
+      }
+    }
+  }
+  return failures;
+}
+}  // namespace
+
+int main() {
+  if (!frcchar::IsCountingAllocations()) {
+    wpi::errs() << "The allocation hook is not linked in\n";
+    return 1;
+  }
+
+  int failures = 0;
+  for (const char* type : {"Simple", "Drivetrain"}) {
+    frcchar::DataProcessor::FFGains ff{0_V, 0_V / 1_mps, 0_V / 1_mps_sq,
+                                       0.0};
+    frcchar::DataProcessor::FBGains fb{0.0, 0.0};
+    frcchar::DataProcessor::GainPreset preset{true, 20_ms, 0_s, 1 / 1_V,
+                                              true};
+    frcchar::DataProcessor::LQRParameters params{1_m, 1.5_mps, 7_V};
+    int dataset = 2;
+
+    // Without a path, the processor starts out empty and the samples are
+    // given to it in batches.
+    std::string path;
+    frcchar::DataProcessor processor(&path, &ff, &fb, &preset, &params,
+                                     &dataset);
+    for (double fraction : {0.5, 0.75, 1.0}) {
+      processor.LoadSamples(MakeData(type, fraction));
+      std::string stage =
+          std::string(type) + " at " + std::to_string(fraction);
+      failures += CheckUpdates(&processor, &dataset, &preset, &params,
+                               stage.c_str());
+    }
+
+    wpi::outs() << type << ": Ks " << ff.Ks.to<double>() << ", Kv "
+                << ff.Kv.to<double>() << ", Ka " << ff.Ka.to<double>()
+                << "\n";
+  }
+
+  if (failures > 0) {
+    wpi::errs() << failures << " analyses allocated\n";
+    return 1;
+  }
+  wpi::outs() << "No analysis allocated\n";
+  return 0;
+}